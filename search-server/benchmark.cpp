@@ -0,0 +1,546 @@
+// Benchmark suite: builds a synthetic Zipfian corpus and times the main
+// SearchServer operations. Every benchmark prints one JSON line:
+//
+// {"benchmark":"find_top_documents_seq","documents":10000,"operations":1000,
+//  "seconds":0.41,"ops_per_second":2439.0,"p50_ns":...,"p99_ns":...,
+//  "p999_ns":...,"peak_rss_kb":...}
+//
+// The index size is printed after loading, and again after compaction
+// with --compact 1, as {"memory":"loaded","total_bytes":...,...}.
+// Impact-ordered searches also print how many of the exhaustive search's
+// top documents they find, as {"agreement":"find_top_documents_impact",
+// "max_postings":...,"recall":...}. Reordering document ids prints the
+// index size of the rebuilt server as {"memory":"reordered",...} and the
+// posting lists' gap-encoded size before and after as
+// {"gap_encoded_bytes":"reordering","original":...,"reordered":...}.
+//
+// --index-memory thp|hugetlb puts the index on transparent or explicit huge
+// pages, --interleave 1 spreads it over the NUMA nodes; how much of it the
+// kernel granted is printed as {"index_memory":"thp","mapped_bytes":...}.
+// Compare TLB misses with e.g.
+//     perf stat -e dTLB-loads,dTLB-load-misses benchmark --only find_top_documents_seq --index-memory thp
+//
+// --fuzzy-dictionary N builds a typo index over N generated words, prints
+// its size as {"fuzzy_index":...,"terms":...,"bytes":...} and times
+// fuzzy_lookup, one misspelled query word per operation. The index is
+// built apart from the corpus, so it can be far larger than --dictionary.
+//
+// Usage: benchmark [--documents N] [--queries N] [--dictionary N]
+//                  [--document-words N] [--query-words N] [--zipf S]
+//                  [--duplicates RATE] [--seed N] [--only NAME]
+//                  [--compact 0|1] [--index-memory default|thp|hugetlb]
+//                  [--interleave 0|1] [--fuzzy-dictionary N]
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "document_reordering.h"
+#include "fuzzy_index.h"
+#include "histogram.h"
+#include "process_queries.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+struct BenchmarkOptions {
+    int documents = 10'000;
+    int queries = 1'000;
+    int dictionary = 50'000;
+    int document_words = 100;
+    int query_words = 5;
+    double zipf = 1.0;
+    double duplicates = 0.01;
+    unsigned seed = 42;
+    string only;
+    bool compact = false;
+    string index_memory = "default"s;
+    bool interleave = false;
+    int fuzzy_dictionary = 0;
+};
+
+const int PROCESS_QUERIES_BATCH = 100;
+// Posting budget of the bounded impact-ordered search
+const size_t IMPACT_POSTING_BUDGET = 4096;
+
+void PrintUsage() {
+    cerr << "Usage: benchmark [--documents N] [--queries N] [--dictionary N] [--document-words N]"s
+        << " [--query-words N] [--zipf S] [--duplicates RATE] [--seed N] [--only NAME] [--compact 0|1]"s
+        << " [--index-memory default|thp|hugetlb] [--interleave 0|1] [--fuzzy-dictionary N]"s << endl;
+}
+
+bool ParseOptions(int argc, char* argv[], BenchmarkOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string name = argv[i];
+        if (name == "--help"s || i + 1 == argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        try {
+            if (name == "--documents"s) {
+                options.documents = stoi(value);
+            }
+            else if (name == "--queries"s) {
+                options.queries = stoi(value);
+            }
+            else if (name == "--dictionary"s) {
+                options.dictionary = stoi(value);
+            }
+            else if (name == "--document-words"s) {
+                options.document_words = stoi(value);
+            }
+            else if (name == "--query-words"s) {
+                options.query_words = stoi(value);
+            }
+            else if (name == "--zipf"s) {
+                options.zipf = stod(value);
+            }
+            else if (name == "--duplicates"s) {
+                options.duplicates = stod(value);
+            }
+            else if (name == "--seed"s) {
+                options.seed = static_cast<unsigned>(stoul(value));
+            }
+            else if (name == "--only"s) {
+                options.only = value;
+            }
+            else if (name == "--compact"s) {
+                options.compact = stoi(value) != 0;
+            }
+            else if (name == "--index-memory"s) {
+                options.index_memory = value;
+            }
+            else if (name == "--interleave"s) {
+                options.interleave = stoi(value) != 0;
+            }
+            else if (name == "--fuzzy-dictionary"s) {
+                options.fuzzy_dictionary = stoi(value);
+            }
+            else {
+                return false;
+            }
+        }
+        catch (const logic_error&) {
+            return false;
+        }
+    }
+    return options.documents > 0 && options.queries > 0 && options.dictionary > 0
+        && options.document_words > 0 && options.query_words > 0 && options.fuzzy_dictionary >= 0
+        && (options.index_memory == "default"s || options.index_memory == "thp"s || options.index_memory == "hugetlb"s);
+}
+
+long GetPeakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+void PrintMemoryStats(const string& state, const MemoryStats& stats) {
+    cout << "{\"memory\":\""s << state << "\""s
+        << ",\"total_bytes\":"s << stats.GetTotal()
+        << ",\"dictionary_bytes\":"s << stats.dictionary_bytes
+        << ",\"postings_bytes\":"s << stats.postings_bytes
+        << ",\"forward_index_bytes\":"s << stats.forward_index_bytes
+        << ",\"documents_bytes\":"s << stats.documents_bytes
+        << ",\"document_ids_bytes\":"s << stats.document_ids_bytes
+        << ",\"duplicate_index_bytes\":"s << stats.duplicate_index_bytes
+        << ",\"term_dictionary_bytes\":"s << stats.term_dictionary_bytes
+        << ",\"impact_index_bytes\":"s << stats.impact_index_bytes
+        << ",\"fuzzy_index_bytes\":"s << stats.fuzzy_index_bytes << "}"s << endl;
+}
+
+// The generated query with its words joined by the operator, minus words negated
+string ToBooleanQuery(const string& query, const string& joiner) {
+    string positive;
+    string negative;
+    for (const string_view word : SplitIntoWords(query)) {
+        if (word[0] == '-') {
+            negative += " NOT "s + string(word.substr(1));
+        }
+        else {
+            positive += (positive.empty() ? ""s : joiner) + string(word);
+        }
+    }
+    return positive.empty() ? positive : "("s + positive + ")"s + negative;
+}
+
+class Corpus {
+public:
+    explicit Corpus(const BenchmarkOptions& options)
+        : options_(options) {
+        mt19937 generator(options.seed);
+        dictionary_ = GenerateDictionary(generator, options.dictionary, 10);
+        distribution_ = make_unique<ZipfDistribution>(dictionary_.size(), options.zipf);
+        queries_ = GenerateQueries(generator, dictionary_, *distribution_, options.queries, options.query_words, 0.1);
+    }
+
+    // Texts are regenerated from the document id instead of being kept, so
+    // that 10^7 documents fit in memory; a duplicate repeats an earlier text
+    string GetDocument(int document_id) const {
+        mt19937 generator(options_.seed ^ (static_cast<unsigned>(document_id) * 2654435761u));
+        if (document_id > 0 && uniform_real_distribution<>(0, 1)(generator) < options_.duplicates) {
+            return GetDocument(uniform_int_distribution<int>(0, document_id - 1)(generator));
+        }
+        return GenerateQuery(generator, dictionary_, *distribution_, options_.document_words);
+    }
+
+    const vector<string>& GetQueries() const {
+        return queries_;
+    }
+
+private:
+    const BenchmarkOptions& options_;
+    vector<string> dictionary_;
+    unique_ptr<ZipfDistribution> distribution_;
+    vector<string> queries_;
+};
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options)
+        : options_(options) {
+    }
+
+    bool IsSelected(const string& name) const {
+        return options_.only.empty() || options_.only == name;
+    }
+
+    // Calls operation(i) for i in [0, count), timing every call
+    template <typename Operation>
+    void Run(const string& name, int count, Operation operation) {
+        Run(name, count, [](int) { return 0; }, [&operation](int i, int) { operation(i); });
+    }
+
+    // Calls operation(i, prepare(i)), timing only the operation
+    template <typename Prepare, typename Operation>
+    void Run(const string& name, int count, Prepare prepare, Operation operation) {
+        if (!IsSelected(name)) {
+            return;
+        }
+        using Clock = chrono::steady_clock;
+        LatencyHistogram latency;
+        Clock::duration total{};
+        for (int i = 0; i < count; ++i) {
+            auto input = prepare(i);
+            const auto start = Clock::now();
+            operation(i, move(input));
+            const auto elapsed = Clock::now() - start;
+            total += elapsed;
+            latency.Add(chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+        }
+        const double seconds = chrono::duration<double>(total).count();
+        cout << "{\"benchmark\":\""s << name << "\""s
+            << ",\"documents\":"s << options_.documents
+            << ",\"operations\":"s << count
+            << ",\"seconds\":"s << seconds
+            << ",\"ops_per_second\":"s << (seconds > 0 ? count / seconds : 0.0)
+            << ",\"p50_ns\":"s << latency.GetQuantile(0.5)
+            << ",\"p99_ns\":"s << latency.GetQuantile(0.99)
+            << ",\"p999_ns\":"s << latency.GetQuantile(0.999)
+            << ",\"peak_rss_kb\":"s << GetPeakRssKb() << "}"s << endl;
+    }
+
+private:
+    const BenchmarkOptions& options_;
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    const Corpus corpus(options);
+    const vector<string>& queries = corpus.GetQueries();
+    BenchmarkRunner runner(options);
+    SearchServer search_server("and in on the"s);
+    if (options.index_memory != "default"s || options.interleave) {
+        IndexMemoryOptions index_memory;
+        index_memory.huge_pages = options.index_memory == "thp"s ? IndexMemoryOptions::HugePages::TRANSPARENT
+            : options.index_memory == "hugetlb"s ? IndexMemoryOptions::HugePages::EXPLICIT
+            : IndexMemoryOptions::HugePages::NONE;
+        index_memory.interleave_numa_nodes = options.interleave;
+        search_server.SetIndexMemory(index_memory);
+    }
+    // Guards against the compiler dropping the searches
+    double checksum = 0.0;
+
+    // Every other benchmark needs the index, so it is built even when not measured
+    const auto get_document = [&corpus](int document_id) { return corpus.GetDocument(document_id); };
+    const auto add_document = [&search_server](int document_id, const string& text) {
+        search_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    };
+    if (runner.IsSelected("add_document"s)) {
+        runner.Run("add_document"s, options.documents, get_document, add_document);
+    }
+    else {
+        for (int document_id = 0; document_id < options.documents; ++document_id) {
+            add_document(document_id, get_document(document_id));
+        }
+    }
+    PrintMemoryStats("loaded"s, search_server.GetMemoryStats());
+    const IndexMemoryStats index_memory_stats = search_server.GetIndexMemoryStats();
+    cout << "{\"index_memory\":\""s << options.index_memory << "\""s
+        << ",\"interleave\":"s << options.interleave
+        << ",\"mapped_bytes\":"s << index_memory_stats.mapped_bytes
+        << ",\"explicit_huge_page_bytes\":"s << index_memory_stats.explicit_huge_page_bytes
+        << ",\"transparent_huge_page_bytes\":"s << GetTransparentHugePageBytes()
+        << ",\"fallbacks\":"s << index_memory_stats.fallback_count << "}"s << endl;
+    if (options.compact) {
+        runner.Run("compact"s, 1, [&](int) {
+            search_server.Compact();
+            });
+        // Later benchmarks run on the compact index even when this one is not measured
+        search_server.Compact();
+        PrintMemoryStats("compacted"s, search_server.GetMemoryStats());
+    }
+
+    runner.Run("find_top_documents_seq"s, queries.size(), [&](int i) {
+        for (const Document& document : search_server.FindTopDocuments(execution::seq, queries[i])) {
+            checksum += document.relevance;
+        }
+        });
+    // Compare with find_top_documents_seq for the cost of the aggregates
+    runner.Run("find_top_documents_facets"s, queries.size(), [&](int i) {
+        SearchFacets facets;
+        for (const Document& document : search_server.FindTopDocuments(queries[i], facets)) {
+            checksum += document.relevance;
+        }
+        checksum += facets.total_hits + facets.status_counts[0] + facets.rating_counts.back();
+        });
+    runner.Run("find_top_documents_par"s, queries.size(), [&](int i) {
+        for (const Document& document : search_server.FindTopDocuments(execution::par, queries[i])) {
+            checksum += document.relevance;
+        }
+        });
+    for (const auto& [name, joiner] : { pair{ "boolean_and"s, " AND "s }, pair{ "boolean_or"s, " OR "s } }) {
+        vector<string> boolean_queries;
+        for (const string& query : queries) {
+            boolean_queries.push_back(ToBooleanQuery(query, joiner));
+        }
+        runner.Run(name, queries.size(), [&](int i) {
+            if (boolean_queries[i].empty()) {
+                return;
+            }
+            for (const Document& document : search_server.FindTopDocumentsBoolean(boolean_queries[i])) {
+                checksum += document.relevance;
+            }
+            });
+    }
+    const vector<pair<string, size_t>> impact_searches = {
+        { "find_top_documents_impact"s, numeric_limits<size_t>::max() },
+        { "find_top_documents_impact_budget"s, IMPACT_POSTING_BUDGET },
+    };
+    if (runner.IsSelected("build_impact_index"s)) {
+        runner.Run("build_impact_index"s, 1, [&](int) {
+            search_server.BuildImpactIndex();
+            });
+    }
+    for (const auto& [name, max_postings] : impact_searches) {
+        if (!runner.IsSelected(name)) {
+            continue;
+        }
+        if (!search_server.HasImpactIndex()) {
+            search_server.BuildImpactIndex();
+        }
+        SearchLimits limits;
+        limits.max_postings = max_postings;
+        vector<vector<Document>> results(queries.size());
+        runner.Run(name, queries.size(), [&](int i) {
+            results[i] = search_server.FindTopDocumentsByImpact(queries[i], limits).documents;
+            });
+        // Share of the exhaustive top documents the bounded search found
+        size_t found = 0;
+        size_t expected = 0;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            for (const Document& document : search_server.FindTopDocuments(queries[i])) {
+                ++expected;
+                found += any_of(results[i].begin(), results[i].end(), [&document](const Document& result) {
+                    return result.id == document.id;
+                    });
+            }
+        }
+        cout << "{\"agreement\":\""s << name << "\""s
+            << ",\"max_postings\":"s << (max_postings == numeric_limits<size_t>::max() ? -1 : static_cast<long long>(max_postings))
+            << ",\"recall\":"s << (expected > 0 ? found * 1.0 / expected : 1.0) << "}"s << endl;
+    }
+    runner.Run("result_cursor_first_page"s, queries.size(), [&](int i) {
+        ResultCursor cursor = search_server.OpenResultCursor(queries[i]);
+        checksum += cursor.NextPage(MAX_RESULT_DOCUMENT_COUNT).size();
+        });
+    runner.Run("result_cursor_next_page"s, queries.size(),
+        [&](int i) {
+            ResultCursor cursor = search_server.OpenResultCursor(queries[i]);
+            cursor.NextPage(MAX_RESULT_DOCUMENT_COUNT);
+            return cursor;
+        },
+        [&](int, ResultCursor cursor) {
+            checksum += cursor.NextPage(MAX_RESULT_DOCUMENT_COUNT).size();
+        });
+    runner.Run("match_document"s, queries.size(), [&](int i) {
+        const int document_id = static_cast<int>((i * 7919ll) % options.documents);
+        try {
+            checksum += get<0>(search_server.MatchDocument(queries[i], document_id)).size();
+        }
+        catch (const invalid_argument&) {
+            // A query of minus words only
+        }
+        });
+    const int batch_count = max<int>(1, queries.size() / PROCESS_QUERIES_BATCH);
+    runner.Run("process_queries_batch"s, batch_count, [&](int i) {
+        const auto begin = queries.begin() + min<size_t>(i * PROCESS_QUERIES_BATCH, queries.size());
+        const auto end = queries.begin() + min<size_t>((i + 1) * PROCESS_QUERIES_BATCH, queries.size());
+        checksum += ProcessQueries(search_server, vector<string>(begin, end)).size();
+        });
+    runner.Run("process_queries_batched"s, batch_count, [&](int i) {
+        const auto begin = queries.begin() + min<size_t>(i * PROCESS_QUERIES_BATCH, queries.size());
+        const auto end = queries.begin() + min<size_t>((i + 1) * PROCESS_QUERIES_BATCH, queries.size());
+        checksum += ProcessQueriesBatched(search_server, vector<string>(begin, end)).size();
+        });
+    // The whole query set as one offline batch
+    runner.Run("process_queries_all"s, 1, [&](int) {
+        checksum += ProcessQueries(search_server, queries).size();
+        });
+    runner.Run("process_queries_batched_all"s, 1, [&](int) {
+        checksum += ProcessQueriesBatched(search_server, queries).size();
+        });
+    runner.Run("find_similar_documents"s, queries.size(), [&](int i) {
+        const int document_id = static_cast<int>((i * 7919ll) % options.documents);
+        for (const Document& document : search_server.FindSimilarDocuments(document_id)) {
+            checksum += document.relevance;
+        }
+        });
+    runner.Run("process_similar_documents_batch"s, batch_count, [&](int i) {
+        vector<int> document_ids;
+        for (int j = 0; j < PROCESS_QUERIES_BATCH; ++j) {
+            document_ids.push_back(static_cast<int>(((i * PROCESS_QUERIES_BATCH + j) * 7919ll) % options.documents));
+        }
+        checksum += ProcessSimilarDocuments(search_server, document_ids).size();
+        });
+    runner.Run("scan_documents"s, 1, [&](int) {
+        for (const SearchServer::DocumentView document : search_server.GetDocuments()) {
+            for (const auto [word, frequency] : document.word_frequencies) {
+                checksum += frequency;
+            }
+        }
+        });
+    runner.Run("scan_documents_par"s, 1, [&](int) {
+        atomic<size_t> word_count = 0;
+        search_server.ForEachDocument(execution::par, [&word_count](const SearchServer::DocumentView& document) {
+            size_t document_word_count = 0;
+            for (const auto [word, frequency] : document.word_frequencies) {
+                document_word_count += frequency > 0.0;
+            }
+            word_count += document_word_count;
+            });
+        checksum += word_count;
+        });
+    runner.Run("get_duplicates"s, 1, [&](int) {
+        checksum += search_server.GetDuplicates().size();
+        });
+    runner.Run("get_near_duplicates"s, 1, [&](int) {
+        checksum += search_server.GetNearDuplicates().size();
+        });
+    runner.Run("get_near_duplicates_par"s, 1, [&](int) {
+        checksum += search_server.GetNearDuplicates(execution::par).size();
+        });
+    if (runner.IsSelected("reorder_documents"s) || runner.IsSelected("find_top_documents_seq_reordered"s)) {
+        DocumentIdMap id_map;
+        if (runner.IsSelected("reorder_documents"s)) {
+            runner.Run("reorder_documents"s, 1, [&](int) {
+                id_map = ComputeDocumentOrder(search_server);
+                });
+        }
+        else {
+            id_map = ComputeDocumentOrder(search_server);
+        }
+        vector<DocumentInput> documents;
+        documents.reserve(options.documents);
+        for (int document_id = 0; document_id < options.documents; ++document_id) {
+            documents.push_back({ document_id, corpus.GetDocument(document_id), DocumentStatus::ACTUAL, { 1, 2, 3 } });
+        }
+        SearchServer reordered_server("and in on the"s);
+        reordered_server.AddDocuments(MapDocumentIds(move(documents), id_map));
+        if (options.compact) {
+            reordered_server.Compact();
+        }
+        PrintMemoryStats("reordered"s, reordered_server.GetMemoryStats());
+        cout << "{\"gap_encoded_bytes\":\"reordering\""s
+            << ",\"original\":"s << ComputeGapEncodedSize(search_server)
+            << ",\"reordered\":"s << ComputeGapEncodedSize(reordered_server) << "}"s << endl;
+        runner.Run("find_top_documents_seq_reordered"s, queries.size(), [&](int i) {
+            vector<Document> documents = reordered_server.FindTopDocuments(execution::seq, queries[i]);
+            id_map.ToExternalIds(documents);
+            for (const Document& document : documents) {
+                checksum += document.relevance;
+            }
+            });
+    }
+    // Writes the status every document already has, so later results do not change
+    runner.Run("set_document_status"s, options.documents, [&](int document_id) {
+        search_server.SetDocumentStatus(document_id, DocumentStatus::ACTUAL);
+        });
+    runner.Run("remove_document"s, options.documents, [&](int document_id) {
+        search_server.RemoveDocument(document_id);
+        });
+    // Recovery from a log goes through the bulk path; compare with add_document
+    runner.Run("add_documents_bulk"s, 1, [&](int) {
+        vector<DocumentInput> documents;
+        documents.reserve(options.documents);
+        for (int document_id = 0; document_id < options.documents; ++document_id) {
+            documents.push_back({ document_id, get_document(document_id), DocumentStatus::ACTUAL, { 1, 2, 3 } });
+        }
+        return documents;
+        }, [&](int, vector<DocumentInput> documents) {
+            SearchServer server("and in on the"s);
+            server.AddDocuments(documents);
+            checksum += server.GetDocumentCount();
+        });
+    if (options.fuzzy_dictionary > 0) {
+        mt19937 generator(options.seed);
+        vector<string> words = GenerateDictionary(generator, options.fuzzy_dictionary, 10);
+        sort(words.begin(), words.end());
+        words.erase(unique(words.begin(), words.end()), words.end());
+        FuzzyIndex fuzzy_index;
+        for (size_t i = 0; i < words.size(); ++i) {
+            fuzzy_index.Insert(words[i], static_cast<FuzzyIndex::TermId>(i));
+        }
+        cout << "{\"fuzzy_index\":"s << options.fuzzy_dictionary
+            << ",\"terms\":"s << fuzzy_index.size()
+            << ",\"bytes\":"s << fuzzy_index.GetMemoryUsage() << "}"s << endl;
+        // Dictionary words with one letter after the first replaced
+        vector<string> typos;
+        typos.reserve(options.queries);
+        for (int i = 0; i < options.queries; ++i) {
+            string word = words[(i * 7919ll) % words.size()];
+            if (word.size() > 1) {
+                word[1 + i % (word.size() - 1)] = static_cast<char>('a' + i % 26);
+            }
+            typos.push_back(move(word));
+        }
+        runner.Run("fuzzy_lookup"s, options.queries, [&](int i) {
+            fuzzy_index.ForEachWithinOneEdit(typos[i], 1, [&](string_view, FuzzyIndex::TermId id, int distance) {
+                checksum += id + distance;
+                return true;
+                });
+            });
+    }
+
+    cerr << "checksum "s << checksum << endl;
+}
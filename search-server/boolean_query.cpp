@@ -0,0 +1,256 @@
+#include "boolean_query.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "string_processing.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// Query words with parentheses split off: "(cat" is two tokens
+std::vector<std::string_view> SplitBooleanQuery(std::string_view text) {
+    std::vector<std::string_view> result;
+    for (const Token& token : WordTokenizer(text)) {
+        if (token.has_control_chars) {
+            throw std::invalid_argument("Query word "s + std::string(token.word) + " is invalid"s);
+        }
+        std::string_view word = token.word;
+        while (!word.empty()) {
+            const size_t length = word[0] == '(' || word[0] == ')' ? 1 : std::min(word.find_first_of("()"), word.size());
+            result.push_back(word.substr(0, length));
+            word.remove_prefix(length);
+        }
+    }
+    return result;
+}
+
+bool IsOperator(std::string_view token) {
+    return token == "AND" || token == "OR" || token == "NOT" || token == "(" || token == ")";
+}
+
+// Recursive descent over the grammar
+//   or  := and ("OR" and)*
+//   and := not (["AND"] not)*
+//   not := "NOT" not | "(" or ")" | word
+class BooleanQueryParser {
+public:
+    explicit BooleanQueryParser(std::vector<std::string_view> tokens)
+        : tokens_(std::move(tokens)) {
+    }
+
+    BooleanQueryNode Parse() {
+        if (tokens_.empty()) {
+            throw std::invalid_argument("Boolean query is empty"s);
+        }
+        BooleanQueryNode root = ParseOr();
+        if (position_ != tokens_.size()) {
+            throw std::invalid_argument("Unexpected "s + std::string(tokens_[position_]) + " in boolean query"s);
+        }
+        CheckNegations(root, BooleanQueryNode::Type::OR);
+        return root;
+    }
+
+private:
+    std::vector<std::string_view> tokens_;
+    size_t position_ = 0;
+
+    bool Accept(std::string_view token) {
+        if (position_ < tokens_.size() && tokens_[position_] == token) {
+            ++position_;
+            return true;
+        }
+        return false;
+    }
+
+    BooleanQueryNode ParseOr() {
+        BooleanQueryNode node{ BooleanQueryNode::Type::OR, {}, {} };
+        do {
+            node.children.push_back(ParseAnd());
+        } while (Accept("OR"));
+        return node.children.size() == 1 ? std::move(node.children[0]) : std::move(node);
+    }
+
+    BooleanQueryNode ParseAnd() {
+        BooleanQueryNode node{ BooleanQueryNode::Type::AND, {}, {} };
+        node.children.push_back(ParseNot());
+        while (position_ < tokens_.size() && tokens_[position_] != "OR" && tokens_[position_] != ")") {
+            Accept("AND");
+            node.children.push_back(ParseNot());
+        }
+        return node.children.size() == 1 ? std::move(node.children[0]) : std::move(node);
+    }
+
+    BooleanQueryNode ParseNot() {
+        if (Accept("NOT")) {
+            BooleanQueryNode node{ BooleanQueryNode::Type::NOT, {}, {} };
+            node.children.push_back(ParseNot());
+            return node;
+        }
+        if (Accept("(")) {
+            BooleanQueryNode node = ParseOr();
+            if (!Accept(")")) {
+                throw std::invalid_argument("Missing ) in boolean query"s);
+            }
+            return node;
+        }
+        if (position_ == tokens_.size() || IsOperator(tokens_[position_])) {
+            throw std::invalid_argument("Boolean query expects a word"s
+                + (position_ == tokens_.size() ? " at the end"s : " before "s + std::string(tokens_[position_])));
+        }
+        BooleanQueryNode node;
+        node.word = tokens_[position_++];
+        return node;
+    }
+
+    // A NOT excludes documents from an AND with at least one positive operand
+    static void CheckNegations(const BooleanQueryNode& node, BooleanQueryNode::Type parent_type) {
+        if (node.type == BooleanQueryNode::Type::NOT && parent_type != BooleanQueryNode::Type::AND) {
+            throw std::invalid_argument("NOT must narrow an AND, as in \"cat NOT dog\""s);
+        }
+        if (node.type == BooleanQueryNode::Type::AND
+            && std::all_of(node.children.begin(), node.children.end(), [](const BooleanQueryNode& child) {
+                return child.type == BooleanQueryNode::Type::NOT;
+                })) {
+            throw std::invalid_argument("NOT must narrow an AND, as in \"cat NOT dog\""s);
+        }
+        for (const BooleanQueryNode& child : node.children) {
+            CheckNegations(child, node.type);
+        }
+    }
+};
+
+}  // namespace
+
+BooleanQueryNode ParseBooleanQuery(std::string_view text) {
+    return BooleanQueryParser(SplitBooleanQuery(text)).Parse();
+}
+
+TermCursor::TermCursor(const Postings& postings)
+    : postings_(postings)
+    , it_(postings.begin()) {
+    Update();
+}
+
+void TermCursor::SeekTo(int target) {
+    if (document_id_ == END || document_id_ >= target) {
+        return;
+    }
+    it_ = postings_.Seek(it_, target);
+    Update();
+}
+
+size_t TermCursor::GetCost() const {
+    return postings_.size();
+}
+
+double TermCursor::GetTermFreq() const {
+    return (*it_).second;
+}
+
+const TermCursor::Postings& TermCursor::GetPostings() const {
+    return postings_;
+}
+
+void TermCursor::Update() {
+    document_id_ = it_ == postings_.end() ? END : (*it_).first;
+}
+
+AndCursor::AndCursor(std::vector<std::unique_ptr<QueryCursor>> included, std::vector<std::unique_ptr<QueryCursor>> excluded)
+    : included_(std::move(included))
+    , excluded_(std::move(excluded)) {
+    std::sort(included_.begin(), included_.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs->GetCost() < rhs->GetCost();
+        });
+    FindMatch(0);
+}
+
+void AndCursor::SeekTo(int target) {
+    if (document_id_ == END || document_id_ >= target) {
+        return;
+    }
+    FindMatch(target);
+}
+
+size_t AndCursor::GetCost() const {
+    return included_.empty() ? 0 : included_[0]->GetCost();
+}
+
+// Leapfrog: every cursor that is ahead of the candidate makes its document
+// the next candidate, so no cursor visits documents below it
+void AndCursor::FindMatch(int target) {
+    document_id_ = END;
+    if (included_.empty()) {
+        return;
+    }
+    int candidate = target;
+    while (true) {
+        included_[0]->SeekTo(candidate);
+        candidate = included_[0]->GetDocument();
+        if (candidate == END) {
+            return;
+        }
+        bool is_match = true;
+        for (size_t i = 1; i < included_.size() && is_match; ++i) {
+            included_[i]->SeekTo(candidate);
+            const int document_id = included_[i]->GetDocument();
+            if (document_id == END) {
+                return;
+            }
+            if (document_id > candidate) {
+                candidate = document_id;
+                is_match = false;
+            }
+        }
+        if (!is_match) {
+            continue;
+        }
+        for (const auto& excluded : excluded_) {
+            excluded->SeekTo(candidate);
+            if (excluded->GetDocument() == candidate) {
+                is_match = false;
+                break;
+            }
+        }
+        if (is_match) {
+            document_id_ = candidate;
+            return;
+        }
+        ++candidate;
+    }
+}
+
+OrCursor::OrCursor(std::vector<std::unique_ptr<QueryCursor>> children)
+    : children_(std::move(children)) {
+    Update();
+}
+
+void OrCursor::SeekTo(int target) {
+    if (document_id_ == END || document_id_ >= target) {
+        return;
+    }
+    for (const auto& child : children_) {
+        child->SeekTo(target);
+    }
+    Update();
+}
+
+size_t OrCursor::GetCost() const {
+    size_t result = 0;
+    for (const auto& child : children_) {
+        result += child->GetCost();
+    }
+    return result;
+}
+
+void OrCursor::Update() {
+    document_id_ = END;
+    for (const auto& child : children_) {
+        const int document_id = child->GetDocument();
+        if (document_id != END && (document_id_ == END || document_id < document_id_)) {
+            document_id_ = document_id;
+        }
+    }
+}
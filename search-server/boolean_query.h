@@ -0,0 +1,113 @@
+#pragma once
+
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "compactable_map.h"
+
+// Boolean query language: words combined with AND, OR, NOT and parentheses,
+// e.g. "cat AND (dog OR bird) NOT fish". Operators are upper case, so
+// lower-case "and" stays a word. Words next to each other are joined by AND.
+// NOT binds tightest, then AND, then OR. A NOT can only narrow an AND: it may
+// not stand alone or be an operand of OR.
+struct BooleanQueryNode {
+    enum class Type {
+        WORD,
+        AND,
+        OR,
+        NOT,
+    };
+
+    Type type = Type::WORD;
+    std::string_view word;  // a view of the query text
+    std::vector<BooleanQueryNode> children;
+};
+
+// Throws std::invalid_argument on syntax errors
+BooleanQueryNode ParseBooleanQuery(std::string_view text);
+
+// Document-at-a-time cursors over posting lists, visiting matching documents
+// in increasing id order. SeekTo jumps over documents instead of visiting
+// them, so an AND of a rare and a frequent word costs about as many seeks as
+// the rare word has postings.
+class QueryCursor {
+public:
+    static constexpr int END = -1;
+
+    virtual ~QueryCursor() = default;
+
+    // The current document, END once exhausted
+    int GetDocument() const {
+        return document_id_;
+    }
+
+    // Moves to the first matching document with id >= target
+    virtual void SeekTo(int target) = 0;
+
+    // Upper bound on the number of documents left to visit
+    virtual size_t GetCost() const = 0;
+
+protected:
+    int document_id_ = END;
+};
+
+class TermCursor : public QueryCursor {
+public:
+    using Postings = CompactableMap<int, double>;
+
+    explicit TermCursor(const Postings& postings);
+
+    void SeekTo(int target) override;
+    size_t GetCost() const override;
+
+    // Term frequency in the current document
+    double GetTermFreq() const;
+    const Postings& GetPostings() const;
+
+private:
+    const Postings& postings_;
+    Postings::const_iterator it_;
+
+    void Update();
+};
+
+// Documents matched by all of the included cursors and by none of the excluded
+class AndCursor : public QueryCursor {
+public:
+    AndCursor(std::vector<std::unique_ptr<QueryCursor>> included, std::vector<std::unique_ptr<QueryCursor>> excluded);
+
+    void SeekTo(int target) override;
+    size_t GetCost() const override;
+
+private:
+    // The rarest first: it proposes candidates, the others only confirm them
+    std::vector<std::unique_ptr<QueryCursor>> included_;
+    std::vector<std::unique_ptr<QueryCursor>> excluded_;
+
+    void FindMatch(int target);
+};
+
+class OrCursor : public QueryCursor {
+public:
+    explicit OrCursor(std::vector<std::unique_ptr<QueryCursor>> children);
+
+    void SeekTo(int target) override;
+    size_t GetCost() const override;
+
+private:
+    std::vector<std::unique_ptr<QueryCursor>> children_;
+
+    void Update();
+};
+
+// Matches nothing, for words missing from the index
+class EmptyCursor : public QueryCursor {
+public:
+    void SeekTo(int) override {
+    }
+
+    size_t GetCost() const override {
+        return 0;
+    }
+};
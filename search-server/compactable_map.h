@@ -0,0 +1,208 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Ordered map kept either as a tree, cheap to update anywhere, or after
+// Compact() as a sorted array of pairs: a third of the memory per entry and
+// a sequential scan, but inserting or erasing before the last key moves the
+// tail. Appending a key greater than all others stays cheap in both forms,
+// which is what adding documents with growing ids does to posting lists.
+//
+// Iterators yield (key, value) pairs by value.
+template <typename Key, typename Value>
+class CompactableMap {
+    using Tree = std::map<Key, Value, std::less<Key>, CountingAllocator<std::pair<const Key, Value>>>;
+    using Entry = std::pair<Key, Value>;
+    using Array = std::vector<Entry, CountingAllocator<Entry>>;
+
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry*;
+        using reference = Entry;
+
+        const_iterator() = default;
+
+        Entry operator*() const {
+            return is_array_ ? *array_it_ : Entry{ tree_it_->first, tree_it_->second };
+        }
+
+        const_iterator& operator++() {
+            if (is_array_) {
+                ++array_it_;
+            }
+            else {
+                ++tree_it_;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return is_array_ ? array_it_ == other.array_it_ : tree_it_ == other.tree_it_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class CompactableMap;
+
+        explicit const_iterator(typename Tree::const_iterator it)
+            : tree_it_(it) {
+        }
+
+        explicit const_iterator(typename Array::const_iterator it)
+            : array_it_(it)
+            , is_array_(true) {
+        }
+
+        typename Tree::const_iterator tree_it_;
+        typename Array::const_iterator array_it_;
+        bool is_array_ = false;
+    };
+
+    CompactableMap() = default;
+
+    explicit CompactableMap(MemoryCounter* counter, bool is_compact = false)
+        : tree_(CountingAllocator<std::pair<const Key, Value>>(counter))
+        , array_(CountingAllocator<Entry>(counter))
+        , is_compact_(is_compact) {
+    }
+
+    size_t size() const {
+        return is_compact_ ? array_.size() : tree_.size();
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    const_iterator begin() const {
+        return is_compact_ ? const_iterator(array_.begin()) : const_iterator(tree_.begin());
+    }
+
+    const_iterator end() const {
+        return is_compact_ ? const_iterator(array_.end()) : const_iterator(tree_.end());
+    }
+
+    size_t count(const Key& key) const {
+        if (!is_compact_) {
+            return tree_.count(key);
+        }
+        const auto it = LowerBound(key);
+        return it != array_.end() && !(key < it->first) ? 1 : 0;
+    }
+
+    Value& operator[](const Key& key) {
+        if (!is_compact_) {
+            return tree_[key];
+        }
+        if (array_.empty() || array_.back().first < key) {
+            return array_.emplace_back(key, Value{}).second;
+        }
+        auto it = LowerBound(key);
+        if (key < it->first) {
+            it = array_.insert(it, Entry{ key, Value{} });
+        }
+        return it->second;
+    }
+
+    size_t erase(const Key& key) {
+        if (!is_compact_) {
+            return tree_.erase(key);
+        }
+        const auto it = LowerBound(key);
+        if (it == array_.end() || key < it->first) {
+            return 0;
+        }
+        array_.erase(it);
+        return 1;
+    }
+
+    // The first entry at or after from with a key not less than the given
+    // one. Galloping over the array: cost grows with the log of the distance
+    // skipped, not of the size. The tree takes a few steps forward before
+    // descending from the root.
+    const_iterator Seek(const_iterator from, const Key& key) const {
+        if (is_compact_) {
+            const auto first = from.array_it_;
+            const size_t size = array_.end() - first;
+            if (size == 0 || !(first->first < key)) {
+                return from;
+            }
+            // first[low] < key holds throughout
+            size_t low = 0;
+            size_t high = 1;
+            while (high < size && first[high].first < key) {
+                low = high;
+                high *= 2;
+            }
+            return const_iterator(std::lower_bound(first + low + 1, first + std::min(high + 1, size), key,
+                [](const Entry& entry, const Key& target) {
+                    return entry.first < target;
+                }));
+        }
+        auto it = from.tree_it_;
+        for (int step = 0; step < TREE_SCAN_STEPS; ++step, ++it) {
+            if (it == tree_.end() || !(it->first < key)) {
+                return const_iterator(it);
+            }
+        }
+        return const_iterator(tree_.lower_bound(key));
+    }
+
+    bool IsCompact() const {
+        return is_compact_;
+    }
+
+    // Moves the entries to the sorted array, allocated at its exact size
+    void Compact() {
+        if (is_compact_) {
+            return;
+        }
+        Array array(array_.get_allocator());
+        array.reserve(tree_.size());
+        for (const auto& [key, value] : tree_) {
+            array.emplace_back(key, value);
+        }
+        array_ = std::move(array);
+        tree_.clear();
+        is_compact_ = true;
+    }
+
+private:
+    static constexpr int TREE_SCAN_STEPS = 4;
+
+    Tree tree_;
+    Array array_;
+    bool is_compact_ = false;
+
+    typename Array::const_iterator LowerBound(const Key& key) const {
+        return std::lower_bound(array_.begin(), array_.end(), key, [](const Entry& entry, const Key& target) {
+            return entry.first < target;
+            });
+    }
+
+    typename Array::iterator LowerBound(const Key& key) {
+        return std::lower_bound(array_.begin(), array_.end(), key, [](const Entry& entry, const Key& target) {
+            return entry.first < target;
+            });
+    }
+};
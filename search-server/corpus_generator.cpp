@@ -0,0 +1,89 @@
+#include "corpus_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution<int>(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution<int>('a', 'z')(generator));
+    }
+    return word;
+}
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    }
+    return queries;
+}
+
+ZipfDistribution::ZipfDistribution(size_t size, double exponent) {
+    if (size == 0) {
+        throw invalid_argument("Zipf distribution needs at least one rank"s);
+    }
+    cumulative_.reserve(size);
+    double sum = 0.0;
+    for (size_t rank = 0; rank < size; ++rank) {
+        sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+        cumulative_.push_back(sum);
+    }
+}
+
+size_t ZipfDistribution::operator()(mt19937& generator) const {
+    const double value = uniform_real_distribution<>(0, cumulative_.back())(generator);
+    const size_t rank = upper_bound(cumulative_.begin(), cumulative_.end(), value) - cumulative_.begin();
+    return min(rank, cumulative_.size() - 1);
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary,
+    const ZipfDistribution& distribution, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[distribution(generator) % dictionary.size()];
+    }
+    return query;
+}
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary,
+    const ZipfDistribution& distribution, int query_count, int max_word_count, double minus_prob) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, distribution, max_word_count, minus_prob));
+    }
+    return queries;
+}
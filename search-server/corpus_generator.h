@@ -0,0 +1,30 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Synthetic corpora for benchmarks. Words are drawn either uniformly from the
+// dictionary or, with a ZipfDistribution, with frequency falling off by rank
+// like in natural text.
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count);
+
+// Ranks 0..size-1 with P(rank) proportional to 1 / (rank + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent);
+
+    size_t operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary,
+    const ZipfDistribution& distribution, int word_count, double minus_prob = 0);
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary,
+    const ZipfDistribution& distribution, int query_count, int max_word_count, double minus_prob = 0);
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cmath>
 #include <iostream>
 
+const double DELTA = 1e-6;
+
 struct Document {
     Document() = default;
 
@@ -14,4 +17,11 @@ struct Document {
     int id = 0;
     double relevance = 0.0;
     int rating = 0;
+};
+
+enum class DocumentStatus {
+    ACTUAL,
+    IRRELEVANT,
+    BANNED,
+    REMOVED,
 };
\ No newline at end of file
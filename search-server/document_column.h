@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "memory_stats.h"
+
+// Records keyed by document id in parallel arrays sorted by id: a lookup is
+// a binary search over contiguous ids, and a scan of an id range is one
+// sequential sweep over the records.
+//
+// An id above all present ones is appended; a smaller one shifts the tail.
+// Removal leaves a tombstone and costs a lookup: the record is reset and the
+// id stays in place, to be reused if it is added again. Tombstones are
+// dropped once they make up half of the arrays.
+template <typename Record>
+class DocumentColumn {
+public:
+    // Visits live documents in id order; dereferences to the id
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        const_iterator() = default;
+
+        const int& operator*() const {
+            return column_->ids_[slot_];
+        }
+
+        const Record& GetRecord() const {
+            return column_->records_[slot_];
+        }
+
+        const_iterator& operator++() {
+            ++slot_;
+            SkipRemoved();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return slot_ == other.slot_;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class DocumentColumn;
+
+        // Stops at end_slot, the end of the range the iterator belongs to
+        const_iterator(const DocumentColumn* column, size_t slot, size_t end_slot)
+            : column_(column)
+            , slot_(slot)
+            , end_slot_(end_slot) {
+            SkipRemoved();
+        }
+
+        void SkipRemoved() {
+            while (slot_ < end_slot_ && column_->is_removed_[slot_]) {
+                ++slot_;
+            }
+        }
+
+        const DocumentColumn* column_ = nullptr;
+        size_t slot_ = 0;
+        size_t end_slot_ = 0;
+    };
+
+    using Range = std::pair<const_iterator, const_iterator>;
+
+    // Ids and tombstone flags are counted by id_counter, records by record_counter
+    explicit DocumentColumn(MemoryCounter* id_counter = nullptr, MemoryCounter* record_counter = nullptr)
+        : ids_(CountingAllocator<int>(id_counter))
+        , is_removed_(CountingAllocator<bool>(id_counter))
+        , records_(CountingAllocator<Record>(record_counter)) {
+    }
+
+    size_t size() const {
+        return ids_.size() - removed_count_;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    size_t count(int id) const {
+        return FindSlot(id) == NOT_FOUND ? 0 : 1;
+    }
+
+    const Record& at(int id) const {
+        const size_t slot = FindSlot(id);
+        if (slot == NOT_FOUND) {
+            throw std::out_of_range("Unknown document id");
+        }
+        return records_[slot];
+    }
+
+    Record& at(int id) {
+        return const_cast<Record&>(std::as_const(*this).at(id));
+    }
+
+    // Replaces the record if the id is present
+    Record& emplace(int id, Record record) {
+        const auto it = std::lower_bound(ids_.begin(), ids_.end(), id);
+        const size_t slot = it - ids_.begin();
+        if (it == ids_.end() || *it != id) {
+            ids_.insert(it, id);
+            is_removed_.insert(is_removed_.begin() + slot, false);
+            records_.insert(records_.begin() + slot, std::move(record));
+            return records_[slot];
+        }
+        if (is_removed_[slot]) {
+            is_removed_[slot] = false;
+            --removed_count_;
+        }
+        records_[slot] = std::move(record);
+        return records_[slot];
+    }
+
+    size_t erase(int id) {
+        const size_t slot = FindSlot(id);
+        if (slot == NOT_FOUND) {
+            return 0;
+        }
+        records_[slot] = Record{};
+        is_removed_[slot] = true;
+        ++removed_count_;
+        if (removed_count_ * 2 > ids_.size()) {
+            DropRemoved();
+        }
+        return 1;
+    }
+
+    // Calls function(id, record) for live documents in id order
+    template <typename Function>
+    void ForEach(Function function) {
+        for (size_t slot = 0; slot < ids_.size(); ++slot) {
+            if (!is_removed_[slot]) {
+                function(ids_[slot], records_[slot]);
+            }
+        }
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0, ids_.size());
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, ids_.size(), ids_.size());
+    }
+
+    // Documents with first_id <= id < last_id
+    Range GetRange(int first_id, int last_id) const {
+        const size_t first = LowerSlot(first_id);
+        const size_t last = std::max(first, LowerSlot(last_id));
+        return { const_iterator(this, first, last), const_iterator(this, last, last) };
+    }
+
+    // Splits the range into at most part_count consecutive parts of about
+    // the same number of slots; tombstones may make the parts uneven
+    std::vector<Range> Partition(const Range& range, size_t part_count) const {
+        std::vector<Range> result;
+        const size_t first = range.first.slot_;
+        const size_t last = std::max(first, range.second.slot_);
+        if (first == last || part_count == 0) {
+            return result;
+        }
+        part_count = std::min(part_count, last - first);
+        result.reserve(part_count);
+        for (size_t part = 0; part < part_count; ++part) {
+            const size_t part_first = first + (last - first) * part / part_count;
+            const size_t part_last = first + (last - first) * (part + 1) / part_count;
+            result.push_back({ const_iterator(this, part_first, part_last), const_iterator(this, part_last, part_last) });
+        }
+        return result;
+    }
+
+private:
+    static constexpr size_t NOT_FOUND = static_cast<size_t>(-1);
+
+    std::vector<int, CountingAllocator<int>> ids_;
+    std::vector<bool, CountingAllocator<bool>> is_removed_;
+    std::vector<Record, CountingAllocator<Record>> records_;
+    size_t removed_count_ = 0;
+
+    size_t LowerSlot(int id) const {
+        return std::lower_bound(ids_.begin(), ids_.end(), id) - ids_.begin();
+    }
+
+    size_t FindSlot(int id) const {
+        const size_t slot = LowerSlot(id);
+        return slot < ids_.size() && ids_[slot] == id && !is_removed_[slot] ? slot : NOT_FOUND;
+    }
+
+    void DropRemoved() {
+        size_t kept = 0;
+        for (size_t slot = 0; slot < ids_.size(); ++slot) {
+            if (is_removed_[slot]) {
+                continue;
+            }
+            if (kept != slot) {
+                ids_[kept] = ids_[slot];
+                records_[kept] = std::move(records_[slot]);
+            }
+            ++kept;
+        }
+        ids_.resize(kept);
+        is_removed_.assign(kept, false);
+        records_.erase(records_.begin() + kept, records_.end());
+        removed_count_ = 0;
+        // Give the memory back after mass removals
+        if (kept * 4 < ids_.capacity()) {
+            ids_.shrink_to_fit();
+            is_removed_.shrink_to_fit();
+            records_.shrink_to_fit();
+        }
+    }
+};
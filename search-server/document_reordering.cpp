@@ -0,0 +1,224 @@
+#include "document_reordering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "varint.h"
+
+using namespace std::string_literals;
+
+namespace {
+
+// Ranges this small are left in the order they have
+const size_t MIN_BISECTION_SIZE = 16;
+const int BISECTION_ITERATIONS = 20;
+
+class GraphBisection {
+public:
+    // document_terms[i] are the term ids of document i
+    GraphBisection(const std::vector<std::vector<uint32_t>>& document_terms, size_t term_count)
+        : document_terms_(document_terms)
+        , left_degrees_(term_count)
+        , right_degrees_(term_count)
+        , log2_(document_terms.size() + 2) {
+        for (size_t i = 1; i < log2_.size(); ++i) {
+            log2_[i] = std::log2(static_cast<double>(i));
+        }
+    }
+
+    void Bisect(std::vector<uint32_t>::iterator first, std::vector<uint32_t>::iterator last) {
+        const size_t size = last - first;
+        if (size <= MIN_BISECTION_SIZE) {
+            return;
+        }
+        const auto middle = first + size / 2;
+        for (int iteration = 0; iteration < BISECTION_ITERATIONS; ++iteration) {
+            if (!SwapDocuments(first, middle, last)) {
+                break;
+            }
+        }
+        Bisect(first, middle);
+        Bisect(middle, last);
+    }
+
+private:
+    const std::vector<std::vector<uint32_t>>& document_terms_;
+    // Documents of each term in the left and right half
+    std::vector<int> left_degrees_;
+    std::vector<int> right_degrees_;
+    std::vector<double> log2_;
+    std::vector<std::pair<double, uint32_t>> left_gains_;
+    std::vector<std::pair<double, uint32_t>> right_gains_;
+
+    // Estimated bits of a term's id gaps in a part of size documents
+    double ComputeCost(int degree, size_t size) const {
+        return degree * (log2_[size] - log2_[degree + 1]);
+    }
+
+    // How much moving the document to the other half lowers the cost
+    double ComputeMoveGain(uint32_t document, bool is_left, size_t left_size, size_t right_size) const {
+        double gain = 0.0;
+        for (const uint32_t term : document_terms_[document]) {
+            const int from = is_left ? left_degrees_[term] : right_degrees_[term];
+            const int to = is_left ? right_degrees_[term] : left_degrees_[term];
+            const size_t from_size = is_left ? left_size : right_size;
+            const size_t to_size = is_left ? right_size : left_size;
+            gain += ComputeCost(from, from_size) + ComputeCost(to, to_size)
+                - ComputeCost(from - 1, from_size) - ComputeCost(to + 1, to_size);
+        }
+        return gain;
+    }
+
+    // Swaps the pairs of documents whose moves lower the cost together, the
+    // best first; false if there are none
+    bool SwapDocuments(std::vector<uint32_t>::iterator first, std::vector<uint32_t>::iterator middle,
+        std::vector<uint32_t>::iterator last) {
+
+        const size_t left_size = middle - first;
+        const size_t right_size = last - middle;
+        for (auto it = first; it != last; ++it) {
+            auto& degrees = it < middle ? left_degrees_ : right_degrees_;
+            for (const uint32_t term : document_terms_[*it]) {
+                ++degrees[term];
+            }
+        }
+        left_gains_.clear();
+        right_gains_.clear();
+        for (auto it = first; it != last; ++it) {
+            const bool is_left = it < middle;
+            (is_left ? left_gains_ : right_gains_).emplace_back(ComputeMoveGain(*it, is_left, left_size, right_size), *it);
+        }
+        for (auto it = first; it != last; ++it) {
+            for (const uint32_t term : document_terms_[*it]) {
+                left_degrees_[term] = 0;
+                right_degrees_[term] = 0;
+            }
+        }
+
+        const auto by_gain = [](const auto& lhs, const auto& rhs) {
+            return lhs.first > rhs.first;
+        };
+        std::sort(left_gains_.begin(), left_gains_.end(), by_gain);
+        std::sort(right_gains_.begin(), right_gains_.end(), by_gain);
+        size_t swap_count = 0;
+        while (swap_count < left_gains_.size() && swap_count < right_gains_.size()
+            && left_gains_[swap_count].first + right_gains_[swap_count].first > 0.0) {
+            std::swap(left_gains_[swap_count].second, right_gains_[swap_count].second);
+            ++swap_count;
+        }
+        auto it = first;
+        for (const auto& [_, document] : left_gains_) {
+            *it++ = document;
+        }
+        for (const auto& [_, document] : right_gains_) {
+            *it++ = document;
+        }
+        return swap_count > 0;
+    }
+};
+
+}  // namespace
+
+DocumentIdMap::DocumentIdMap(std::vector<int> external_ids)
+    : external_ids_(std::move(external_ids)) {
+    internal_ids_.reserve(external_ids_.size());
+    for (size_t i = 0; i < external_ids_.size(); ++i) {
+        if (!internal_ids_.emplace(external_ids_[i], static_cast<int>(i)).second) {
+            throw std::invalid_argument("Document id "s + std::to_string(external_ids_[i]) + " is repeated"s);
+        }
+    }
+}
+
+int DocumentIdMap::ToExternal(int internal_id) const {
+    if (internal_id < 0 || static_cast<size_t>(internal_id) >= external_ids_.size()) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    return external_ids_[internal_id];
+}
+
+int DocumentIdMap::ToInternal(int external_id) const {
+    const auto it = internal_ids_.find(external_id);
+    if (it == internal_ids_.end()) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    return it->second;
+}
+
+void DocumentIdMap::ToExternalIds(std::vector<Document>& documents) const {
+    for (Document& document : documents) {
+        document.id = ToExternal(document.id);
+    }
+}
+
+size_t DocumentIdMap::size() const {
+    return external_ids_.size();
+}
+
+DocumentIdMap ComputeDocumentOrder(const SearchServer& search_server) {
+    std::vector<int> external_ids(search_server.begin(), search_server.end());
+
+    // Term ids of words found in two documents or more
+    std::unordered_map<std::string_view, int> document_freqs;
+    for (const SearchServer::DocumentView document : search_server.GetDocuments()) {
+        for (const auto [word, _] : document.word_frequencies) {
+            ++document_freqs[word];
+        }
+    }
+    std::unordered_map<std::string_view, uint32_t> term_ids;
+    for (const auto& [word, document_freq] : document_freqs) {
+        if (document_freq > 1) {
+            term_ids.emplace(word, static_cast<uint32_t>(term_ids.size()));
+        }
+    }
+    std::vector<std::vector<uint32_t>> document_terms;
+    document_terms.reserve(external_ids.size());
+    for (const SearchServer::DocumentView document : search_server.GetDocuments()) {
+        std::vector<uint32_t>& terms = document_terms.emplace_back();
+        for (const auto [word, _] : document.word_frequencies) {
+            const auto it = term_ids.find(word);
+            if (it != term_ids.end()) {
+                terms.push_back(it->second);
+            }
+        }
+    }
+
+    std::vector<uint32_t> order(external_ids.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    GraphBisection(document_terms, term_ids.size()).Bisect(order.begin(), order.end());
+
+    std::vector<int> ordered_ids;
+    ordered_ids.reserve(order.size());
+    for (const uint32_t document : order) {
+        ordered_ids.push_back(external_ids[document]);
+    }
+    return DocumentIdMap(std::move(ordered_ids));
+}
+
+std::vector<DocumentInput> MapDocumentIds(std::vector<DocumentInput> documents, const DocumentIdMap& id_map) {
+    for (DocumentInput& document : documents) {
+        document.id = id_map.ToInternal(document.id);
+    }
+    return documents;
+}
+
+size_t ComputeGapEncodedSize(const SearchServer& search_server) {
+    // Posting lists are in id order, so a scan in id order meets each list's
+    // ids one after another
+    std::unordered_map<std::string_view, int64_t> last_ids;
+    size_t result = 0;
+    for (const SearchServer::DocumentView document : search_server.GetDocuments()) {
+        for (const auto [word, _] : document.word_frequencies) {
+            const auto [it, is_first] = last_ids.try_emplace(word, -1);
+            result += GetVarintSize(static_cast<uint64_t>(document.id - it->second));
+            it->second = document.id;
+        }
+    }
+    return result;
+}
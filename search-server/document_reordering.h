@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "search_server.h"
+
+// Offline reordering of documents for bulk builds. Callers pick document
+// ids, so documents with the same words end up scattered over the id space,
+// and posting lists jump around the document column and have large id gaps.
+// A reordered build gives documents new internal ids, ordered so that
+// documents sharing words get close ids, and maps results back.
+//
+//     const DocumentIdMap id_map = ComputeDocumentOrder(loaded_server);
+//     reordered_server.AddDocuments(MapDocumentIds(inputs, id_map));
+//     id_map.ToExternalIds(found_documents);
+
+// Internal ids are 0, 1, ... in the order of the external ids given
+class DocumentIdMap {
+public:
+    DocumentIdMap() = default;
+    // Throws std::invalid_argument on repeated ids
+    explicit DocumentIdMap(std::vector<int> external_ids);
+
+    // Both throw std::invalid_argument for an id not in the map
+    int ToExternal(int internal_id) const;
+    int ToInternal(int external_id) const;
+
+    void ToExternalIds(std::vector<Document>& documents) const;
+
+    size_t size() const;
+
+private:
+    std::vector<int> external_ids_;
+    std::unordered_map<int, int> internal_ids_;
+};
+
+// Recursive graph bisection (Dhulipala et al., 2016): the documents are split
+// in halves, and documents are swapped between the halves while that lowers
+// the estimated cost of storing each word's id gaps, then each half is split
+// again. Words found in a single document are left out, as they add the same
+// cost to every order.
+DocumentIdMap ComputeDocumentOrder(const SearchServer& search_server);
+
+// The documents with internal ids, for SearchServer::AddDocuments. Throws
+// std::invalid_argument for a document missing from the map.
+std::vector<DocumentInput> MapDocumentIds(std::vector<DocumentInput> documents, const DocumentIdMap& id_map);
+
+// Bytes the posting lists would take with document ids stored as gaps in a
+// variable-length byte code, the usual first step of posting compression
+size_t ComputeGapEncodedSize(const SearchServer& search_server);
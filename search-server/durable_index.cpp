@@ -0,0 +1,112 @@
+#include "durable_index.h"
+
+#include <map>
+
+DurableIndex::DurableIndex(SearchServer& server, std::string snapshot_path, std::string log_path)
+    : server_(server)
+    , snapshot_path_(std::move(snapshot_path))
+    , log_path_(std::move(log_path)) {
+
+    std::vector<LogRecord> records = ReadLog(snapshot_path_).records;
+    LogContents log = ReadLog(log_path_);
+    records.insert(records.end(), std::make_move_iterator(log.records.begin()), std::make_move_iterator(log.records.end()));
+    const std::vector<DocumentInput> documents = ReplayLog(std::move(records));
+    server_.AddDocuments(documents);
+    recovered_document_count_ = documents.size();
+    log_ = std::make_unique<WriteAheadLog>(log_path_, log.valid_size);
+}
+
+DurableIndex::Sequence DurableIndex::AddDocument(int document_id, std::string_view document,
+    DocumentStatus status, const std::vector<int>& ratings) {
+
+    std::lock_guard guard(mutex_);
+    server_.AddDocument(document_id, document, status, ratings);
+    return log_->Append({ LogRecord::Type::ADD_DOCUMENT, DocumentInput{ document_id, std::string(document), status, ratings } });
+}
+
+DurableIndex::Sequence DurableIndex::RemoveDocument(int document_id) {
+    std::lock_guard guard(mutex_);
+    server_.RemoveDocument(document_id);
+    LogRecord record;
+    record.type = LogRecord::Type::REMOVE_DOCUMENT;
+    record.document.id = document_id;
+    return log_->Append(record);
+}
+
+DurableIndex::Sequence DurableIndex::SetDocumentStatus(int document_id, DocumentStatus status) {
+    std::lock_guard guard(mutex_);
+    server_.SetDocumentStatus(document_id, status);
+    LogRecord record;
+    record.type = LogRecord::Type::SET_STATUS;
+    record.document.id = document_id;
+    record.document.status = status;
+    return log_->Append(record);
+}
+
+DurableIndex::Sequence DurableIndex::SetDocumentRating(int document_id, const std::vector<int>& ratings) {
+    std::lock_guard guard(mutex_);
+    server_.SetDocumentRating(document_id, ratings);
+    LogRecord record;
+    record.type = LogRecord::Type::SET_RATINGS;
+    record.document.id = document_id;
+    record.document.ratings = ratings;
+    return log_->Append(record);
+}
+
+void DurableIndex::WaitDurable(Sequence sequence) {
+    log_->WaitDurable(sequence);
+}
+
+void DurableIndex::Checkpoint() {
+    std::lock_guard guard(mutex_);
+    log_->Sync();
+    // The server keeps no texts, so the snapshot is rebuilt from the files
+    std::vector<LogRecord> records = ReadLog(snapshot_path_).records;
+    std::vector<LogRecord> log_records = ReadLog(log_path_).records;
+    records.insert(records.end(), std::make_move_iterator(log_records.begin()), std::make_move_iterator(log_records.end()));
+    std::vector<LogRecord> snapshot;
+    for (DocumentInput& document : ReplayLog(std::move(records))) {
+        snapshot.push_back({ LogRecord::Type::ADD_DOCUMENT, std::move(document) });
+    }
+    WriteSnapshot(snapshot_path_, snapshot);
+    log_->Truncate();
+}
+
+size_t DurableIndex::GetRecoveredDocumentCount() const {
+    return recovered_document_count_;
+}
+
+const WriteAheadLog& DurableIndex::GetLog() const {
+    return *log_;
+}
+
+std::vector<DocumentInput> ReplayLog(std::vector<LogRecord> records) {
+    std::map<int, DocumentInput> documents;
+    for (LogRecord& record : records) {
+        const int id = record.document.id;
+        if (record.type == LogRecord::Type::ADD_DOCUMENT) {
+            documents[id] = std::move(record.document);
+            continue;
+        }
+        if (record.type == LogRecord::Type::REMOVE_DOCUMENT) {
+            documents.erase(id);
+            continue;
+        }
+        const auto it = documents.find(id);
+        if (it == documents.end()) {
+            continue;
+        }
+        if (record.type == LogRecord::Type::SET_STATUS) {
+            it->second.status = record.document.status;
+        }
+        else {
+            it->second.ratings = std::move(record.document.ratings);
+        }
+    }
+    std::vector<DocumentInput> result;
+    result.reserve(documents.size());
+    for (auto& [id, document] : documents) {
+        result.push_back(std::move(document));
+    }
+    return result;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+#include "write_ahead_log.h"
+
+// Makes the updates of a SearchServer survive a restart. The state on disk
+// is a snapshot of the documents plus the write-ahead log of the updates
+// made since; a checkpoint folds the log into a new snapshot.
+//
+// Updates are applied to the server first, so invalid ones throw and are
+// never logged, then appended to the log without waiting for the disk. The
+// server is not made thread-safe: searches must not run during updates.
+class DurableIndex {
+public:
+    using Sequence = WriteAheadLog::Sequence;
+
+    // Recovers the documents of the snapshot and the log into the server
+    // with one AddDocuments call, then continues the log
+    DurableIndex(SearchServer& server, std::string snapshot_path, std::string log_path);
+
+    // The update is durable once WaitDurable returns for the result
+    Sequence AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    Sequence RemoveDocument(int document_id);
+    Sequence SetDocumentStatus(int document_id, DocumentStatus status);
+    Sequence SetDocumentRating(int document_id, const std::vector<int>& ratings);
+
+    void WaitDurable(Sequence sequence);
+
+    // Writes the current documents as the new snapshot and empties the log.
+    // A crash in between only makes recovery replay updates the snapshot
+    // already has, which leaves the same documents.
+    void Checkpoint();
+
+    size_t GetRecoveredDocumentCount() const;
+    const WriteAheadLog& GetLog() const;
+
+private:
+    SearchServer& server_;
+    const std::string snapshot_path_;
+    const std::string log_path_;
+    // Keeps the order of updates in the log the order they had in the server
+    std::mutex mutex_;
+    std::unique_ptr<WriteAheadLog> log_;
+    size_t recovered_document_count_ = 0;
+};
+
+// Documents left after applying the records in order: a later addition of
+// an id replaces an earlier one, a removal drops it, status and rating
+// updates change it in place. Sorted by id.
+std::vector<DocumentInput> ReplayLog(std::vector<LogRecord> records);
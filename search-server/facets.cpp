@@ -0,0 +1,50 @@
+#include "facets.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+using namespace std::string_literals;
+
+void CountStatuses(const std::vector<uint8_t>& statuses, SearchFacets& facets) {
+    for (size_t status = 0; status < FACET_STATUS_COUNT; ++status) {
+        const uint8_t target = static_cast<uint8_t>(status);
+        uint32_t count = 0;
+        for (const uint8_t value : statuses) {
+            count += value == target;
+        }
+        facets.status_counts[status] = count;
+    }
+}
+
+void CountRatings(const std::vector<int>& ratings, SearchFacets& facets) {
+    if (!std::is_sorted(facets.rating_bounds.begin(), facets.rating_bounds.end())) {
+        throw std::invalid_argument("Rating bounds must be sorted"s);
+    }
+    // Ratings at or above each bound; bucket counts are the differences
+    std::vector<size_t> at_least(facets.rating_bounds.size());
+    for (size_t i = 0; i < facets.rating_bounds.size(); ++i) {
+        const int bound = facets.rating_bounds[i];
+        uint32_t count = 0;
+        for (const int rating : ratings) {
+            count += rating >= bound;
+        }
+        at_least[i] = count;
+    }
+    facets.rating_counts.assign(facets.rating_bounds.size() + 1, 0);
+    size_t above = ratings.size();
+    for (size_t i = 0; i < at_least.size(); ++i) {
+        facets.rating_counts[i] = above - at_least[i];
+        above = at_least[i];
+    }
+    facets.rating_counts.back() = above;
+}
+
+void SearchFacetsHooks::CountFacets() {
+    facets_.total_hits = ratings_.size();
+    for (const auto& [_, status] : rejected_documents_) {
+        statuses_.push_back(static_cast<uint8_t>(status));
+    }
+    CountStatuses(statuses_, facets_);
+    CountRatings(ratings_, facets_);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "document.h"
+#include "search_hooks.h"
+
+// One per DocumentStatus, indexed by its value
+const size_t FACET_STATUS_COUNT = 4;
+
+// Aggregates shown next to the top results, filled by the scoring pass of
+// SearchServer::FindTopDocuments through SearchFacetsHooks
+struct SearchFacets {
+    // Set by the caller: rating bucket i holds ratings in
+    // [rating_bounds[i - 1], rating_bounds[i]), the first and last buckets
+    // are open-ended. Must be sorted, or the search throws
+    // std::invalid_argument.
+    std::vector<int> rating_bounds = { 1, 2, 3, 4, 5 };
+
+    // Documents matching the query that the predicate accepted
+    size_t total_hits = 0;
+    // Documents matching the query by status, whatever the predicate says
+    std::array<size_t, FACET_STATUS_COUNT> status_counts{};
+    // Ratings of the accepted documents, rating_bounds.size() + 1 buckets
+    std::vector<size_t> rating_counts;
+};
+
+// Counts over columns of the matched documents' metadata: statuses of all
+// of them, ratings of the accepted ones. The loops are branch-free
+// comparisons summed in 32-bit lanes over contiguous arrays, which GCC
+// vectorizes at -O3 (or -O2 -ftree-vectorize).
+void CountStatuses(const std::vector<uint8_t>& statuses, SearchFacets& facets);
+void CountRatings(const std::vector<int>& ratings, SearchFacets& facets);
+
+// Collects the columns while FindAllDocuments scores a query: status and
+// rating of every result, and the matches the predicate rejects, which
+// minus words and phrases then exclude like the results
+class SearchFacetsHooks : public NoSearchHooks {
+public:
+    explicit SearchFacetsHooks(SearchFacets& facets)
+        : facets_(facets) {
+    }
+
+    void OnPredicateRejected(int document_id, DocumentStatus status) {
+        rejected_documents_.emplace(document_id, status);
+    }
+
+    void OnDocumentMatched(DocumentStatus status, int rating) {
+        statuses_.push_back(static_cast<uint8_t>(status));
+        ratings_.push_back(rating);
+    }
+
+    std::map<int, DocumentStatus>* GetRejectedDocuments() {
+        return &rejected_documents_;
+    }
+
+    // Fills the facets from the collected columns once the search is done
+    void CountFacets();
+
+private:
+    SearchFacets& facets_;
+    std::vector<uint8_t> statuses_;
+    std::vector<int> ratings_;
+    std::map<int, DocumentStatus> rejected_documents_;
+};
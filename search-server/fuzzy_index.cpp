@@ -0,0 +1,135 @@
+#include "fuzzy_index.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+namespace {
+const int SLOT_BITS = 32;
+
+uint32_t HashKey(std::string_view key) {
+    return static_cast<uint32_t>(std::hash<std::string_view>{}(key) >> SLOT_BITS);
+}
+}
+
+void FuzzyIndex::Insert(std::string_view term, TermId id) {
+    const uint64_t slot = terms_.size();
+    terms_.emplace_back(term, id);
+    for (const uint32_t key : ComputeKeys(term)) {
+        const uint64_t entry = static_cast<uint64_t>(key) << SLOT_BITS | slot;
+        std::vector<uint64_t>& bucket = GetBucket(key);
+        bucket.insert(std::upper_bound(bucket.begin(), bucket.end(), entry), entry);
+        ++entry_count_;
+    }
+    if (entry_count_ > buckets_.size() * MAX_BUCKET_SIZE) {
+        Grow();
+    }
+}
+
+size_t FuzzyIndex::size() const {
+    return terms_.size();
+}
+
+size_t FuzzyIndex::GetMemoryUsage() const {
+    size_t result = sizeof(*this) + terms_.capacity() * sizeof(terms_[0]) + buckets_.capacity() * sizeof(buckets_[0]);
+    for (const auto& bucket : buckets_) {
+        result += bucket.capacity() * sizeof(uint64_t);
+    }
+    return result;
+}
+
+int FuzzyIndex::ComputeDistanceUpToOne(std::string_view lhs, std::string_view rhs) {
+    if (lhs.size() > rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    if (rhs.size() - lhs.size() > 1) {
+        return 2;
+    }
+    const size_t mismatch = std::mismatch(lhs.begin(), lhs.end(), rhs.begin()).first - lhs.begin();
+    if (mismatch == lhs.size() && lhs.size() == rhs.size()) {
+        return 0;
+    }
+    if (lhs.size() < rhs.size()) {
+        return lhs.substr(mismatch) == rhs.substr(mismatch + 1) ? 1 : 2;
+    }
+    if (lhs.substr(mismatch + 1) == rhs.substr(mismatch + 1)) {
+        return 1;
+    }
+    const bool is_transposed = mismatch + 1 < lhs.size()
+        && lhs[mismatch] == rhs[mismatch + 1] && lhs[mismatch + 1] == rhs[mismatch]
+        && lhs.substr(mismatch + 2) == rhs.substr(mismatch + 2);
+    return is_transposed ? 1 : 2;
+}
+
+std::vector<uint64_t>& FuzzyIndex::GetBucket(uint32_t key) {
+    return buckets_[bucket_bits_ == 0 ? 0 : key >> (32 - bucket_bits_)];
+}
+
+const std::vector<uint64_t>& FuzzyIndex::GetBucket(uint32_t key) const {
+    return buckets_[bucket_bits_ == 0 ? 0 : key >> (32 - bucket_bits_)];
+}
+
+void FuzzyIndex::Grow() {
+    // The next bit of the hash splits every bucket into two, both sorted
+    ++bucket_bits_;
+    const uint64_t split_bit = uint64_t{ 1 } << (64 - bucket_bits_);
+    std::vector<std::vector<uint64_t>> buckets(buckets_.size() * 2);
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+        const auto& bucket = buckets_[i];
+        const auto middle = std::partition_point(bucket.begin(), bucket.end(), [split_bit](uint64_t entry) {
+            return (entry & split_bit) == 0;
+            });
+        buckets[2 * i].assign(bucket.begin(), middle);
+        buckets[2 * i + 1].assign(middle, bucket.end());
+    }
+    buckets_ = std::move(buckets);
+}
+
+std::vector<std::pair<uint32_t, int>> FuzzyIndex::FindWithinOneEdit(std::string_view word, size_t exact_prefix_length) const {
+    std::vector<uint32_t> slots;
+    for (const uint32_t key : ComputeKeys(word)) {
+        const uint64_t first = static_cast<uint64_t>(key) << SLOT_BITS;
+        const uint64_t last = first | UINT32_MAX;
+        const std::vector<uint64_t>& bucket = GetBucket(key);
+        for (auto it = std::lower_bound(bucket.begin(), bucket.end(), first); it != bucket.end() && *it <= last; ++it) {
+            slots.push_back(static_cast<uint32_t>(*it));
+        }
+    }
+    std::sort(slots.begin(), slots.end());
+    slots.erase(std::unique(slots.begin(), slots.end()), slots.end());
+
+    const std::string_view exact_prefix = word.substr(0, exact_prefix_length);
+    std::vector<std::pair<uint32_t, int>> result;
+    for (const uint32_t slot : slots) {
+        const std::string_view term = terms_[slot].first;
+        if (term.substr(0, exact_prefix.size()) != exact_prefix) {
+            continue;
+        }
+        const int distance = ComputeDistanceUpToOne(word, term);
+        if (distance <= 1) {
+            result.push_back({ slot, distance });
+        }
+    }
+    std::sort(result.begin(), result.end(), [this](const auto& lhs, const auto& rhs) {
+        return terms_[lhs.first].first < terms_[rhs.first].first;
+        });
+    return result;
+}
+
+std::vector<uint32_t> FuzzyIndex::ComputeKeys(std::string_view term) {
+    std::vector<uint32_t> keys;
+    keys.reserve(term.size() + 1);
+    keys.push_back(HashKey(term));
+    std::string deletion;
+    for (size_t i = 0; i < term.size(); ++i) {
+        // Deleting any character of a run gives the same string
+        if (i > 0 && term[i] == term[i - 1]) {
+            continue;
+        }
+        deletion.assign(term.substr(0, i)).append(term.substr(i + 1));
+        keys.push_back(HashKey(deletion));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
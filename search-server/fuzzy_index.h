@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Typo lookup by single deletions, as in SymSpell. A term is indexed under
+// itself and under every string made by deleting one of its characters.
+// Two words one edit apart (an insertion, deletion or substitution of a
+// character, or a transposition of two adjacent ones) always share such a
+// key, so a lookup probes the word's length + 1 keys instead of walking
+// the dictionary. Characters are bytes, as everywhere in the server.
+//
+// A key is kept as a 32-bit hash packed with the term's slot into one
+// 64-bit entry. The top bits of the hash pick a bucket, a short sorted
+// array of entries, and the buckets double once they hold
+// MAX_BUCKET_SIZE entries on average, so both an insertion and a probe
+// touch a few cache lines. Hash collisions only add candidates, which are
+// compared with the word anyway.
+class FuzzyIndex {
+public:
+    using TermId = uint32_t;
+
+    // The term must outlive the index
+    void Insert(std::string_view term, TermId id);
+
+    size_t size() const;
+    size_t GetMemoryUsage() const;
+
+    // Calls callback(term, id, distance) for terms within one edit of the
+    // word which share its first exact_prefix_length characters, in
+    // lexicographic order, while the callback returns true. The word itself
+    // comes with distance 0 if it is indexed.
+    template <typename Callback>
+    void ForEachWithinOneEdit(std::string_view word, size_t exact_prefix_length, Callback callback) const;
+
+    // 0 for equal words, 1 for words one edit apart, 2 for all others
+    static int ComputeDistanceUpToOne(std::string_view lhs, std::string_view rhs);
+
+private:
+    static constexpr size_t MAX_BUCKET_SIZE = 64;
+
+    std::vector<std::pair<std::string_view, TermId>> terms_;  // by slot
+    // Entries hold the key hash in the high half and the slot in the low one
+    std::vector<std::vector<uint64_t>> buckets_ = std::vector<std::vector<uint64_t>>(1);
+    int bucket_bits_ = 0;
+    size_t entry_count_ = 0;
+
+    std::vector<uint64_t>& GetBucket(uint32_t key);
+    const std::vector<uint64_t>& GetBucket(uint32_t key) const;
+    void Grow();
+    // Slots and distances of the matching terms, in term order
+    std::vector<std::pair<uint32_t, int>> FindWithinOneEdit(std::string_view word, size_t exact_prefix_length) const;
+    // Hashes of the term and of its single deletions, without repeats
+    static std::vector<uint32_t> ComputeKeys(std::string_view term);
+};
+
+template <typename Callback>
+void FuzzyIndex::ForEachWithinOneEdit(std::string_view word, size_t exact_prefix_length, Callback callback) const {
+    for (const auto& [slot, distance] : FindWithinOneEdit(word, exact_prefix_length)) {
+        const auto& [term, id] = terms_[slot];
+        if (!callback(term, id, distance)) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Log-linear latency buckets: values below 16 ns get their own bucket,
+// every further power of two is split into 4 buckets (under 19% error).
+// Values above ~1100 s land in the last bucket.
+namespace latency_buckets {
+
+const int EXACT_COUNT = 16;
+const int SUB_BUCKETS = 4;
+const int MAX_EXPONENT = 40;
+const int COUNT = EXACT_COUNT + (MAX_EXPONENT - 4 + 1) * SUB_BUCKETS;
+
+inline int GetIndex(uint64_t value) {
+    if (value < EXACT_COUNT) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > MAX_EXPONENT) {
+        return COUNT - 1;
+    }
+    const int sub_bucket = static_cast<int>((value >> (exponent - 2)) & (SUB_BUCKETS - 1));
+    return EXACT_COUNT + (exponent - 4) * SUB_BUCKETS + sub_bucket;
+}
+
+// The largest value that falls into the bucket
+inline uint64_t GetUpperBound(int index) {
+    if (index < EXACT_COUNT) {
+        return static_cast<uint64_t>(index);
+    }
+    const int exponent = (index - EXACT_COUNT) / SUB_BUCKETS + 4;
+    const uint64_t sub_bucket = (index - EXACT_COUNT) % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub_bucket + 1) << (exponent - 2)) - 1;
+}
+
+}  // namespace latency_buckets
+
+class LatencyHistogram {
+public:
+    void Add(uint64_t value_ns, uint64_t count = 1) {
+        counts_[latency_buckets::GetIndex(value_ns)] += count;
+        total_ += count;
+    }
+
+    void AddBucket(int index, uint64_t count) {
+        counts_[index] += count;
+        total_ += count;
+    }
+
+    void Merge(const LatencyHistogram& other) {
+        for (int i = 0; i < latency_buckets::COUNT; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+    }
+
+    uint64_t GetTotal() const {
+        return total_;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile, 0 if empty
+    uint64_t GetQuantile(double q) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(q * total_);
+        if (rank >= total_) {
+            rank = total_ - 1;
+        }
+        uint64_t seen = 0;
+        for (int i = 0; i < latency_buckets::COUNT; ++i) {
+            seen += counts_[i];
+            if (seen > rank) {
+                return latency_buckets::GetUpperBound(i);
+            }
+        }
+        return latency_buckets::GetUpperBound(latency_buckets::COUNT - 1);
+    }
+
+private:
+    std::array<uint64_t, latency_buckets::COUNT> counts_{};
+    uint64_t total_ = 0;
+};
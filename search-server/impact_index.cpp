@@ -0,0 +1,83 @@
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Bytes of the color, parent and child pointers in a std::map node
+const size_t TREE_NODE_OVERHEAD = 4 * sizeof(void*);
+
+}  // namespace
+
+ImpactIndex::ImpactIndex(const std::map<std::string_view, ScoredPostings>& term_scores) {
+    double max_score = 0.0;
+    size_t posting_count = 0;
+    for (const auto& [_, postings] : term_scores) {
+        for (const auto& [document_id, score] : postings) {
+            max_score = std::max(max_score, score);
+        }
+        posting_count += postings.size();
+    }
+    if (max_score <= 0.0) {
+        return;
+    }
+    score_per_impact_ = max_score / MAX_IMPACT;
+    document_ids_.reserve(posting_count);
+
+    std::vector<std::pair<uint32_t, int>> impacts;
+    for (const auto& [word, postings] : term_scores) {
+        impacts.clear();
+        for (const auto& [document_id, score] : postings) {
+            if (score > 0.0) {
+                const double impact = std::round(score / score_per_impact_);
+                impacts.emplace_back(static_cast<uint32_t>(std::clamp(impact, 1.0, static_cast<double>(MAX_IMPACT))), document_id);
+            }
+        }
+        if (impacts.empty()) {
+            continue;
+        }
+        // Decreasing impact, increasing id within an impact
+        std::sort(impacts.begin(), impacts.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+            });
+        const size_t first_segment = segments_.size();
+        for (const auto& [impact, document_id] : impacts) {
+            if (segments_.size() == first_segment || segments_.back().impact != impact) {
+                segments_.push_back({ impact, document_ids_.size(), document_ids_.size() });
+            }
+            document_ids_.push_back(document_id);
+            ++segments_.back().last;
+        }
+        terms_.emplace(word, std::make_pair(first_segment, segments_.size()));
+    }
+    document_ids_.shrink_to_fit();
+    segments_.shrink_to_fit();
+}
+
+std::vector<ImpactIndex::Segment> ImpactIndex::GetSegments(std::string_view word) const {
+    std::vector<Segment> result;
+    const auto it = terms_.find(word);
+    if (it == terms_.end()) {
+        return result;
+    }
+    for (size_t i = it->second.first; i < it->second.second; ++i) {
+        const StoredSegment& segment = segments_[i];
+        result.push_back({ segment.impact, document_ids_.data() + segment.first, document_ids_.data() + segment.last });
+    }
+    return result;
+}
+
+double ImpactIndex::GetScore(uint64_t impact) const {
+    return impact * score_per_impact_;
+}
+
+size_t ImpactIndex::GetPostingCount() const {
+    return document_ids_.size();
+}
+
+size_t ImpactIndex::GetMemoryUsage() const {
+    return terms_.size() * (sizeof(decltype(terms_)::value_type) + TREE_NODE_OVERHEAD)
+        + segments_.capacity() * sizeof(StoredSegment)
+        + document_ids_.capacity() * sizeof(int);
+}
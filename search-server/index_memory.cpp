@@ -0,0 +1,161 @@
+#include "index_memory.h"
+
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <new>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+namespace {
+
+// From <numaif.h>, which comes with libnuma rather than the C library
+const int MPOL_INTERLEAVE_MODE = 3;
+const unsigned long MPOL_F_MEMS_ALLOWED_FLAG = 1ul << 2;
+const size_t MAX_NUMA_NODES = 1024;
+const size_t NODE_MASK_WORDS = MAX_NUMA_NODES / (8 * sizeof(unsigned long));
+
+// Small blocks are pooled, larger ones go to the huge-page resource directly
+const size_t LARGEST_POOLED_BLOCK = size_t{ 64 } << 10;
+const size_t MAX_BLOCKS_PER_CHUNK = size_t{ 1 } << 16;
+
+size_t RoundUpToHugePages(size_t bytes) {
+    return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+// Spreads the pages of the range over the nodes the process may use. True
+// if the policy is set or there is only one node.
+bool InterleaveNumaNodes(void* address, size_t size) {
+#if defined(SYS_get_mempolicy) && defined(SYS_mbind)
+    unsigned long node_mask[NODE_MASK_WORDS] = {};
+    if (syscall(SYS_get_mempolicy, nullptr, node_mask, MAX_NUMA_NODES, nullptr, MPOL_F_MEMS_ALLOWED_FLAG) != 0) {
+        return false;
+    }
+    int node_count = 0;
+    for (const unsigned long word : node_mask) {
+        node_count += __builtin_popcountl(word);
+    }
+    if (node_count <= 1) {
+        return true;
+    }
+    return syscall(SYS_mbind, address, size, MPOL_INTERLEAVE_MODE, node_mask, MAX_NUMA_NODES, 0) == 0;
+#else
+    (void)address;
+    (void)size;
+    return false;
+#endif
+}
+
+}  // namespace
+
+HugePageMemoryResource::HugePageMemoryResource(const IndexMemoryOptions& options, std::pmr::memory_resource* upstream)
+    : options_(options)
+    , upstream_(upstream) {
+}
+
+IndexMemoryStats HugePageMemoryResource::GetStats() const {
+    IndexMemoryStats result;
+    result.mapped_bytes = mapped_bytes_.load(std::memory_order_relaxed);
+    result.explicit_huge_page_bytes = explicit_huge_page_bytes_.load(std::memory_order_relaxed);
+    result.fallback_count = fallback_count_.load(std::memory_order_relaxed);
+    return result;
+}
+
+void* HugePageMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    if (bytes < HUGE_PAGE_MIN_ALLOCATION || alignment > HUGE_PAGE_SIZE) {
+        return upstream_->allocate(bytes, alignment);
+    }
+    return Map(bytes);
+}
+
+void HugePageMemoryResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    if (bytes < HUGE_PAGE_MIN_ALLOCATION || alignment > HUGE_PAGE_SIZE) {
+        upstream_->deallocate(pointer, bytes, alignment);
+        return;
+    }
+    const size_t size = RoundUpToHugePages(bytes);
+    munmap(pointer, size);
+    mapped_bytes_.fetch_sub(size, std::memory_order_relaxed);
+}
+
+bool HugePageMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+void* HugePageMemoryResource::Map(size_t bytes) {
+    const size_t size = RoundUpToHugePages(bytes);
+    char* result = nullptr;
+    if (options_.huge_pages == IndexMemoryOptions::HugePages::EXPLICIT) {
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping != MAP_FAILED) {
+            result = static_cast<char*>(mapping);
+            explicit_huge_page_bytes_.fetch_add(size, std::memory_order_relaxed);
+        }
+        else {
+            fallback_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (result == nullptr) {
+        // A huge page needs a 2MB aligned range: map one page more and trim
+        void* mapping = mmap(nullptr, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        char* const first = static_cast<char*>(mapping);
+        result = first + (HUGE_PAGE_SIZE - reinterpret_cast<uintptr_t>(first) % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+        if (result != first) {
+            munmap(first, result - first);
+        }
+        char* const last = first + size + HUGE_PAGE_SIZE;
+        if (result + size != last) {
+            munmap(result + size, last - (result + size));
+        }
+        if (options_.huge_pages != IndexMemoryOptions::HugePages::NONE && madvise(result, size, MADV_HUGEPAGE) != 0) {
+            fallback_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (options_.interleave_numa_nodes && !InterleaveNumaNodes(result, size)) {
+        fallback_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    mapped_bytes_.fetch_add(size, std::memory_order_relaxed);
+    return result;
+}
+
+IndexMemoryResource::IndexMemoryResource(const IndexMemoryOptions& options)
+    : huge_pages_(options)
+    , pool_(std::pmr::pool_options{ MAX_BLOCKS_PER_CHUNK, LARGEST_POOLED_BLOCK }, &huge_pages_) {
+}
+
+IndexMemoryStats IndexMemoryResource::GetStats() const {
+    return huge_pages_.GetStats();
+}
+
+void* IndexMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+    return pool_.allocate(bytes, alignment);
+}
+
+void IndexMemoryResource::do_deallocate(void* pointer, size_t bytes, size_t alignment) {
+    pool_.deallocate(pointer, bytes, alignment);
+}
+
+bool IndexMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+size_t GetTransparentHugePageBytes() {
+    std::ifstream smaps("/proc/self/smaps_rollup"s);
+    std::string name;
+    size_t kilobytes = 0;
+    while (smaps >> name) {
+        if (name == "AnonHugePages:"s && smaps >> kilobytes) {
+            return kilobytes << 10;
+        }
+        smaps.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+// Memory for large read-mostly index structures. Posting lists and the
+// document column are read at random by every query thread, so with 4KB
+// pages most of their lookups miss the TLB, and memory first touched by the
+// thread that built the index sits on that thread's NUMA node.
+//
+// HugePageMemoryResource maps every allocation of at least
+// HUGE_PAGE_MIN_ALLOCATION on its own, rounded up to 2MB pages, and asks the
+// kernel to back it with huge pages and to interleave it over the NUMA
+// nodes. Each step falls back quietly when the kernel refuses it: explicit
+// huge pages to transparent ones, transparent ones to normal pages, and
+// interleaving to the default first-touch policy. Smaller allocations go to
+// the upstream resource. IndexMemoryResource puts a pool in front of it,
+// so that small nodes are carved out of large huge-page chunks too.
+//
+// Measure the effect with perf counters, e.g.
+//     perf stat -e dTLB-loads,dTLB-load-misses benchmark --index-memory thp
+const size_t HUGE_PAGE_SIZE = size_t{ 2 } << 20;
+const size_t HUGE_PAGE_MIN_ALLOCATION = HUGE_PAGE_SIZE / 2;
+
+struct IndexMemoryOptions {
+    enum class HugePages {
+        NONE,
+        TRANSPARENT,  // madvise(MADV_HUGEPAGE)
+        EXPLICIT,  // MAP_HUGETLB from the pool reserved in vm.nr_hugepages
+    };
+
+    HugePages huge_pages = HugePages::TRANSPARENT;
+    bool interleave_numa_nodes = false;
+};
+
+struct IndexMemoryStats {
+    size_t mapped_bytes = 0;
+    size_t explicit_huge_page_bytes = 0;
+    // Mappings where the kernel refused a requested huge page or NUMA policy
+    size_t fallback_count = 0;
+};
+
+class HugePageMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit HugePageMemoryResource(const IndexMemoryOptions& options,
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+
+    IndexMemoryStats GetStats() const;
+
+private:
+    const IndexMemoryOptions options_;
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> mapped_bytes_{ 0 };
+    std::atomic<size_t> explicit_huge_page_bytes_{ 0 };
+    std::atomic<size_t> fallback_count_{ 0 };
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    void* Map(size_t bytes);
+};
+
+// Thread-safe pool over huge-page memory, shared by the containers of a
+// SearchServer
+class IndexMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit IndexMemoryResource(const IndexMemoryOptions& options);
+
+    IndexMemoryStats GetStats() const;
+
+private:
+    HugePageMemoryResource huge_pages_;
+    std::pmr::synchronized_pool_resource pool_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Bytes of this process backed by transparent huge pages, from
+// /proc/self/smaps_rollup; 0 where it is not available
+size_t GetTransparentHugePageBytes();
@@ -0,0 +1,287 @@
+// Load generator for QueryServer (see query_server.h). Every connection
+// runs in its own thread and keeps up to --pipeline requests in flight;
+// --requests are spread evenly over --connections. Queries are generated
+// like the benchmark's, from a dictionary drawn the same way as
+// query_server's. Prints one JSON line in the benchmark's format:
+//
+// {"benchmark":"query_server","connections":16,"pipeline":8,
+//  "operations":100000,"errors":0,"seconds":...,"ops_per_second":...,
+//  "p50_ns":...,"p99_ns":...,"p999_ns":...}
+//
+// Latency runs from the write of a request to the read of its response.
+//
+// Usage: load_generator [--address host:port|unix:path] [--connections N]
+//                       [--pipeline N] [--requests N] [--queries N]
+//                       [--dictionary N] [--query-words N] [--zipf S]
+//                       [--seed N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "corpus_generator.h"
+#include "histogram.h"
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct LoadOptions {
+    string address = "127.0.0.1:8080"s;
+    int connections = 16;
+    int pipeline = 8;
+    int requests = 100'000;
+    int queries = 1'000;
+    int dictionary = 50'000;
+    int query_words = 5;
+    double zipf = 1.0;
+    unsigned seed = 42;
+};
+
+struct ConnectionResult {
+    LatencyHistogram latency;
+    size_t errors = 0;
+};
+
+void PrintUsage() {
+    cerr << "Usage: load_generator [--address host:port|unix:path] [--connections N] [--pipeline N]"s
+        << " [--requests N] [--queries N] [--dictionary N] [--query-words N] [--zipf S] [--seed N]"s << endl;
+}
+
+bool ParseOptions(int argc, char* argv[], LoadOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const string name = argv[i];
+        if (name == "--help"s || i + 1 == argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        try {
+            if (name == "--address"s) {
+                options.address = value;
+            }
+            else if (name == "--connections"s) {
+                options.connections = stoi(value);
+            }
+            else if (name == "--pipeline"s) {
+                options.pipeline = stoi(value);
+            }
+            else if (name == "--requests"s) {
+                options.requests = stoi(value);
+            }
+            else if (name == "--queries"s) {
+                options.queries = stoi(value);
+            }
+            else if (name == "--dictionary"s) {
+                options.dictionary = stoi(value);
+            }
+            else if (name == "--query-words"s) {
+                options.query_words = stoi(value);
+            }
+            else if (name == "--zipf"s) {
+                options.zipf = stod(value);
+            }
+            else if (name == "--seed"s) {
+                options.seed = static_cast<unsigned>(stoul(value));
+            }
+            else {
+                return false;
+            }
+        }
+        catch (const logic_error&) {
+            return false;
+        }
+    }
+    return options.connections > 0 && options.pipeline > 0 && options.requests > 0
+        && options.queries > 0 && options.dictionary > 0 && options.query_words > 0;
+}
+
+// A blocking socket connected to the address in QueryServerOptions' format
+int Connect(const string& address) {
+    int fd = -1;
+    int result = -1;
+    if (address.compare(0, 5, "unix:"s) == 0) {
+        sockaddr_un socket_address{};
+        const string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof socket_address.sun_path) {
+            throw invalid_argument("Invalid Unix socket path "s + path);
+        }
+        socket_address.sun_family = AF_UNIX;
+        memcpy(socket_address.sun_path, path.c_str(), path.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0) {
+            result = connect(fd, reinterpret_cast<const sockaddr*>(&socket_address), sizeof socket_address);
+        }
+    }
+    else {
+        const size_t colon = address.rfind(':');
+        sockaddr_in socket_address{};
+        socket_address.sin_family = AF_INET;
+        if (colon == string::npos || inet_pton(AF_INET, address.substr(0, colon).c_str(), &socket_address.sin_addr) != 1) {
+            throw invalid_argument("Invalid address "s + address);
+        }
+        socket_address.sin_port = htons(static_cast<uint16_t>(stoi(address.substr(colon + 1))));
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0) {
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof enable);
+            result = connect(fd, reinterpret_cast<const sockaddr*>(&socket_address), sizeof socket_address);
+        }
+    }
+    if (result != 0) {
+        const int error = errno;
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw system_error(error, generic_category(), "Cannot connect to "s + address);
+    }
+    return fd;
+}
+
+void SendAll(int fd, const string& data) {
+    for (size_t sent = 0; sent < data.size();) {
+        const ssize_t size = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "Cannot send requests"s);
+        }
+        sent += size;
+    }
+}
+
+// Sends request_count queries starting at first_query, refilling the
+// pipeline as responses arrive
+ConnectionResult RunConnection(const LoadOptions& options, const vector<string>& queries, size_t first_query, int request_count) {
+    ConnectionResult result;
+    const int fd = Connect(options.address);
+    deque<Clock::time_point> send_times;
+    string requests;
+    string input;
+    char buffer[16 << 10];
+    int sent_count = 0;
+    int received_count = 0;
+    try {
+        while (received_count < request_count) {
+            // Requests that fit into the pipeline go out in one write
+            requests.clear();
+            while (sent_count < request_count && static_cast<int>(send_times.size()) < options.pipeline) {
+                requests += queries[(first_query + sent_count) % queries.size()];
+                requests += '\n';
+                send_times.push_back(Clock::now());
+                ++sent_count;
+            }
+            if (!requests.empty()) {
+                SendAll(fd, requests);
+            }
+
+            const ssize_t size = recv(fd, buffer, sizeof buffer, 0);
+            if (size < 0 && errno == EINTR) {
+                continue;
+            }
+            if (size <= 0) {
+                throw runtime_error("Connection closed by the server"s);
+            }
+            const Clock::time_point now = Clock::now();
+            input.append(buffer, size);
+            size_t begin = 0;
+            for (size_t end = input.find('\n'); end != string::npos; end = input.find('\n', begin)) {
+                if (input.compare(begin, 2, "OK"s) != 0) {
+                    ++result.errors;
+                }
+                result.latency.Add(chrono::duration_cast<chrono::nanoseconds>(now - send_times.front()).count());
+                send_times.pop_front();
+                ++received_count;
+                begin = end + 1;
+            }
+            input.erase(0, begin);
+        }
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    return result;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    LoadOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    mt19937 generator(options.seed);
+    const vector<string> dictionary = GenerateDictionary(generator, options.dictionary, 10);
+    const ZipfDistribution distribution(dictionary.size(), options.zipf);
+    const vector<string> queries = GenerateQueries(generator, dictionary, distribution, options.queries, options.query_words, 0.1);
+
+    // An exception escaping a thread would terminate the program
+    vector<ConnectionResult> results(options.connections);
+    vector<exception_ptr> errors(options.connections);
+    vector<thread> threads;
+    const Clock::time_point start = Clock::now();
+    for (int i = 0; i < options.connections; ++i) {
+        const int request_count = options.requests / options.connections + (i < options.requests % options.connections ? 1 : 0);
+        threads.emplace_back([&, i, request_count] {
+            try {
+                results[i] = RunConnection(options, queries, static_cast<size_t>(i) * queries.size() / options.connections, request_count);
+            }
+            catch (...) {
+                errors[i] = current_exception();
+            }
+            });
+    }
+    for (thread& connection_thread : threads) {
+        connection_thread.join();
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+    for (const exception_ptr& error : errors) {
+        if (error) {
+            try {
+                rethrow_exception(error);
+            }
+            catch (const exception& exception) {
+                cerr << exception.what() << endl;
+                return 1;
+            }
+        }
+    }
+
+    LatencyHistogram latency;
+    size_t error_count = 0;
+    for (const ConnectionResult& result : results) {
+        latency.Merge(result.latency);
+        error_count += result.errors;
+    }
+    cout << "{\"benchmark\":\"query_server\""s
+        << ",\"connections\":"s << options.connections
+        << ",\"pipeline\":"s << options.pipeline
+        << ",\"operations\":"s << latency.GetTotal()
+        << ",\"errors\":"s << error_count
+        << ",\"seconds\":"s << seconds
+        << ",\"ops_per_second\":"s << (seconds > 0 ? latency.GetTotal() / seconds : 0.0)
+        << ",\"p50_ns\":"s << latency.GetQuantile(0.5)
+        << ",\"p99_ns\":"s << latency.GetQuantile(0.99)
+        << ",\"p999_ns\":"s << latency.GetQuantile(0.999) << "}"s << endl;
+}
@@ -30,7 +30,7 @@ public:
 
         const auto end_time = Clock::now();
         const auto dur = end_time - start_time_;
-        std::cerr << s << ": "s << duration_cast<milliseconds>(dur).count() << " ms"s << std::endl;
+        st << s << ": "s << duration_cast<milliseconds>(dur).count() << " ms\n"s;
     }
 
 private:
@@ -19,6 +19,7 @@
 #include "request_queue.h"
 #include "test_example_functions.h"
 #include "process_queries.h"
+#include "corpus_generator.h"
 
 using namespace std;
 void PrintDocument(const Document& document) {
@@ -28,57 +29,50 @@ void PrintDocument(const Document& document) {
         << "rating = "s << document.rating << " }"s << endl;
 }
 
-string GenerateWord(mt19937& generator, int max_length) {
-    const int length = uniform_int_distribution<int>(1, max_length)(generator);
-    string word;
-    word.reserve(length);
-    for (int i = 0; i < length; ++i) {
-        word.push_back(uniform_int_distribution<int>('a', 'z')(generator));
-    }
-    return word;
-}
-vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
-    vector<string> words;
-    words.reserve(word_count);
-    for (int i = 0; i < word_count; ++i) {
-        words.push_back(GenerateWord(generator, max_length));
+template <typename ExecutionPolicy>
+void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(std::string{ mark });
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
     }
-    words.erase(unique(words.begin(), words.end()), words.end());
-    return words;
+    cout << total_relevance << endl;
 }
-string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob = 0) {
-    string query;
-    for (int i = 0; i < word_count; ++i) {
-        if (!query.empty()) {
-            query.push_back(' ');
-        }
-        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
-            query.push_back('-');
+#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
+
+template <typename Scorer>
+void TestScorer(string_view mark, const SearchServer& search_server, const vector<string>& queries, const Scorer& scorer) {
+    const auto predicate = [](int, DocumentStatus status, int) { return status == DocumentStatus::ACTUAL; };
+    LOG_DURATION(std::string{ mark });
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(execution::seq, query, predicate, scorer)) {
+            total_relevance += document.relevance;
         }
-        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
     }
-    return query;
+    cout << total_relevance << endl;
 }
-vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count) {
+#define TEST_SCORER(scorer) TestScorer(#scorer, search_server, queries, scorer{})
+
+void TestPrefixExpansion(SearchServer& search_server, const vector<string>& dictionary, size_t max_term_expansions) {
     vector<string> queries;
-    queries.reserve(query_count);
-    for (int i = 0; i < query_count; ++i) {
-        queries.push_back(GenerateQuery(generator, dictionary, max_word_count));
+    for (size_t i = 0; i < 1000; ++i) {
+        const string& word = dictionary[i * 7 % dictionary.size()];
+        queries.push_back(word.substr(0, 2) + "*"s);
     }
-    return queries;
-}
-template <typename ExecutionPolicy>
-void Test(string_view mark, const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy&& policy) {
-    LOG_DURATION(std::string( mark ));
+    search_server.SetWildcardMatching(true);
+    search_server.SetMaxTermExpansions(max_term_expansions);
+    LOG_DURATION("prefix, max expansions "s + to_string(max_term_expansions));
     double total_relevance = 0;
     for (const string_view query : queries) {
-        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+        for (const auto& document : search_server.FindTopDocuments(query)) {
             total_relevance += document.relevance;
         }
     }
     cout << total_relevance << endl;
 }
-#define TEST(policy) Test(#policy, search_server, queries, execution::policy)
 int main() {
     mt19937 generator;
     const auto dictionary = GenerateDictionary(generator, 1000, 10);
@@ -88,6 +82,14 @@ int main() {
         search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
     }
     const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+    trace::SetEnabled(true);
     TEST(seq);
     TEST(par);
+    trace::SetEnabled(false);
+    trace::PrintSnapshot(cerr);
+    TEST_SCORER(TfIdfScorer);
+    TEST_SCORER(Bm25Scorer);
+    for (const size_t max_term_expansions : { 1, 8, 64 }) {
+        TestPrefixExpansion(search_server, dictionary, max_term_expansions);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+
+// Bytes requested by the index structures of a SearchServer. Structures
+// built on CountingAllocator are exact up to the allocator's own bookkeeping;
+// the positional index, term dictionary and fuzzy index report their own
+// estimates.
+struct MemoryStats {
+    size_t dictionary_bytes = 0;  // word -> posting list map and term id tables
+    size_t postings_bytes = 0;
+    size_t forward_index_bytes = 0;  // document -> word frequencies
+    size_t documents_bytes = 0;
+    size_t document_ids_bytes = 0;
+    size_t duplicate_index_bytes = 0;
+    size_t positional_index_bytes = 0;
+    size_t term_dictionary_bytes = 0;
+    size_t fuzzy_index_bytes = 0;
+    size_t impact_index_bytes = 0;
+
+    size_t GetTotal() const {
+        return dictionary_bytes + postings_bytes + forward_index_bytes + documents_bytes
+            + document_ids_bytes + duplicate_index_bytes + positional_index_bytes + term_dictionary_bytes
+            + fuzzy_index_bytes + impact_index_bytes;
+    }
+};
+
+// Shared by all allocators of one structure. Containers of a structure may be
+// changed from several threads at once, as RemoveDocument(par) does.
+class MemoryCounter {
+public:
+    void Add(size_t bytes) {
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void Subtract(size_t bytes) {
+        bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    size_t GetBytes() const {
+        return bytes_.load(std::memory_order_relaxed);
+    }
+
+    // Allocators counting here take their memory from the resource, or from
+    // std::allocator if it is null. It can only change while nothing is
+    // counted, so every block goes back where it came from.
+    void SetResource(std::pmr::memory_resource* resource) {
+        if (GetBytes() != 0) {
+            throw std::logic_error("Memory resource must be set before anything is allocated");
+        }
+        resource_ = resource;
+    }
+
+    std::pmr::memory_resource* GetResource() const {
+        return resource_;
+    }
+
+private:
+    std::atomic<size_t> bytes_{ 0 };
+    std::pmr::memory_resource* resource_ = nullptr;
+};
+
+// std::allocator that adds every allocation to a counter, and takes the
+// memory from the counter's resource if it has one. A default constructed
+// allocator counts nothing.
+template <typename T>
+class CountingAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    CountingAllocator() noexcept = default;
+
+    explicit CountingAllocator(MemoryCounter* counter) noexcept
+        : counter_(counter) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+        : counter_(other.GetCounter()) {
+    }
+
+    T* allocate(size_t n) {
+        if (counter_ == nullptr) {
+            return std::allocator<T>{}.allocate(n);
+        }
+        std::pmr::memory_resource* const resource = counter_->GetResource();
+        T* result = resource != nullptr
+            ? static_cast<T*>(resource->allocate(n * sizeof(T), alignof(T)))
+            : std::allocator<T>{}.allocate(n);
+        counter_->Add(n * sizeof(T));
+        return result;
+    }
+
+    void deallocate(T* pointer, size_t n) noexcept {
+        if (counter_ == nullptr) {
+            std::allocator<T>{}.deallocate(pointer, n);
+            return;
+        }
+        counter_->Subtract(n * sizeof(T));
+        std::pmr::memory_resource* const resource = counter_->GetResource();
+        if (resource != nullptr) {
+            resource->deallocate(pointer, n * sizeof(T), alignof(T));
+        }
+        else {
+            std::allocator<T>{}.deallocate(pointer, n);
+        }
+    }
+
+    MemoryCounter* GetCounter() const noexcept {
+        return counter_;
+    }
+
+private:
+    MemoryCounter* counter_ = nullptr;
+};
+
+template <typename T, typename U>
+bool operator==(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return lhs.GetCounter() == rhs.GetCounter();
+}
+
+template <typename T, typename U>
+bool operator!=(const CountingAllocator<T>& lhs, const CountingAllocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
@@ -0,0 +1,139 @@
+#include "near_duplicates.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+namespace {
+
+// Bytes of the next pointer and cached hash in a node of std::unordered_map
+const size_t HASH_NODE_OVERHEAD = 2 * sizeof(void*);
+
+// splitmix64 finalizer: every input bit affects every output bit
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xBF58476D1CE4E5B9ull;
+    value ^= value >> 27;
+    value *= 0x94D049BB133111EBull;
+    value ^= value >> 31;
+    return value;
+}
+
+int FindRoot(std::vector<int>& parents, int index) {
+    while (parents[index] != index) {
+        parents[index] = parents[parents[index]];
+        index = parents[index];
+    }
+    return index;
+}
+
+}  // namespace
+
+MinHashSignature::MinHashSignature() {
+    values_.fill(std::numeric_limits<uint32_t>::max());
+}
+
+void MinHashSignature::AddWord(std::string_view word) {
+    const uint64_t word_hash = std::hash<std::string_view>{}(word);
+    // One hash function per position, each seeded by the position
+    for (int i = 0; i < MINHASH_SIZE; ++i) {
+        const uint32_t value = static_cast<uint32_t>(Mix(word_hash + (i + 1) * 0x9E3779B97F4A7C15ull) >> 32);
+        values_[i] = std::min(values_[i], value);
+    }
+}
+
+uint64_t MinHashSignature::GetBandHash(int band) const {
+    uint64_t result = static_cast<uint64_t>(band);
+    for (int row = 0; row < MINHASH_ROWS; ++row) {
+        result = Mix(result ^ values_[band * MINHASH_ROWS + row]);
+    }
+    return result;
+}
+
+void NearDuplicateIndex::Add(int document_id, const MinHashSignature& signature) {
+    signatures_.emplace(document_id, signature);
+    for (int band = 0; band < MINHASH_BANDS; ++band) {
+        buckets_[band][signature.GetBandHash(band)].push_back(document_id);
+    }
+}
+
+void NearDuplicateIndex::Remove(int document_id) {
+    const auto it = signatures_.find(document_id);
+    if (it == signatures_.end()) {
+        return;
+    }
+    for (int band = 0; band < MINHASH_BANDS; ++band) {
+        const auto bucket = buckets_[band].find(it->second.GetBandHash(band));
+        auto& ids = bucket->second;
+        ids.erase(std::find(ids.begin(), ids.end(), document_id));
+        if (ids.empty()) {
+            buckets_[band].erase(bucket);
+        }
+    }
+    signatures_.erase(it);
+}
+
+size_t NearDuplicateIndex::size() const {
+    return signatures_.size();
+}
+
+std::vector<std::vector<int>> NearDuplicateIndex::GetClusters(double min_similarity,
+    const std::function<double(int, int)>& compute_similarity) const {
+
+    std::vector<int> ids;
+    ids.reserve(signatures_.size());
+    for (const auto& [document_id, _] : signatures_) {
+        ids.push_back(document_id);
+    }
+    std::sort(ids.begin(), ids.end());
+    std::unordered_map<int, int> id_to_index;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        id_to_index[ids[i]] = static_cast<int>(i);
+    }
+
+    std::vector<int> parents(ids.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    const auto join_if_similar = [&](int lhs, int rhs) {
+        const int lhs_root = FindRoot(parents, id_to_index.at(lhs));
+        const int rhs_root = FindRoot(parents, id_to_index.at(rhs));
+        if (lhs_root != rhs_root && compute_similarity(lhs, rhs) >= min_similarity) {
+            parents[std::max(lhs_root, rhs_root)] = std::min(lhs_root, rhs_root);
+        }
+    };
+    for (const auto& band_buckets : buckets_) {
+        for (const auto& [_, bucket] : band_buckets) {
+            for (size_t i = 1; i < bucket.size(); ++i) {
+                join_if_similar(bucket[0], bucket[i]);
+                if (i > 1) {
+                    join_if_similar(bucket[i - 1], bucket[i]);
+                }
+            }
+        }
+    }
+
+    // Roots are the smallest index of their group, so groups come out in order
+    std::vector<std::vector<int>> groups(ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        groups[FindRoot(parents, static_cast<int>(i))].push_back(ids[i]);
+    }
+    std::vector<std::vector<int>> result;
+    for (auto& group : groups) {
+        if (group.size() > 1) {
+            result.push_back(std::move(group));
+        }
+    }
+    return result;
+}
+
+size_t NearDuplicateIndex::GetMemoryUsage() const {
+    size_t result = sizeof(*this) + signatures_.bucket_count() * sizeof(void*)
+        + signatures_.size() * (HASH_NODE_OVERHEAD + sizeof(std::pair<const int, MinHashSignature>));
+    for (const auto& band_buckets : buckets_) {
+        result += band_buckets.bucket_count() * sizeof(void*);
+        for (const auto& [_, bucket] : band_buckets) {
+            result += HASH_NODE_OVERHEAD + sizeof(std::pair<const uint64_t, std::vector<int>>) + bucket.capacity() * sizeof(int);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Near-duplicate detection with MinHash and LSH banding. The share of equal
+// positions in two signatures estimates the Jaccard similarity of the two
+// documents' word sets. The signature is cut into MINHASH_BANDS bands of
+// MINHASH_ROWS values, and documents that agree on a whole band become
+// candidates. With 16 bands of 4 rows, a pair with similarity 0.8 is a
+// candidate with probability 0.9996 and a pair with similarity 0.3 with
+// probability 0.12. Only candidates are compared, never all pairs, and by
+// their exact similarity, so the estimate never joins dissimilar documents.
+const int MINHASH_BANDS = 16;
+const int MINHASH_ROWS = 4;
+const int MINHASH_SIZE = MINHASH_BANDS * MINHASH_ROWS;
+const double DEFAULT_NEAR_DUPLICATE_SIMILARITY = 0.8;
+
+class MinHashSignature {
+public:
+    // The signature of an empty word set
+    MinHashSignature();
+
+    // Adding a word twice changes nothing
+    void AddWord(std::string_view word);
+
+    uint64_t GetBandHash(int band) const;
+
+private:
+    std::array<uint32_t, MINHASH_SIZE> values_;
+};
+
+class NearDuplicateIndex {
+public:
+    // The id must not be in the index
+    void Add(int document_id, const MinHashSignature& signature);
+    void Remove(int document_id);
+
+    size_t size() const;
+
+    // Groups of documents joined by candidate pairs for which
+    // compute_similarity, the exact Jaccard similarity of their word sets,
+    // is at least min_similarity. Joining is transitive, so a group may hold
+    // two documents further apart than that. Each document in a band bucket
+    // is compared with the first and the previous one only, so the work
+    // stays linear in the number of documents. Groups of two or more, each
+    // sorted by id, ordered by their first id.
+    std::vector<std::vector<int>> GetClusters(double min_similarity, const std::function<double(int, int)>& compute_similarity) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    std::unordered_map<int, MinHashSignature> signatures_;
+    std::array<std::unordered_map<uint64_t, std::vector<int>>, MINHASH_BANDS> buckets_;
+};
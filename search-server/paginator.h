@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "result_cursor.h"
 
 template <typename Iterator>
 class IteratorRange {
@@ -36,38 +43,169 @@ std::ostream& operator<<(std::ostream& out, const IteratorRange<Iterator>& range
     return out;
 }
 
+// Splits [begin, end) into pages lazily: a page is only an iterator pair
+// computed when the page iterator reaches it
 template <typename Iterator>
 class Paginator {
 public:
-    Paginator(Iterator begin, Iterator end, size_t page_size) {
-        for (size_t left = distance(begin, end); left > 0;) {
-            const size_t current_page_size = std::min(page_size, left);
-           
-            const Iterator current_page_end = next(begin, current_page_size);
-            pages_.push_back({ begin, current_page_end });
+    class PageIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = IteratorRange<Iterator>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = IteratorRange<Iterator>;
+
+        PageIterator(Iterator page_begin, Iterator end, size_t page_size)
+            : page_begin_(page_begin)
+            , page_end_(GetPageEnd(page_begin, end, page_size))
+            , end_(end)
+            , page_size_(page_size) {
+        }
+
+        IteratorRange<Iterator> operator*() const {
+            return { page_begin_, page_end_ };
+        }
+
+        PageIterator& operator++() {
+            page_begin_ = page_end_;
+            page_end_ = GetPageEnd(page_begin_, end_, page_size_);
+            return *this;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return page_begin_ == other.page_begin_;
+        }
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Iterator page_begin_, page_end_, end_;
+        size_t page_size_;
 
-            left -= current_page_size;
-            begin = current_page_end;
+        // Steps over at most page_size elements, so that a pass over all
+        // pages stays linear for iterators without random access
+        static Iterator GetPageEnd(Iterator page_begin, Iterator end, size_t page_size) {
+            using Category = typename std::iterator_traits<Iterator>::iterator_category;
+            if constexpr (std::is_base_of_v<std::random_access_iterator_tag, Category>) {
+                return std::next(page_begin, std::min<size_t>(page_size, std::distance(page_begin, end)));
+            }
+            else {
+                for (size_t i = 0; i < page_size && page_begin != end; ++i) {
+                    ++page_begin;
+                }
+                return page_begin;
+            }
+        }
+    };
+
+    Paginator(Iterator begin, Iterator end, size_t page_size)
+        : begin_(begin)
+        , end_(end)
+        , page_size_(page_size) {
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive");
         }
     }
 
-    auto begin() const {
-        return pages_.begin();
+    PageIterator begin() const {
+        return PageIterator(begin_, end_, page_size_);
     }
 
-    auto end() const {
-        return pages_.end();
+    PageIterator end() const {
+        return PageIterator(end_, end_, page_size_);
     }
 
     size_t size() const {
-        return pages_.size();
+        return (std::distance(begin_, end_) + page_size_ - 1) / page_size_;
     }
 
 private:
-    std::vector<IteratorRange<Iterator>> pages_;
+    Iterator begin_, end_;
+    size_t page_size_;
 };
 
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+
+// Pages of a result cursor, fetched one at a time as the iteration advances,
+// so unread pages are never ranked. A single-pass range.
+class CursorPaginator {
+public:
+    class PageIterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::vector<Document>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const std::vector<Document>*;
+        using reference = const std::vector<Document>&;
+
+        const std::vector<Document>& operator*() const {
+            return paginator_->page_;
+        }
+        const std::vector<Document>* operator->() const {
+            return &paginator_->page_;
+        }
+
+        PageIterator& operator++() {
+            paginator_->FetchPage();
+            return *this;
+        }
+
+        bool operator==(const PageIterator& other) const {
+            return IsEnd() == other.IsEnd();
+        }
+        bool operator!=(const PageIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class CursorPaginator;
+        explicit PageIterator(CursorPaginator* paginator)
+            : paginator_(paginator) {
+        }
+
+        CursorPaginator* paginator_;
+
+        bool IsEnd() const {
+            return paginator_ == nullptr || paginator_->page_.empty();
+        }
+    };
+
+    CursorPaginator(ResultCursor& cursor, size_t page_size)
+        : cursor_(cursor)
+        , page_size_(page_size) {
+        if (page_size == 0) {
+            throw std::invalid_argument("Page size must be positive");
+        }
+    }
+
+    PageIterator begin() {
+        if (!is_started_) {
+            is_started_ = true;
+            FetchPage();
+        }
+        return PageIterator(this);
+    }
+
+    PageIterator end() {
+        return PageIterator(nullptr);
+    }
+
+private:
+    ResultCursor& cursor_;
+    const size_t page_size_;
+    std::vector<Document> page_;
+    bool is_started_ = false;
+
+    void FetchPage() {
+        page_ = cursor_.NextPage(page_size_);
+    }
+};
+
+inline CursorPaginator Paginate(ResultCursor& cursor, size_t page_size) {
+    return CursorPaginator(cursor, page_size);
+}
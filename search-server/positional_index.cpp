@@ -0,0 +1,141 @@
+#include "positional_index.h"
+
+#include <algorithm>
+#include <set>
+
+#include "varint.h"
+
+namespace {
+// Rough size of a red-black tree node header: color, parent, left, right
+const size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+}
+
+void PositionalIndex::AddDocument(int document_id, const std::vector<std::string_view>& words) {
+    std::map<std::string_view, std::vector<uint32_t>> word_positions;
+    for (uint32_t position = 0; position < words.size(); ++position) {
+        word_positions[words[position]].push_back(position);
+    }
+    for (const auto& [word, positions] : word_positions) {
+        word_to_document_positions_[word][document_id] = Encode(positions);
+    }
+}
+
+void PositionalIndex::RemoveDocument(int document_id, const std::vector<std::string_view>& words) {
+    for (const std::string_view word : words) {
+        const auto it = word_to_document_positions_.find(word);
+        if (it == word_to_document_positions_.end()) {
+            continue;
+        }
+        it->second.erase(document_id);
+        if (it->second.empty()) {
+            word_to_document_positions_.erase(it);
+        }
+    }
+}
+
+std::vector<uint32_t> PositionalIndex::GetPositions(std::string_view word, int document_id) const {
+    const auto word_it = word_to_document_positions_.find(word);
+    if (word_it == word_to_document_positions_.end()) {
+        return {};
+    }
+    const auto document_it = word_it->second.find(document_id);
+    if (document_it == word_it->second.end()) {
+        return {};
+    }
+    return Decode(document_it->second);
+}
+
+bool PositionalIndex::ContainsPhrase(const std::vector<std::string_view>& phrase, int document_id) const {
+    if (phrase.empty()) {
+        return true;
+    }
+    std::vector<std::vector<uint32_t>> positions;
+    positions.reserve(phrase.size());
+    for (const std::string_view word : phrase) {
+        positions.push_back(GetPositions(word, document_id));
+        if (positions.back().empty()) {
+            return false;
+        }
+    }
+    for (const uint32_t start : positions[0]) {
+        bool found = true;
+        for (size_t i = 1; i < positions.size() && found; ++i) {
+            found = std::binary_search(positions[i].begin(), positions[i].end(), start + static_cast<uint32_t>(i));
+        }
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::optional<uint32_t> PositionalIndex::ComputeMinSpan(const std::vector<std::string_view>& words, int document_id) const {
+    const std::set<std::string_view> unique_words(words.begin(), words.end());
+    if (unique_words.empty()) {
+        return std::nullopt;
+    }
+
+    // (position, word index) of every occurrence, sorted by position
+    std::vector<std::pair<uint32_t, size_t>> occurrences;
+    size_t word_index = 0;
+    for (const std::string_view word : unique_words) {
+        const auto positions = GetPositions(word, document_id);
+        if (positions.empty()) {
+            return std::nullopt;
+        }
+        for (const uint32_t position : positions) {
+            occurrences.push_back({ position, word_index });
+        }
+        ++word_index;
+    }
+    std::sort(occurrences.begin(), occurrences.end());
+
+    std::vector<int> in_window(unique_words.size(), 0);
+    size_t covered = 0;
+    uint32_t best = UINT32_MAX;
+    for (size_t left = 0, right = 0; right < occurrences.size(); ++right) {
+        if (in_window[occurrences[right].second]++ == 0) {
+            ++covered;
+        }
+        while (covered == unique_words.size()) {
+            best = std::min(best, occurrences[right].first - occurrences[left].first + 1);
+            if (--in_window[occurrences[left].second] == 0) {
+                --covered;
+            }
+            ++left;
+        }
+    }
+    return best;
+}
+
+size_t PositionalIndex::GetMemoryUsage() const {
+    size_t result = sizeof(*this);
+    for (const auto& [word, document_positions] : word_to_document_positions_) {
+        result += MAP_NODE_OVERHEAD + sizeof(std::pair<const std::string_view, std::map<int, EncodedPositions>>);
+        for (const auto& [document_id, data] : document_positions) {
+            result += MAP_NODE_OVERHEAD + sizeof(std::pair<const int, EncodedPositions>) + data.capacity();
+        }
+    }
+    return result;
+}
+
+PositionalIndex::EncodedPositions PositionalIndex::Encode(const std::vector<uint32_t>& positions) {
+    EncodedPositions result;
+    uint32_t previous = 0;
+    for (const uint32_t position : positions) {
+        WriteVarint(result, position - previous);
+        previous = position;
+    }
+    result.shrink_to_fit();
+    return result;
+}
+
+std::vector<uint32_t> PositionalIndex::Decode(const EncodedPositions& data) {
+    std::vector<uint32_t> result;
+    uint32_t previous = 0;
+    for (size_t offset = 0; offset < data.size();) {
+        previous += static_cast<uint32_t>(ReadVarint(data.data(), offset));
+        result.push_back(previous);
+    }
+    return result;
+}
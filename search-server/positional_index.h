@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Word positions per (word, document). Each position list is stored as
+// varint-encoded deltas. Keys are views of the SearchServer dictionary words,
+// which outlive the index.
+class PositionalIndex {
+public:
+    void AddDocument(int document_id, const std::vector<std::string_view>& words);
+    void RemoveDocument(int document_id, const std::vector<std::string_view>& words);
+
+    std::vector<uint32_t> GetPositions(std::string_view word, int document_id) const;
+
+    // Words of the phrase follow each other in the document in the same order
+    bool ContainsPhrase(const std::vector<std::string_view>& phrase, int document_id) const;
+
+    // Length of the shortest window containing all the words in any order
+    std::optional<uint32_t> ComputeMinSpan(const std::vector<std::string_view>& words, int document_id) const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    using EncodedPositions = std::vector<uint8_t>;
+
+    std::map<std::string_view, std::map<int, EncodedPositions>> word_to_document_positions_;
+
+    static EncodedPositions Encode(const std::vector<uint32_t>& positions);
+    static std::vector<uint32_t> Decode(const EncodedPositions& data);
+};
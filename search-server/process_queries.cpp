@@ -1,6 +1,8 @@
 #include "process_queries.h"
 #include <algorithm>
+#include <exception>
 #include <execution>
+#include <numeric>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
@@ -19,6 +21,40 @@ std::vector<std::vector<Document>> ProcessQueries(
 
     return res;
 }
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries) {
+
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
+}
+
+std::vector<std::vector<Document>> ProcessSimilarDocuments(
+    const SearchServer& search_server,
+    const std::vector<int>& document_ids,
+    size_t k) {
+
+    // An exception escaping a parallel algorithm would terminate the program
+    std::vector<std::vector<Document>> res(document_ids.size());
+    std::vector<std::exception_ptr> errors(document_ids.size());
+    std::vector<size_t> indexes(document_ids.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            res[i] = search_server.FindSimilarDocuments(document_ids[i], k);
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+        });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return res;
+}
+
 std::list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
@@ -9,6 +9,19 @@ std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
 
+// Same results as ProcessQueries, with queries grouped by word so that
+// frequent words are scanned once per block of queries (see
+// SearchServer::FindTopDocumentsBatch); for large offline batches
+std::vector<std::vector<Document>> ProcessQueriesBatched(
+    const SearchServer& search_server,
+    const std::vector<std::string>& queries);
+
+// Neighbours of every document for FindSimilarDocuments, computed in parallel
+std::vector<std::vector<Document>> ProcessSimilarDocuments(
+    const SearchServer& search_server,
+    const std::vector<int>& document_ids,
+    size_t k = MAX_RESULT_DOCUMENT_COUNT);
+
 std::list<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries);
\ No newline at end of file
@@ -0,0 +1,447 @@
+#include "query_server.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+namespace {
+
+const int MAX_EVENTS = 256;
+const size_t READ_SIZE = size_t{ 16 } << 10;
+// Buffers handed to one sendmsg
+const size_t MAX_WRITE_BUFFERS = 64;
+// A connection that does not read its responses is not read from either
+// while this much of them is queued
+const size_t MAX_QUEUED_OUTPUT = size_t{ 1 } << 20;
+
+std::string FormatResponse(const std::vector<Document>& documents) {
+    std::string result = "OK"s;
+    char buffer[64];
+    for (const Document& document : documents) {
+        char* const id_end = std::to_chars(buffer, buffer + sizeof buffer, document.id).ptr;
+        *id_end = ':';
+        char* const relevance_end = std::to_chars(id_end + 1, buffer + sizeof buffer, document.relevance).ptr;
+        *relevance_end = ':';
+        char* const rating_end = std::to_chars(relevance_end + 1, buffer + sizeof buffer, document.rating).ptr;
+        result += ' ';
+        result.append(buffer, rating_end);
+    }
+    result += '\n';
+    return result;
+}
+
+std::string FormatError(const std::string& message) {
+    return "ERROR "s + message + "\n"s;
+}
+
+[[noreturn]] void ThrowSystemError(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+QueryServer::QueryServer(const SearchServer& search_server, const QueryServerOptions& options)
+    : search_server_(search_server)
+    , options_(options) {
+
+    if (options_.max_batch_size == 0) {
+        throw std::invalid_argument("Batch size must be positive"s);
+    }
+    try {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            ThrowSystemError("Cannot create epoll instance"s);
+        }
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd_ < 0) {
+            ThrowSystemError("Cannot create eventfd"s);
+        }
+        Listen();
+        for (const int fd : { listen_fd_, wake_fd_ }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ThrowSystemError("Cannot watch socket"s);
+            }
+        }
+    }
+    catch (...) {
+        CloseAll();
+        throw;
+    }
+}
+
+QueryServer::~QueryServer() {
+    CloseAll();
+}
+
+int QueryServer::GetPort() const {
+    return port_;
+}
+
+QueryServerStats QueryServer::GetStats() const {
+    QueryServerStats result;
+    result.accepted_connections = accepted_connections_.load(std::memory_order_relaxed);
+    result.requests = requests_.load(std::memory_order_relaxed);
+    result.batches = batches_.load(std::memory_order_relaxed);
+    return result;
+}
+
+void QueryServer::Run() {
+    std::vector<epoll_event> events(MAX_EVENTS);
+    std::vector<Connection*> ready;
+    std::vector<Request> requests;
+    while (!is_stopped_.load()) {
+        const int count = epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait failed"s);
+        }
+
+        ready.clear();
+        for (int i = 0; i < count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                Accept();
+                continue;
+            }
+            if (fd == wake_fd_) {
+                uint64_t value = 0;
+                [[maybe_unused]] const ssize_t size = read(wake_fd_, &value, sizeof value);
+                continue;
+            }
+            const auto it = connections_.find(fd);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            bool is_open = true;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                is_open = Read(connection);
+            }
+            if (is_open && (events[i].events & EPOLLOUT)) {
+                is_open = Write(connection);
+            }
+            if (is_open) {
+                ready.push_back(&connection);
+            }
+            else {
+                Close(fd);
+            }
+        }
+
+        // Requests of all ready connections go into the same batches
+        requests.clear();
+        for (Connection* connection : ready) {
+            ParseRequests(*connection, requests);
+        }
+        ServeRequests(requests);
+
+        for (Connection* connection : ready) {
+            connection->input.erase(0, connection->parsed);
+            connection->scanned -= connection->parsed;
+            connection->parsed = 0;
+            if (!Write(*connection) || (connection->is_closing && connection->output.empty())) {
+                Close(connection->fd);
+            }
+            else {
+                UpdateEvents(*connection);
+            }
+        }
+    }
+}
+
+void QueryServer::Stop() {
+    // Only async-signal-safe calls here
+    is_stopped_.store(true);
+    const uint64_t value = 1;
+    [[maybe_unused]] const ssize_t size = write(wake_fd_, &value, sizeof value);
+}
+
+void QueryServer::Listen() {
+    const std::string& address = options_.address;
+    if (address.compare(0, 5, "unix:"s) == 0) {
+        const std::string path = address.substr(5);
+        sockaddr_un socket_address{};
+        if (path.empty() || path.size() >= sizeof socket_address.sun_path) {
+            throw std::invalid_argument("Invalid Unix socket path "s + path);
+        }
+        socket_address.sun_family = AF_UNIX;
+        std::memcpy(socket_address.sun_path, path.c_str(), path.size() + 1);
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("Cannot create socket"s);
+        }
+        // A socket file left by a server that did not exit cleanly
+        struct stat status {};
+        if (stat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+            unlink(path.c_str());
+        }
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&socket_address), sizeof socket_address) != 0) {
+            ThrowSystemError("Cannot bind "s + address);
+        }
+        unix_path_ = path;
+    }
+    else {
+        const size_t colon = address.rfind(':');
+        if (colon == std::string::npos) {
+            throw std::invalid_argument("Invalid address "s + address);
+        }
+        int port = -1;
+        const char* const port_end = address.data() + address.size();
+        const auto [port_ptr, port_error] = std::from_chars(address.data() + colon + 1, port_end, port);
+        sockaddr_in socket_address{};
+        socket_address.sin_family = AF_INET;
+        if (port_error != std::errc{} || port_ptr != port_end || port < 0 || port > 65535
+            || inet_pton(AF_INET, address.substr(0, colon).c_str(), &socket_address.sin_addr) != 1) {
+            throw std::invalid_argument("Invalid address "s + address);
+        }
+        socket_address.sin_port = htons(static_cast<uint16_t>(port));
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("Cannot create socket"s);
+        }
+        const int enable = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof enable);
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&socket_address), sizeof socket_address) != 0) {
+            ThrowSystemError("Cannot bind "s + address);
+        }
+        socklen_t size = sizeof socket_address;
+        if (getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&socket_address), &size) != 0) {
+            ThrowSystemError("Cannot get socket address"s);
+        }
+        port_ = ntohs(socket_address.sin_port);
+    }
+    if (listen(listen_fd_, SOMAXCONN) != 0) {
+        ThrowSystemError("Cannot listen on "s + address);
+    }
+}
+
+void QueryServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // EAGAIN once the backlog is empty; on running out of descriptors
+            // the rest wait in the backlog
+            return;
+        }
+        if (unix_path_.empty()) {
+            // Responses are small and must not wait for the next ones
+            const int enable = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof enable);
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        auto connection = std::make_unique<Connection>();
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        connections_[fd] = std::move(connection);
+        accepted_connections_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool QueryServer::Read(Connection& connection) {
+    if (connection.is_closing) {
+        return true;
+    }
+    // Level-triggered: what is left in the socket is read in the next pass,
+    // so a busy connection cannot hold up the others
+    const size_t size = connection.input.size();
+    connection.input.resize(size + READ_SIZE);
+    ssize_t received = 0;
+    do {
+        received = recv(connection.fd, connection.input.data() + size, READ_SIZE, 0);
+    } while (received < 0 && errno == EINTR);
+    connection.input.resize(size + std::max<ssize_t>(received, 0));
+    if (received == 0) {
+        // The client sent all its requests; answer them before closing
+        connection.is_closing = true;
+        return true;
+    }
+    return received > 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+bool QueryServer::Write(Connection& connection) {
+    while (!connection.output.empty()) {
+        iovec buffers[MAX_WRITE_BUFFERS];
+        size_t buffer_count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && buffer_count < MAX_WRITE_BUFFERS; ++it) {
+            const size_t offset = buffer_count == 0 ? connection.output_offset : 0;
+            buffers[buffer_count].iov_base = it->data() + offset;
+            buffers[buffer_count].iov_len = it->size() - offset;
+            ++buffer_count;
+        }
+        // writev with MSG_NOSIGNAL: a closed peer must not raise SIGPIPE
+        msghdr message{};
+        message.msg_iov = buffers;
+        message.msg_iovlen = buffer_count;
+        const ssize_t sent = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.output_size -= sent;
+        size_t remaining = static_cast<size_t>(sent);
+        while (remaining > 0) {
+            const size_t left = connection.output.front().size() - connection.output_offset;
+            if (remaining < left) {
+                connection.output_offset += remaining;
+                break;
+            }
+            remaining -= left;
+            connection.output.pop_front();
+            connection.output_offset = 0;
+        }
+    }
+    return true;
+}
+
+void QueryServer::ParseRequests(Connection& connection, std::vector<Request>& requests) const {
+    const std::string& input = connection.input;
+    size_t begin = connection.parsed;
+    for (size_t end = input.find('\n', connection.scanned); end != std::string::npos; end = input.find('\n', begin)) {
+        std::string_view query(input.data() + begin, end - begin);
+        if (query.size() > options_.max_request_size) {
+            break;
+        }
+        if (!query.empty() && query.back() == '\r') {
+            query.remove_suffix(1);
+        }
+        requests.push_back({ &connection, query, false });
+        begin = end + 1;
+    }
+    connection.parsed = begin;
+    connection.scanned = input.size();
+    if (input.size() - begin > options_.max_request_size) {
+        requests.push_back({ &connection, {}, true });
+        connection.is_closing = true;
+        connection.parsed = input.size();
+    }
+}
+
+void QueryServer::ServeRequests(const std::vector<Request>& requests) {
+    std::vector<std::string> responses(requests.size());
+    std::vector<size_t> request_indexes;
+    std::vector<std::string_view> queries;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        if (requests[i].is_too_long) {
+            responses[i] = FormatError("Request is too long"s);
+        }
+        else {
+            request_indexes.push_back(i);
+            queries.push_back(requests[i].query);
+        }
+    }
+    for (size_t first = 0; first < queries.size(); first += options_.max_batch_size) {
+        const size_t last = std::min(first + options_.max_batch_size, queries.size());
+        std::vector<std::string> batch_responses = AnswerQueries({ queries.begin() + first, queries.begin() + last });
+        for (size_t i = first; i < last; ++i) {
+            responses[request_indexes[i]] = std::move(batch_responses[i - first]);
+        }
+        batches_.fetch_add(1, std::memory_order_relaxed);
+    }
+    requests_.fetch_add(requests.size(), std::memory_order_relaxed);
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        Connection& connection = *requests[i].connection;
+        connection.output_size += responses[i].size();
+        connection.output.push_back(std::move(responses[i]));
+    }
+}
+
+std::vector<std::string> QueryServer::AnswerQueries(const std::vector<std::string_view>& queries) const {
+    std::vector<std::string> responses;
+    responses.reserve(queries.size());
+    try {
+        const auto results = options_.is_parallel ? search_server_.FindTopDocumentsBatch(std::execution::par, queries)
+            : search_server_.FindTopDocumentsBatch(std::execution::seq, queries);
+        for (const auto& documents : results) {
+            responses.push_back(FormatResponse(documents));
+        }
+    }
+    catch (const std::exception&) {
+        // Any failure, not only a malformed query, fails just its own
+        // request and must not take the event loop down
+        responses.clear();
+        for (const std::string_view query : queries) {
+            try {
+                responses.push_back(FormatResponse(search_server_.FindTopDocuments(query)));
+            }
+            catch (const std::exception& error) {
+                responses.push_back(FormatError(error.what()));
+            }
+        }
+    }
+    return responses;
+}
+
+void QueryServer::UpdateEvents(Connection& connection) {
+    uint32_t events = 0;
+    if (!connection.is_closing && connection.output_size < MAX_QUEUED_OUTPUT) {
+        events |= EPOLLIN;
+    }
+    if (!connection.output.empty()) {
+        events |= EPOLLOUT;
+    }
+    if (events == connection.events) {
+        return;
+    }
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = connection.fd;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+    connection.events = events;
+}
+
+void QueryServer::Close(int fd) {
+    // Closing the descriptor also removes it from the epoll set
+    close(fd);
+    connections_.erase(fd);
+}
+
+void QueryServer::CloseAll() {
+    for (const auto& [fd, _] : connections_) {
+        close(fd);
+    }
+    connections_.clear();
+    for (int* const fd : { &listen_fd_, &wake_fd_, &epoll_fd_ }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+
+// Serves FindTopDocuments over TCP or a Unix socket with a line protocol:
+//
+//     request:  the raw query, terminated by '\n' ("\r\n" is accepted)
+//     response: "OK" and " id:relevance:rating" for every document found,
+//               or "ERROR " and the message, terminated by '\n'
+//
+// Relevance is printed in the shortest form that reads back to the same
+// double. Clients may pipeline requests, sending the next ones before the
+// responses come; each connection gets its responses in request order.
+//
+// One thread runs an epoll loop over all connections. The complete
+// requests read in one pass over the ready connections are run together
+// through FindTopDocumentsBatch (micro-batching), as views into the read
+// buffers. Each response is queued as its own buffer, and the queued
+// buffers of a connection go out in one gathering write without being
+// joined.
+struct QueryServerOptions {
+    // "host:port" for TCP over IPv4, where port 0 picks a free port, or
+    // "unix:path" for a Unix socket
+    std::string address = "127.0.0.1:0";
+    // Requests of one pass over this number are split into several batches
+    size_t max_batch_size = 1024;
+    // A longer request is answered with an error and closes the connection
+    size_t max_request_size = size_t{ 64 } << 10;
+    // Batches run with std::execution::par
+    bool is_parallel = true;
+};
+
+struct QueryServerStats {
+    size_t accepted_connections = 0;
+    size_t requests = 0;
+    size_t batches = 0;
+};
+
+class QueryServer {
+public:
+    // Binds and listens on the address. Throws std::invalid_argument for a
+    // malformed address and std::system_error if the socket cannot be set up.
+    explicit QueryServer(const SearchServer& search_server, const QueryServerOptions& options = QueryServerOptions{});
+    // Closes all connections and removes the Unix socket file
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Port of a TCP server, 0 for a Unix socket
+    int GetPort() const;
+    QueryServerStats GetStats() const;
+
+    // Serves connections in the calling thread until Stop is called
+    void Run();
+    // Makes Run return after the current pass. Safe to call from any thread
+    // and from a signal handler.
+    void Stop();
+
+private:
+    struct Connection {
+        int fd = -1;
+        // Received bytes from the first request not answered yet
+        std::string input;
+        // Bytes of input holding complete requests, and bytes already
+        // searched for the end of a request
+        size_t parsed = 0;
+        size_t scanned = 0;
+        std::deque<std::string> output;
+        // Bytes of output.front() already sent
+        size_t output_offset = 0;
+        size_t output_size = 0;
+        // Closed after the queued responses are sent
+        bool is_closing = false;
+        uint32_t events = 0;
+    };
+
+    // A complete request of a connection, pointing into its input
+    struct Request {
+        Connection* connection;
+        std::string_view query;
+        bool is_too_long;
+    };
+
+    const SearchServer& search_server_;
+    const QueryServerOptions options_;
+    std::string unix_path_;
+    int port_ = 0;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    // Written by Stop to wake epoll_wait
+    int wake_fd_ = -1;
+    std::atomic<bool> is_stopped_{ false };
+    std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+
+    std::atomic<size_t> accepted_connections_{ 0 };
+    std::atomic<size_t> requests_{ 0 };
+    std::atomic<size_t> batches_{ 0 };
+
+    void Listen();
+    void Accept();
+    // False if the connection is to be closed at once
+    bool Read(Connection& connection);
+    bool Write(Connection& connection);
+    // Appends the complete requests of the connection to requests
+    void ParseRequests(Connection& connection, std::vector<Request>& requests) const;
+    // Searches and queues the responses in request order
+    void ServeRequests(const std::vector<Request>& requests);
+    // One response per query; if the batch fails, e.g. on a malformed
+    // query, the queries are run one by one, so that only the failing ones
+    // get an error
+    std::vector<std::string> AnswerQueries(const std::vector<std::string_view>& queries) const;
+    // Listens for output while responses are queued, and stops reading
+    // while too many of them are or the connection is closing
+    void UpdateEvents(Connection& connection);
+    void Close(int fd);
+    void CloseAll();
+};
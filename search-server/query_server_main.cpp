@@ -0,0 +1,133 @@
+// Serves a synthetic Zipfian corpus with QueryServer (see query_server.h),
+// for load tests with load_generator. Both draw the dictionary from
+// --dictionary and --seed the same way, so the generated queries find
+// documents. Stops on SIGINT or SIGTERM.
+//
+// Usage: query_server [--address host:port|unix:path] [--documents N]
+//                     [--dictionary N] [--document-words N] [--zipf S]
+//                     [--seed N] [--max-batch N] [--parallel 0|1]
+
+#include <csignal>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "corpus_generator.h"
+#include "query_server.h"
+#include "search_server.h"
+
+using namespace std;
+
+namespace {
+
+struct ServerOptions {
+    QueryServerOptions query_server;
+    int documents = 10'000;
+    int dictionary = 50'000;
+    int document_words = 100;
+    double zipf = 1.0;
+    unsigned seed = 42;
+};
+
+QueryServer* running_server = nullptr;
+
+void HandleStopSignal(int) {
+    running_server->Stop();
+}
+
+void PrintUsage() {
+    cerr << "Usage: query_server [--address host:port|unix:path] [--documents N] [--dictionary N]"s
+        << " [--document-words N] [--zipf S] [--seed N] [--max-batch N] [--parallel 0|1]"s << endl;
+}
+
+bool ParseOptions(int argc, char* argv[], ServerOptions& options) {
+    options.query_server.address = "127.0.0.1:8080"s;
+    for (int i = 1; i < argc; ++i) {
+        const string name = argv[i];
+        if (name == "--help"s || i + 1 == argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        try {
+            if (name == "--address"s) {
+                options.query_server.address = value;
+            }
+            else if (name == "--documents"s) {
+                options.documents = stoi(value);
+            }
+            else if (name == "--dictionary"s) {
+                options.dictionary = stoi(value);
+            }
+            else if (name == "--document-words"s) {
+                options.document_words = stoi(value);
+            }
+            else if (name == "--zipf"s) {
+                options.zipf = stod(value);
+            }
+            else if (name == "--seed"s) {
+                options.seed = static_cast<unsigned>(stoul(value));
+            }
+            else if (name == "--max-batch"s) {
+                options.query_server.max_batch_size = stoul(value);
+            }
+            else if (name == "--parallel"s) {
+                options.query_server.is_parallel = stoi(value) != 0;
+            }
+            else {
+                return false;
+            }
+        }
+        catch (const logic_error&) {
+            return false;
+        }
+    }
+    return options.documents > 0 && options.dictionary > 0 && options.document_words > 0
+        && options.query_server.max_batch_size > 0;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    ServerOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage();
+        return 1;
+    }
+
+    mt19937 generator(options.seed);
+    const vector<string> dictionary = GenerateDictionary(generator, options.dictionary, 10);
+    const ZipfDistribution distribution(dictionary.size(), options.zipf);
+    vector<DocumentInput> documents;
+    documents.reserve(options.documents);
+    for (int document_id = 0; document_id < options.documents; ++document_id) {
+        documents.push_back({ document_id, GenerateQuery(generator, dictionary, distribution, options.document_words),
+            DocumentStatus::ACTUAL, { 1, 2, 3 } });
+    }
+    SearchServer search_server("and in on the"s);
+    search_server.AddDocuments(documents);
+    documents.clear();
+
+    try {
+        QueryServer query_server(search_server, options.query_server);
+        running_server = &query_server;
+        signal(SIGINT, HandleStopSignal);
+        signal(SIGTERM, HandleStopSignal);
+        cerr << "Serving "s << options.documents << " documents at "s << options.query_server.address;
+        if (query_server.GetPort() != 0) {
+            cerr << " (port "s << query_server.GetPort() << ")"s;
+        }
+        cerr << endl;
+        query_server.Run();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+
+        const QueryServerStats stats = query_server.GetStats();
+        cerr << "Served "s << stats.requests << " requests in "s << stats.batches << " batches over "s
+            << stats.accepted_connections << " connections"s << endl;
+    }
+    catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+}
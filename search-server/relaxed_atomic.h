@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+
+// A field that may be overwritten while other threads read it, as long as
+// no reader needs to see the write at once. Copies are plain loads, so a
+// record holding it stays copyable and movable; copying or moving records
+// still needs the same exclusive access as any other change to their
+// container.
+template <typename T>
+class RelaxedAtomic {
+public:
+    RelaxedAtomic(T value = T{})
+        : value_(value) {
+    }
+
+    RelaxedAtomic(const RelaxedAtomic& other)
+        : value_(other.Load()) {
+    }
+
+    RelaxedAtomic& operator=(const RelaxedAtomic& other) {
+        Store(other.Load());
+        return *this;
+    }
+
+    RelaxedAtomic& operator=(T value) {
+        Store(value);
+        return *this;
+    }
+
+    operator T() const {
+        return Load();
+    }
+
+    T Load() const {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+    void Store(T value) {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<T> value_;
+};
@@ -2,9 +2,29 @@
 
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server) {
+inline void RemoveDuplicates(SearchServer& search_server) {
     for (const int document_id : search_server.GetDuplicates()) {
         search_server.RemoveDocument(document_id);
         std::cout << "Found duplicate document id "s << document_id << std::endl;
     }
-}
\ No newline at end of file
+}
+
+// Keeps the document with the smallest id of every group of near duplicates
+// and removes only the documents similar enough to one that is kept: in a
+// chain where A is like B and B like C, but A unlike C, C stays
+inline void RemoveDuplicates(SearchServer& search_server, double min_similarity) {
+    for (const std::vector<int>& group : search_server.GetNearDuplicates(std::execution::par, min_similarity)) {
+        std::vector<int> kept = { group[0] };
+        for (auto it = group.begin() + 1; it != group.end(); ++it) {
+            const int document_id = *it;
+            if (std::none_of(kept.begin(), kept.end(), [&](int kept_id) {
+                return search_server.GetWordSimilarity(kept_id, document_id) >= min_similarity;
+                })) {
+                kept.push_back(document_id);
+                continue;
+            }
+            search_server.RemoveDocument(document_id);
+            std::cout << "Found duplicate document id "s << document_id << std::endl;
+        }
+    }
+}
@@ -1,25 +1,31 @@
 #include "request_queue.h"
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
-    auto result = ss.FindTopDocuments(raw_query, status);
-
-    CountRequests(!result.empty());
-
-    return result;
+    return AddFindRequest(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        });
 }
 
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query) {
-    auto result = ss.FindTopDocuments(raw_query);
-
-    CountRequests(!result.empty());
-
-    return result;
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
 }
 
 int RequestQueue::GetNoResultRequests() const {
     return empty_requests_;
 }
 
+WindowStatistics RequestQueue::GetStatistics(std::chrono::seconds window) const {
+    return statistics_.GetWindowStatistics(window);
+}
+
+void RequestQueue::EnableSlowQueryLog(std::chrono::nanoseconds threshold, size_t capacity) {
+    slow_query_log_ = std::make_unique<SlowQueryLog>(threshold, capacity);
+}
+
+const SlowQueryLog* RequestQueue::GetSlowQueryLog() const {
+    return slow_query_log_.get();
+}
+
 void RequestQueue::CountRequests(bool empty_find)
 {
     QueryResult result_empty;
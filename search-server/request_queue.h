@@ -10,9 +10,12 @@
 #include <utility>
 #include <vector>
 #include <deque>
+#include <memory>
 
 #include "search_server.h"
 #include "document.h"
+#include "request_statistics.h"
+#include "slow_query_log.h"
 
 class RequestQueue {
 public:
@@ -27,6 +30,13 @@ public:
     std::vector<Document> AddFindRequest(const std::string& raw_query);
 
     int GetNoResultRequests() const;
+    WindowStatistics GetStatistics(std::chrono::seconds window) const;
+
+    // From now on requests record their cost, and those that take at least
+    // threshold are kept in the log
+    void EnableSlowQueryLog(std::chrono::nanoseconds threshold, size_t capacity = 100);
+    // nullptr until the log is enabled
+    const SlowQueryLog* GetSlowQueryLog() const;
 private:
     struct QueryResult {
         // ,     
@@ -37,13 +47,23 @@ private:
     int all_requests_ = 0;
     int empty_requests_ = 0;
     const SearchServer& ss;
+    RequestStatistics statistics_;
+    std::unique_ptr<SlowQueryLog> slow_query_log_;
     // ,    - 
     void CountRequests(bool empty_find);
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
-    auto result = ss.FindTopDocuments(raw_query, document_predicate);
+    auto result = statistics_.Track([&] {
+        if (!slow_query_log_) {
+            return ss.FindTopDocuments(raw_query, document_predicate);
+        }
+        QueryCost cost;
+        auto documents = ss.FindTopDocuments(raw_query, document_predicate, TfIdfScorer{}, cost);
+        slow_query_log_->Record(raw_query, cost);
+        return documents;
+        });
 
     CountRequests(!result.empty());
 
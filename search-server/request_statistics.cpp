@@ -0,0 +1,104 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+std::atomic<size_t> next_thread_index{ 0 };
+thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+}
+
+RequestStatistics::RequestStatistics(size_t shard_count)
+    : shard_count_(shard_count > 0 ? shard_count : std::max<size_t>(std::thread::hardware_concurrency(), MIN_SHARD_COUNT))
+    , shards_(new Shard[shard_count_]) {
+}
+
+void RequestStatistics::Record(std::chrono::nanoseconds latency, bool is_empty) {
+    Record(latency, is_empty, Clock::now());
+}
+
+void RequestStatistics::Record(std::chrono::nanoseconds latency, bool is_empty, Clock::time_point now) {
+    const int64_t second = GetSecond(now);
+    Slot& slot = GetThreadShard().slots[second % HISTORY_SECONDS];
+    // The request counter decides whether the record is too late. The other
+    // counters can only have moved on meanwhile if another thread sharing
+    // the shard recorded HISTORY_SECONDS later, and then the old second is
+    // gone anyway.
+    if (!Increment(slot.requests, second)) {
+        dropped_records_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (is_empty) {
+        Increment(slot.empty_requests, second);
+    }
+    const uint64_t latency_ns = static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0));
+    Increment(slot.latency[latency_buckets::GetIndex(latency_ns)], second);
+}
+
+WindowStatistics RequestStatistics::GetWindowStatistics(std::chrono::seconds window) const {
+    return GetWindowStatistics(window, Clock::now());
+}
+
+WindowStatistics RequestStatistics::GetWindowStatistics(std::chrono::seconds window, Clock::time_point now) const {
+    WindowStatistics result;
+    result.window = std::clamp(window, std::chrono::seconds(1), std::chrono::seconds(HISTORY_SECONDS));
+
+    const int64_t last_second = GetSecond(now);
+    const int64_t first_second = last_second - result.window.count() + 1;
+    LatencyHistogram latency;
+    for (size_t i = 0; i < shard_count_; ++i) {
+        for (int64_t second = std::max<int64_t>(first_second, 0); second <= last_second; ++second) {
+            const Slot& slot = shards_[i].slots[second % HISTORY_SECONDS];
+            result.requests += Load(slot.requests, second);
+            result.empty_requests += Load(slot.empty_requests, second);
+            for (int bucket = 0; bucket < latency_buckets::COUNT; ++bucket) {
+                latency.AddBucket(bucket, Load(slot.latency[bucket], second));
+            }
+        }
+    }
+
+    result.queries_per_second = result.requests * 1.0 / result.window.count();
+    result.empty_rate = result.requests == 0 ? 0.0 : result.empty_requests * 1.0 / result.requests;
+    result.p50_ns = latency.GetQuantile(0.5);
+    result.p99_ns = latency.GetQuantile(0.99);
+    result.p999_ns = latency.GetQuantile(0.999);
+    return result;
+}
+
+uint64_t RequestStatistics::GetDroppedRecords() const {
+    return dropped_records_.load(std::memory_order_relaxed);
+}
+
+int64_t RequestStatistics::GetSecond(Clock::time_point time) const {
+    return std::chrono::duration_cast<std::chrono::seconds>(time - start_).count();
+}
+
+RequestStatistics::Shard& RequestStatistics::GetThreadShard() {
+    return shards_[thread_index % shard_count_];
+}
+
+bool RequestStatistics::Increment(Counter& counter, int64_t second) {
+    const uint64_t tag = static_cast<uint64_t>(second) << 32;
+    uint64_t current = counter.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t next;
+        if ((current & ~uint64_t{ 0xFFFFFFFF }) == tag) {
+            next = current + 1;
+        }
+        else if (current < tag) {
+            // An older second: this record is the first of the new one
+            next = tag + 1;
+        }
+        else {
+            return false;
+        }
+        if (counter.compare_exchange_weak(current, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+uint64_t RequestStatistics::Load(const Counter& counter, int64_t second) {
+    const uint64_t value = counter.load(std::memory_order_relaxed);
+    return (value >> 32) == static_cast<uint64_t>(second) ? value & 0xFFFFFFFF : 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#include "histogram.h"
+
+struct WindowStatistics {
+    std::chrono::seconds window{ 0 };
+    uint64_t requests = 0;
+    uint64_t empty_requests = 0;
+    double queries_per_second = 0.0;
+    double empty_rate = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+};
+
+// Thread-safe rolling request statistics. Every recording thread writes to
+// its own cache-line aligned shard: a fixed ring of per-second slots with
+// atomic counters and a latency histogram. Readers sum the slots of the
+// requested window over all shards.
+//
+// Recording is lock-free: every counter carries the second it counts, so a
+// writer that finds an older second in it starts the counter over in the
+// same compare-exchange, and never waits for another thread to clear a
+// slot. Readers skip counters of other seconds.
+//
+// Threads take shards round-robin in the order they first record. Writes
+// are contention-free only while no more threads record than there are
+// shards; further threads share shards with earlier ones.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int HISTORY_SECONDS = 60;
+    static constexpr size_t MIN_SHARD_COUNT = 16;
+
+    // 0 takes one shard per hardware thread, and at least MIN_SHARD_COUNT
+    explicit RequestStatistics(size_t shard_count = 0);
+
+    void Record(std::chrono::nanoseconds latency, bool is_empty);
+    void Record(std::chrono::nanoseconds latency, bool is_empty, Clock::time_point now);
+
+    // window is clamped to HISTORY_SECONDS, the current second included
+    WindowStatistics GetWindowStatistics(std::chrono::seconds window) const;
+    WindowStatistics GetWindowStatistics(std::chrono::seconds window, Clock::time_point now) const;
+
+    // Records of seconds whose slots had already been reused for a later
+    // second, e.g. from a thread that was descheduled for a whole minute
+    uint64_t GetDroppedRecords() const;
+
+    // Runs search(), records its latency and whether the result is empty
+    template <typename SearchFunction>
+    auto Track(SearchFunction search) -> decltype(search());
+
+private:
+    // The second in the high half and the count of that second in the low one
+    using Counter = std::atomic<uint64_t>;
+
+    struct Slot {
+        Counter requests{ 0 };
+        Counter empty_requests{ 0 };
+        std::array<Counter, latency_buckets::COUNT> latency{};
+    };
+
+    struct alignas(64) Shard {
+        std::array<Slot, HISTORY_SECONDS> slots;
+    };
+
+    const Clock::time_point start_ = Clock::now();
+    const size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+    std::atomic<uint64_t> dropped_records_{ 0 };
+
+    int64_t GetSecond(Clock::time_point time) const;
+    Shard& GetThreadShard();
+    // False if the counter already counts a later second
+    static bool Increment(Counter& counter, int64_t second);
+    // 0 if the counter counts another second
+    static uint64_t Load(const Counter& counter, int64_t second);
+};
+
+template <typename SearchFunction>
+auto RequestStatistics::Track(SearchFunction search) -> decltype(search()) {
+    const auto start = Clock::now();
+    auto result = search();
+    const auto end = Clock::now();
+    Record(end - start, result.empty(), end);
+    return result;
+}
@@ -0,0 +1,31 @@
+#include "result_cursor.h"
+
+#include <algorithm>
+
+namespace {
+// std heap functions keep the greatest element on top, so the comparator is reversed
+bool IsRankedLower(const Document& lhs, const Document& rhs) {
+    return IsRankedHigher(rhs, lhs);
+}
+}
+
+ResultCursor::ResultCursor(std::vector<Document> candidates, size_t max_depth)
+    : heap_(std::move(candidates)) {
+    if (max_depth > 0 && heap_.size() > max_depth) {
+        std::nth_element(heap_.begin(), heap_.begin() + max_depth, heap_.end(), IsRankedHigher);
+        heap_.resize(max_depth);
+    }
+    std::make_heap(heap_.begin(), heap_.end(), IsRankedLower);
+}
+
+std::vector<Document> ResultCursor::NextPage(size_t page_size) {
+    std::vector<Document> page;
+    page.reserve(std::min(page_size, heap_.size()));
+    while (page.size() < page_size && !heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsRankedLower);
+        page.push_back(heap_.back());
+        heap_.pop_back();
+    }
+    returned_count_ += page.size();
+    return page;
+}
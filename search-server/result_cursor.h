@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "document.h"
+
+// Ranking order of search results: higher relevance first, relevances
+// closer than DELTA are ordered by rating, then by id, so that sorting,
+// partial sorting and heaps agree on ties
+inline bool IsRankedHigher(const Document& lhs, const Document& rhs) {
+    if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
+        if (lhs.rating != rhs.rating) {
+            return lhs.rating > rhs.rating;
+        }
+        return lhs.id < rhs.id;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
+// Scored results of one query, handed out page by page in ranking order.
+// The candidates are kept in a heap, so opening the cursor costs O(n) on top
+// of scoring and each further page O(page size * log n); nothing is rescored.
+class ResultCursor {
+public:
+    ResultCursor() = default;
+    // Keeps at most max_depth best candidates, 0 keeps all of them
+    explicit ResultCursor(std::vector<Document> candidates, size_t max_depth = 0);
+
+    // Up to page_size next documents, empty once the results are exhausted
+    std::vector<Document> NextPage(size_t page_size);
+
+    bool HasMore() const {
+        return !heap_.empty();
+    }
+    size_t GetReturnedCount() const {
+        return returned_count_;
+    }
+    size_t GetRemainingCount() const {
+        return heap_.size();
+    }
+
+private:
+    std::vector<Document> heap_;
+    size_t returned_count_ = 0;
+};
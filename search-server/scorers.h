@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cmath>
+
+// Ranking policies for SearchServer::FindTopDocuments. A scorer is a plain
+// struct passed as a template argument, so its methods are inlined into the
+// scoring loop.
+//
+// ComputeTermWeight is called once per query word,
+// ComputeScore once per (word, document) posting.
+
+struct TermStatistics {
+    int document_count = 0;
+    int document_freq = 0;
+    double average_document_length = 0.0;
+};
+
+// term_freq is the share of the document's words equal to the query word
+struct TfIdfScorer {
+    double ComputeTermWeight(const TermStatistics& stats) const {
+        return std::log(stats.document_count * 1.0 / stats.document_freq);
+    }
+
+    double ComputeScore(double term_freq, int /*document_length*/, double term_weight, const TermStatistics& /*stats*/) const {
+        return term_freq * term_weight;
+    }
+};
+
+struct Bm25Scorer {
+    double k1 = 1.2;
+    double b = 0.75;
+
+    double ComputeTermWeight(const TermStatistics& stats) const {
+        return std::log(1.0 + (stats.document_count - stats.document_freq + 0.5) / (stats.document_freq + 0.5));
+    }
+
+    double ComputeScore(double term_freq, int document_length, double term_weight, const TermStatistics& stats) const {
+        const double count = term_freq * document_length;
+        const double length_norm = stats.average_document_length > 0
+            ? 1.0 - b + b * document_length / stats.average_document_length
+            : 1.0;
+        return term_weight * count * (k1 + 1.0) / (count + k1 * length_norm);
+    }
+};
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+#include "trace.h"
+
+// Hooks observe the scoring loop of a search. FindAllDocuments calls
+// ShouldStop() before every query word and every POSTING_BLOCK_SIZE postings;
+// once it returns true the search finishes with the documents scored so far.
+// The On* callbacks and MeasurePhase report the work done along the way.
+// The calls are resolved at compile time, so NoSearchHooks costs nothing.
+// Other hooks derive from it and hide only the calls they are interested in.
+
+const size_t POSTING_BLOCK_SIZE = 1024;
+
+struct NoSearchHooks {
+    struct NoPhaseTimer {
+    };
+
+    bool ShouldStop() {
+        return false;
+    }
+
+    // Plus and minus words and patterns of the parsed query
+    void OnQueryParsed(size_t) {
+    }
+
+    void OnPostingScanned() {
+    }
+
+    // A posting of a document the predicate does not accept
+    void OnPredicateRejected(int, DocumentStatus) {
+    }
+
+    // Documents with a score before minus words and phrases are applied
+    void OnDocumentsScored(size_t) {
+    }
+
+    // Documents dropped by minus words, minus patterns and phrases
+    void OnDocumentsExcluded(size_t) {
+    }
+
+    // A document FindAllDocuments returns, with its status and rating
+    void OnDocumentMatched(DocumentStatus, int) {
+    }
+
+    // Where the hooks keep the documents the predicate rejected, for minus
+    // words and phrases to exclude them as well; null if they do not
+    std::map<int, DocumentStatus>* GetRejectedDocuments() {
+        return nullptr;
+    }
+
+    void OnRankingComparison() {
+    }
+
+    // Times the enclosing scope; the result lives until the end of it
+    NoPhaseTimer MeasurePhase(TracePhase) {
+        return {};
+    }
+};
+
+// Work done by one search
+struct QueryCost {
+    uint64_t terms_parsed = 0;
+    uint64_t postings_scanned = 0;
+    uint64_t documents_scored = 0;
+    uint64_t predicate_rejections = 0;
+    uint64_t documents_excluded = 0;
+    // Comparisons made while ranking the results
+    uint64_t top_k_comparisons = 0;
+    std::array<uint64_t, TRACE_PHASE_COUNT> phase_ns{};
+    uint64_t total_ns = 0;
+};
+
+// Fills a QueryCost; the phase times come from steady_clock whether or not
+// tracing is enabled
+class QueryCostHooks : public NoSearchHooks {
+public:
+    class PhaseTimer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit PhaseTimer(uint64_t& phase_ns)
+            : phase_ns_(phase_ns)
+            , start_(Clock::now()) {
+        }
+
+        PhaseTimer(const PhaseTimer&) = delete;
+        PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+        ~PhaseTimer() {
+            phase_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count();
+        }
+
+    private:
+        uint64_t& phase_ns_;
+        Clock::time_point start_;
+    };
+
+    explicit QueryCostHooks(QueryCost& cost)
+        : cost_(cost) {
+    }
+
+    void OnQueryParsed(size_t term_count) {
+        cost_.terms_parsed += term_count;
+    }
+
+    void OnPostingScanned() {
+        ++cost_.postings_scanned;
+    }
+
+    void OnPredicateRejected(int, DocumentStatus) {
+        ++cost_.predicate_rejections;
+    }
+
+    void OnDocumentsScored(size_t count) {
+        cost_.documents_scored += count;
+    }
+
+    void OnDocumentsExcluded(size_t count) {
+        cost_.documents_excluded += count;
+    }
+
+    void OnRankingComparison() {
+        ++cost_.top_k_comparisons;
+    }
+
+    PhaseTimer MeasurePhase(TracePhase phase) {
+        return PhaseTimer(cost_.phase_ns[static_cast<int>(phase)]);
+    }
+
+private:
+    QueryCost& cost_;
+};
+
+// Copies share the flag: the caller keeps one copy and cancels through it
+class CancellationToken {
+public:
+    CancellationToken()
+        : is_cancelled_(std::make_shared<std::atomic<bool>>(false)) {
+    }
+
+    void Cancel() {
+        is_cancelled_->store(true, std::memory_order_relaxed);
+    }
+
+    bool IsCancelled() const {
+        return is_cancelled_->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> is_cancelled_;
+};
+
+struct SearchLimits {
+    using Clock = std::chrono::steady_clock;
+
+    std::optional<Clock::time_point> deadline;
+    CancellationToken cancellation;
+    // Postings to score before stopping, checked along with the deadline
+    size_t max_postings = std::numeric_limits<size_t>::max();
+};
+
+// Best documents found before the limits stopped the search
+struct SearchResult {
+    std::vector<Document> documents;
+    bool is_partial = false;
+};
+
+class LimitedSearchHooks : public NoSearchHooks {
+public:
+    explicit LimitedSearchHooks(const SearchLimits& limits)
+        : limits_(limits) {
+    }
+
+    bool ShouldStop() {
+        if (!is_stopped_) {
+            is_stopped_ = postings_scanned_ >= limits_.max_postings
+                || limits_.cancellation.IsCancelled()
+                || (limits_.deadline && SearchLimits::Clock::now() >= *limits_.deadline);
+        }
+        return is_stopped_;
+    }
+
+    void OnPostingScanned() {
+        ++postings_scanned_;
+    }
+
+    bool IsStopped() const {
+        return is_stopped_;
+    }
+
+private:
+    const SearchLimits& limits_;
+    size_t postings_scanned_ = 0;
+    bool is_stopped_ = false;
+};
@@ -7,8 +7,78 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
         throw std::invalid_argument("Invalid document_id"s);
     }
     
-    const auto words = SplitIntoWordsNoStop(document);
-    
+    std::vector<Postings*> postings;
+    const auto words = AddWordsToDictionary(document, postings);
+    IndexDocument(document_id, words, postings, status, ratings);
+}
+
+void SearchServer::AddDocuments(const std::vector<DocumentInput>& documents) {
+    std::vector<const DocumentInput*> ordered;
+    ordered.reserve(documents.size());
+    for (const DocumentInput& document : documents) {
+        ordered.push_back(&document);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const DocumentInput* lhs, const DocumentInput* rhs) {
+        return lhs->id < rhs->id;
+        });
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        const int document_id = ordered[i]->id;
+        if (document_id < 0 || documents_.count(document_id) > 0 || (i > 0 && ordered[i - 1]->id == document_id)) {
+            throw std::invalid_argument("Invalid document_id"s);
+        }
+    }
+
+    // An exception escaping a parallel algorithm terminates the program, so
+    // errors are carried out and the first one in id order is rethrown
+    std::vector<std::vector<std::string_view>> analyzed(ordered.size());
+    std::vector<std::deque<std::string>> normalized_words(ordered.size());
+    std::vector<std::exception_ptr> errors(ordered.size());
+    std::vector<size_t> indexes(ordered.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        try {
+            analyzed[i] = AnalyzeDocument(ordered[i]->text, normalized_words[i]);
+        }
+        catch (...) {
+            errors[i] = std::current_exception();
+        }
+        });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<std::string_view> words;
+    std::vector<Postings*> postings;
+    for (size_t i = 0; i < ordered.size(); ++i) {
+        words.clear();
+        postings.clear();
+        for (const std::string_view word : analyzed[i]) {
+            const auto [key, word_postings] = AddWordToDictionary(word);
+            words.push_back(key);
+            postings.push_back(word_postings);
+        }
+        IndexDocument(ordered[i]->id, words, postings, ordered[i]->status, ordered[i]->ratings);
+    }
+}
+
+void SearchServer::SetDocumentStatus(int document_id, DocumentStatus status) {
+    if (documents_.count(document_id) == 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    documents_.at(document_id).status = status;
+}
+
+void SearchServer::SetDocumentRating(int document_id, const std::vector<int>& ratings) {
+    if (documents_.count(document_id) == 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    documents_.at(document_id).rating = ComputeAverageRating(ratings);
+}
+
+void SearchServer::IndexDocument(int document_id, const std::vector<std::string_view>& words, const std::vector<Postings*>& postings,
+    DocumentStatus status, const std::vector<int>& ratings) {
 
     const size_t size = words.size();
 
@@ -16,23 +86,36 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
     if (size != 0)
         inv_word_count = 1.0 / size;
 
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status });
-    document_ids_.insert(document_id);
-    
-    std::set<std::string_view> s;
-    for (const auto w : words)
-        s.emplace(w);
+    auto& word_freqs = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, static_cast<int>(size),
+        WordFrequencies(&memory_counters_->forward_index, is_compact_) }).word_frequencies;
+    total_document_length_ += size;
 
-    if (words_to_id_.count(s) == 0) {
-        words_to_id_[s].insert({ document_id });
+    for (size_t i = 0; i < size; ++i) {
+        (*postings[i])[document_id] += inv_word_count;
+        word_freqs[words[i]] += inv_word_count;
     }
-    else {
-        words_to_id_.at(s).insert(document_id);
-    } 
 
-    for (const std::string_view word : words) {
-        word_to_document_freqs_[std::string{ word }][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+    std::vector<std::string_view> distinct_words = words;
+    std::sort(distinct_words.begin(), distinct_words.end());
+    distinct_words.erase(std::unique(distinct_words.begin(), distinct_words.end()), distinct_words.end());
+    uint64_t words_hash = 0;
+    for (const std::string_view word : distinct_words) {
+        words_hash = AddToWordSetHash(words_hash, word);
+    }
+    words_to_id_.try_emplace(words_hash, CountingAllocator<int>(&memory_counters_->duplicate_index)).first->second.insert(document_id);
+
+    impact_index_.reset();
+
+    if (use_near_duplicates_) {
+        MinHashSignature signature;
+        for (const std::string_view word : distinct_words) {
+            signature.AddWord(word);
+        }
+        near_duplicates_.Add(document_id, signature);
+    }
+
+    if (use_positions_) {
+        positional_index_.AddDocument(document_id, words);
     }
 }
 void SearchServer::RemoveDocument(int document_id) {
@@ -41,7 +124,7 @@ void SearchServer::RemoveDocument(int document_id) {
         throw std::invalid_argument("Invalid document_id"s);
     }
 
-    auto& word_freq = document_to_word_freqs_.at(document_id);
+    const auto& word_freq = documents_.at(document_id).word_frequencies;
     std::vector<std::string_view> temp;
     temp.resize(word_freq.size());
 
@@ -51,21 +134,23 @@ void SearchServer::RemoveDocument(int document_id) {
         });
 
     std::for_each(std::execution::seq, temp.begin(), temp.end(), [&](std::string_view word) {
-        word_to_document_freqs_[std::string{ word }].erase(document_id);
+        word_to_document_freqs_.find(word)->second.erase(document_id);
         });
 
 
-    document_to_word_freqs_.erase(document_id);
+    RemovePositions(document_id);
+    RemoveFromDuplicateIndexes(document_id);
+    impact_index_.reset();
 
+    total_document_length_ -= documents_.at(document_id).length;
     documents_.erase(document_id);
-    document_ids_.erase(document_id);
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy p, int document_id) {
     if ((document_id < 0) || (documents_.count(document_id) == 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    auto& word_freq = document_to_word_freqs_.at(document_id);
+    const auto& word_freq = documents_.at(document_id).word_frequencies;
     std::vector<std::string_view> temp;
     temp.resize(word_freq.size());
 
@@ -75,35 +160,39 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy p, int docume
         });
 
     std::for_each(std::execution::seq, temp.begin(), temp.end(), [&](std::string_view word) {
-        word_to_document_freqs_[std::string{ word }].erase(document_id);
+        word_to_document_freqs_.find(word)->second.erase(document_id);
         });
 
 
-    document_to_word_freqs_.erase(document_id);
+    RemovePositions(document_id);
+    RemoveFromDuplicateIndexes(document_id);
+    impact_index_.reset();
 
+    total_document_length_ -= documents_.at(document_id).length;
     documents_.erase(document_id);
-    document_ids_.erase(document_id);
 }
 void SearchServer::RemoveDocument(std::execution::parallel_policy p, int document_id) {
     if ((document_id < 0) || (documents_.count(document_id) == 0)) {
         throw std::invalid_argument("Invalid document_id"s);
     }
-    auto& word_freq = document_to_word_freqs_.at(document_id);
-    std::vector<const std::string_view*> temp;
+    const auto& word_freq = documents_.at(document_id).word_frequencies;
+    std::vector<std::string_view> temp;
     temp.reserve(word_freq.size());
 
     for (const auto [w, __] : word_freq) {
-        temp.push_back(&w);
+        temp.push_back(w);
     }
 
-    std::for_each(std::execution::par, temp.begin(), temp.end(), [&](const std::string_view* word) {
-        word_to_document_freqs_[std::string{* word }].erase(document_id);
+    std::for_each(std::execution::par, temp.begin(), temp.end(), [&](std::string_view word) {
+        word_to_document_freqs_.find(word)->second.erase(document_id);
         });
 
-    document_to_word_freqs_.erase(document_id);
+    RemovePositions(document_id);
+    RemoveFromDuplicateIndexes(document_id);
+    impact_index_.reset();
 
+    total_document_length_ -= documents_.at(document_id).length;
     documents_.erase(document_id);
-    document_ids_.erase(document_id);
 }
 
 
@@ -112,8 +201,18 @@ std::set<int> SearchServer::GetDuplicates() const {
 
     for (const auto& [w, id] : words_to_id_) {
         if (id.size() > 1) {
-            for (auto i = ++id.begin(); i != id.end(); ++i) {
-                res.insert(*i);
+            // Documents of the group with words unlike those of all before
+            // them, one per distinct word set unless hashes collide
+            std::vector<int> originals;
+            for (const int document_id : id) {
+                if (std::any_of(originals.begin(), originals.end(), [this, document_id](int original_id) {
+                    return HasSameWords(original_id, document_id);
+                    })) {
+                    res.insert(document_id);
+                }
+                else {
+                    originals.push_back(document_id);
+                }
             }
         }
     }
@@ -121,12 +220,239 @@ std::set<int> SearchServer::GetDuplicates() const {
     return res;
 }
 
+double SearchServer::GetWordSimilarity(int lhs_document_id, int rhs_document_id) const {
+    if (documents_.count(lhs_document_id) == 0 || documents_.count(rhs_document_id) == 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    const WordFrequencies& lhs = documents_.at(lhs_document_id).word_frequencies;
+    const WordFrequencies& rhs = documents_.at(rhs_document_id).word_frequencies;
+    // Both iterate in word order, so one merge finds the common words
+    size_t common_count = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        const std::string_view lhs_word = (*lhs_it).first;
+        const std::string_view rhs_word = (*rhs_it).first;
+        if (lhs_word < rhs_word) {
+            ++lhs_it;
+        }
+        else if (rhs_word < lhs_word) {
+            ++rhs_it;
+        }
+        else {
+            ++common_count;
+            ++lhs_it;
+            ++rhs_it;
+        }
+    }
+    const size_t union_count = lhs.size() + rhs.size() - common_count;
+    return union_count == 0 ? 1.0 : common_count * 1.0 / union_count;
+}
+
+void SearchServer::BuildImpactIndex() {
+    BuildImpactIndex(TfIdfScorer{});
+}
+
+bool SearchServer::HasImpactIndex() const {
+    return impact_index_.has_value();
+}
+
+SearchResult SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, const SearchLimits& limits) const {
+    return FindTopDocumentsByImpact(raw_query, [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::ACTUAL;
+        }, limits);
+}
+
+void SearchServer::EnableNearDuplicateIndex() {
+    if (!documents_.empty()) {
+        throw std::logic_error("Near-duplicate index must be enabled before adding documents"s);
+    }
+    use_near_duplicates_ = true;
+}
+
+std::vector<std::vector<int>> SearchServer::GetNearDuplicates(double min_similarity) const {
+    return FindNearDuplicates(std::execution::seq, min_similarity);
+}
+
+std::vector<std::vector<int>> SearchServer::GetNearDuplicates(std::execution::sequenced_policy policy, double min_similarity) const {
+    return FindNearDuplicates(policy, min_similarity);
+}
+
+std::vector<std::vector<int>> SearchServer::GetNearDuplicates(std::execution::parallel_policy policy, double min_similarity) const {
+    return FindNearDuplicates(policy, min_similarity);
+}
+
+// Called before the document's record is erased
+void SearchServer::RemoveFromDuplicateIndexes(int document_id) {
+    // The forward index is ordered by word, so it gives the hash the document was added with
+    uint64_t words_hash = 0;
+    for (const auto [word, _] : documents_.at(document_id).word_frequencies) {
+        words_hash = AddToWordSetHash(words_hash, word);
+    }
+    const auto it = words_to_id_.find(words_hash);
+    if (it != words_to_id_.end()) {
+        it->second.erase(document_id);
+        if (it->second.empty()) {
+            words_to_id_.erase(it);
+        }
+    }
+    near_duplicates_.Remove(document_id);
+}
+
+uint64_t SearchServer::AddToWordSetHash(uint64_t hash, std::string_view word) {
+    // Mixing before adding the next word makes the hash depend on word order
+    hash = (hash ^ std::hash<std::string_view>{}(word)) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
+
+bool SearchServer::HasSameWords(int lhs_document_id, int rhs_document_id) const {
+    const WordFrequencies& lhs = documents_.at(lhs_document_id).word_frequencies;
+    const WordFrequencies& rhs = documents_.at(rhs_document_id).word_frequencies;
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const auto& lhs_entry, const auto& rhs_entry) {
+        return lhs_entry.first == rhs_entry.first;
+        });
+}
+
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
     return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
         return document_status == status;
         });
 }
 
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const {
+    return RunQueryBatch(std::execution::seq, raw_queries);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string>& raw_queries) const {
+    return RunQueryBatch(policy, raw_queries);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string>& raw_queries) const {
+    return RunQueryBatch(policy, raw_queries);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string_view>& raw_queries) const {
+    return RunQueryBatch(policy, raw_queries);
+}
+
+std::vector<std::vector<Document>> SearchServer::FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string_view>& raw_queries) const {
+    return RunQueryBatch(policy, raw_queries);
+}
+
+// Matches FindTopDocuments(query) bit for bit: every query adds the scores of
+// its words in its own word order, as the words are visited in sorted order,
+// and ranks the same id-ordered candidates with the same sort
+void SearchServer::FindTopDocumentsBatchBlock(const std::vector<Query>& queries, const std::vector<bool>& is_batched,
+    size_t first, size_t last, const BatchDocuments& documents, std::vector<std::vector<Document>>& results) const {
+
+    const TfIdfScorer scorer;
+    struct TermScan {
+        const Postings* postings;
+        TermStatistics stats;
+        double weight;
+        Postings::const_iterator it;
+        std::vector<uint32_t> queries;  // indexes in the block
+    };
+    std::vector<TermScan> terms;
+    {
+        std::map<std::string_view, std::vector<uint32_t>> word_queries;
+        for (size_t i = first; i < last; ++i) {
+            if (is_batched[i]) {
+                for (const std::string_view word : queries[i].plus_words) {
+                    word_queries[word].push_back(static_cast<uint32_t>(i - first));
+                }
+            }
+        }
+        for (auto& [word, word_query_indexes] : word_queries) {
+            const auto postings_it = word_to_document_freqs_.find(word);
+            if (postings_it == word_to_document_freqs_.end() || postings_it->second.empty()) {
+                continue;
+            }
+            const TermStatistics stats = GetTermStatistics(postings_it->second);
+            terms.push_back({ &postings_it->second, stats, scorer.ComputeTermWeight(stats), postings_it->second.begin(), std::move(word_query_indexes) });
+        }
+    }
+
+    const size_t query_count = last - first;
+    std::vector<std::vector<Document>> matched(query_count);
+    std::vector<double> relevance(query_count * DOCUMENT_BATCH_BLOCK);
+    std::vector<char> is_matched(query_count * DOCUMENT_BATCH_BLOCK);
+    for (size_t block_first = 0; block_first < documents.ids.size(); block_first += DOCUMENT_BATCH_BLOCK) {
+        const size_t block_last = std::min(block_first + DOCUMENT_BATCH_BLOCK, documents.ids.size());
+        for (TermScan& term : terms) {
+            size_t position = block_first;
+            for (; term.it != term.postings->end(); ++term.it) {
+                const auto [document_id, term_freq] = *term.it;
+                if (block_last < documents.ids.size() && document_id >= documents.ids[block_last]) {
+                    break;
+                }
+                position = std::lower_bound(documents.ids.begin() + position, documents.ids.begin() + block_last, document_id)
+                    - documents.ids.begin();
+                if (!documents.is_actual[position]) {
+                    continue;
+                }
+                const double score = scorer.ComputeScore(term_freq, documents.lengths[position], term.weight, term.stats);
+                for (const uint32_t query : term.queries) {
+                    const size_t slot = query * DOCUMENT_BATCH_BLOCK + (position - block_first);
+                    relevance[slot] += score;
+                    is_matched[slot] = 1;
+                }
+            }
+        }
+        for (size_t query = 0; query < query_count; ++query) {
+            for (size_t position = block_first; position < block_last; ++position) {
+                const size_t slot = query * DOCUMENT_BATCH_BLOCK + (position - block_first);
+                if (is_matched[slot]) {
+                    matched[query].push_back({ documents.ids[position], relevance[slot], documents.ratings[position] });
+                    relevance[slot] = 0.0;
+                    is_matched[slot] = 0;
+                }
+            }
+        }
+    }
+
+    for (size_t query = 0; query < query_count; ++query) {
+        if (!is_batched[first + query]) {
+            continue;
+        }
+        std::vector<Document>& matched_documents = matched[query];
+        for (const std::string_view word : queries[first + query].minus_words) {
+            const auto postings_it = word_to_document_freqs_.find(word);
+            if (postings_it == word_to_document_freqs_.end()) {
+                continue;
+            }
+            const Postings& postings = postings_it->second;
+            auto it = postings.begin();
+            matched_documents.erase(std::remove_if(matched_documents.begin(), matched_documents.end(), [&](const Document& document) {
+                it = postings.Seek(it, document.id);
+                return it != postings.end() && (*it).first == document.id;
+                }), matched_documents.end());
+        }
+        const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+        std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(), IsRankedHigher);
+        matched_documents.resize(result_count);
+        results[first + query] = std::move(matched_documents);
+    }
+}
+
+std::vector<Document> SearchServer::FindTopDocumentsBoolean(const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocumentsBoolean(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        });
+}
+
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(ThreadPool& executor, std::string raw_query, const SearchLimits& limits) const {
+    return FindTopDocumentsAsync(executor, std::move(raw_query), [](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == DocumentStatus::ACTUAL;
+        }, TfIdfScorer{}, limits);
+}
+
+ResultCursor SearchServer::OpenResultCursor(const std::string_view raw_query, DocumentStatus status) const {
+    return OpenResultCursor(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+        return document_status == status;
+        });
+}
+
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
@@ -150,18 +476,122 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::execution::paral
     const std::string_view raw_query) const {
     return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 }
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, QueryCost& cost) const {
+    return FindTopDocuments(raw_query, [](int, DocumentStatus document_status, int) {
+        return document_status == DocumentStatus::ACTUAL;
+        }, TfIdfScorer{}, cost);
+}
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, SearchFacets& facets) const {
+    return FindTopDocuments(raw_query, [](int, DocumentStatus document_status, int) {
+        return document_status == DocumentStatus::ACTUAL;
+        }, TfIdfScorer{}, facets);
+}
 
 
 int SearchServer::GetDocumentCount() const {
     return (int)documents_.size();
 }
 
+double SearchServer::GetAverageDocumentLength() const {
+    return documents_.empty() ? 0.0 : total_document_length_ * 1.0 / documents_.size();
+}
+
+TermStatistics SearchServer::GetTermStatistics(const Postings& postings) const {
+    return { GetDocumentCount(), static_cast<int>(postings.size()), GetAverageDocumentLength() };
+}
+
+std::unique_ptr<QueryCursor> SearchServer::CompileBooleanQuery(const BooleanQueryNode& node,
+    std::vector<TermCursor*>& scored_terms, bool is_scored) const {
+
+    std::vector<std::unique_ptr<QueryCursor>> included;
+    std::vector<std::unique_ptr<QueryCursor>> excluded;
+    const auto make_term_cursor = [&scored_terms, is_scored](const Postings& postings) {
+        auto cursor = std::make_unique<TermCursor>(postings);
+        if (is_scored) {
+            scored_terms.push_back(cursor.get());
+        }
+        return cursor;
+    };
+
+    switch (node.type) {
+    case BooleanQueryNode::Type::WORD: {
+        const QueryWord query_word = ParseQueryWord(node.word);
+        if (query_word.is_minus) {
+            throw std::invalid_argument("Boolean query word "s + (std::string)node.word + " must use NOT instead of -"s);
+        }
+        // The analyzer may split a word, its parts must all match
+        std::string buffer;
+        analyzer_.ForEachPart(query_word.data, [&](std::string_view part) {
+            const std::string_view term = analyzer_.Normalize(part, buffer, !query_word.is_pattern);
+            if (IsStopWord(term)) {
+                return;
+            }
+            if (!query_word.is_pattern) {
+                const auto it = word_to_document_freqs_.find(term);
+                if (it == word_to_document_freqs_.end()) {
+                    included.push_back(std::make_unique<EmptyCursor>());
+                }
+                else {
+                    included.push_back(make_term_cursor(it->second));
+                }
+                return;
+            }
+            if (TermDictionary::IsPattern(term.substr(0, 1))) {
+                throw std::invalid_argument("Query word "s + (std::string)node.word + " must not start with a wildcard"s);
+            }
+            std::vector<std::unique_ptr<QueryCursor>> expansions;
+            for (const auto term_id : ExpandPattern(term)) {
+                expansions.push_back(make_term_cursor(*term_postings_[term_id]));
+            }
+            included.push_back(std::make_unique<OrCursor>(std::move(expansions)));
+            });
+        break;
+    }
+    case BooleanQueryNode::Type::AND:
+        for (const BooleanQueryNode& child : node.children) {
+            const bool is_negated = child.type == BooleanQueryNode::Type::NOT;
+            auto cursor = is_negated
+                ? CompileBooleanQuery(child.children[0], scored_terms, false)
+                : CompileBooleanQuery(child, scored_terms, is_scored);
+            if (cursor) {
+                (is_negated ? excluded : included).push_back(std::move(cursor));
+            }
+        }
+        break;
+    case BooleanQueryNode::Type::OR: {
+        std::vector<std::unique_ptr<QueryCursor>> children;
+        for (const BooleanQueryNode& child : node.children) {
+            if (auto cursor = CompileBooleanQuery(child, scored_terms, is_scored)) {
+                children.push_back(std::move(cursor));
+            }
+        }
+        if (children.empty()) {
+            return nullptr;
+        }
+        return children.size() == 1 ? std::move(children[0]) : std::make_unique<OrCursor>(std::move(children));
+    }
+    case BooleanQueryNode::Type::NOT:
+        // ParseBooleanQuery only leaves negations under AND
+        throw std::invalid_argument("NOT must narrow an AND"s);
+    }
+
+    // Stop words only, as "the NOT cat", find nothing like an ordinary query
+    if (included.empty()) {
+        return nullptr;
+    }
+    if (included.size() == 1 && excluded.empty()) {
+        return std::move(included[0]);
+    }
+    return std::make_unique<AndCursor>(std::move(included), std::move(excluded));
+}
+
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    SEARCH_TRACE_SCOPE(MATCH);
     const auto query = ParseQuery(raw_query, false);
-    if (query.plus_words.empty())
+    if (query.plus_words.empty() && query.plus_patterns.empty())
     {
         throw std::invalid_argument("invalid argument");
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
     }
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
@@ -173,23 +603,35 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
             return { matched_words, documents_.at(document_id).status };
         }
     }
+    if (!MatchesPhrases(query, document_id) || !MatchPatterns(query.minus_patterns, document_id).empty()) {
+        return { matched_words, documents_.at(document_id).status };
+    }
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
             continue;
         }
-        if (word_to_document_freqs_.at(std::string{ word }).count(document_id)) {
-            matched_words.push_back(word);
+        // The query may own the word, the dictionary key outlives it
+        if (it->second.count(document_id)) {
+            matched_words.push_back(it->first);
         }
     }
+    for (const std::string_view word : MatchPatterns(query.plus_patterns, document_id)) {
+        matched_words.push_back(word);
+    }
+    for (const std::string_view word : MatchFuzzyWords(query.plus_words, document_id)) {
+        matched_words.push_back(word);
+    }
 
     return { matched_words, documents_.at(document_id).status };
 }
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy p, const std::string_view raw_query, int document_id) const {
+    SEARCH_TRACE_SCOPE(MATCH);
     const auto query = ParseQuery(raw_query, false);
-    if (query.plus_words.empty())
+    if (query.plus_words.empty() && query.plus_patterns.empty())
     {
         throw std::invalid_argument("invalid argument");
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
     }
     std::vector<std::string_view> matched_words;
     for (const std::string_view word : query.minus_words) {
@@ -201,36 +643,61 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
             return { matched_words, documents_.at(document_id).status };
         }
     }
+    if (!MatchesPhrases(query, document_id) || !MatchPatterns(query.minus_patterns, document_id).empty()) {
+        return { matched_words, documents_.at(document_id).status };
+    }
     for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(word) == 0) {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
             continue;
         }
-        if (word_to_document_freqs_.at(std::string{ word }).count(document_id)) {
-            matched_words.push_back(word);
+        // The query may own the word, the dictionary key outlives it
+        if (it->second.count(document_id)) {
+            matched_words.push_back(it->first);
         }
     }
+    for (const std::string_view word : MatchPatterns(query.plus_patterns, document_id)) {
+        matched_words.push_back(word);
+    }
+    for (const std::string_view word : MatchFuzzyWords(query.plus_words, document_id)) {
+        matched_words.push_back(word);
+    }
     
     return { matched_words, documents_.at(document_id).status };
 }
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy p, const std::string_view raw_query, int document_id) const {
+    SEARCH_TRACE_SCOPE(MATCH);
     const auto query = ParseQuery(raw_query, true);
-    if (query.plus_words.empty())
+    if (query.plus_words.empty() && query.plus_patterns.empty())
     {
         throw std::invalid_argument("invalid argument");
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
     }
     std::vector<std::string_view> matched_words(query.plus_words.size());
 
     if (std::any_of(p, query.minus_words.begin(), query.minus_words.end(), [&](auto& word) {
         return word_to_document_freqs_.count(std::string{ word }) != 0 && word_to_document_freqs_.at(std::string{ word }).count(document_id); })) {
         matched_words.clear();
-        return { {}, documents_.at(document_id).status };
+        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
+    }
+    if (!MatchesPhrases(query, document_id) || !MatchPatterns(query.minus_patterns, document_id).empty()) {
+        return { std::vector<std::string_view>{}, documents_.at(document_id).status };
     }
     auto end = std::copy_if(p, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(),
         [&](auto& word) {
             return word_to_document_freqs_.count(std::string{ word }) != 0 && word_to_document_freqs_.at(std::string{ word }).count(document_id);
         });
     matched_words.resize(end - matched_words.begin());
+    // The query may own the words, the dictionary keys outlive it
+    for (std::string_view& word : matched_words) {
+        word = word_to_document_freqs_.find(word)->first;
+    }
+    for (const std::string_view word : MatchPatterns(query.plus_patterns, document_id)) {
+        matched_words.push_back(word);
+    }
+    for (const std::string_view word : MatchFuzzyWords(query.plus_words, document_id)) {
+        matched_words.push_back(word);
+    }
 
     std::sort(p, matched_words.begin(), matched_words.end());
     end = std::unique(p, matched_words.begin(), matched_words.end());
@@ -240,7 +707,7 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -250,19 +717,89 @@ bool SearchServer::IsValidWord(const std::string_view word) {
         });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
+std::vector<std::string_view> SearchServer::AddWordsToDictionary(const std::string_view text, std::vector<Postings*>& postings) {
+    // The whole text is validated before the dictionary changes
+    std::vector<std::string_view> tokens;
+    for (const Token& token : WordTokenizer(text)) {
+        if (token.has_control_chars) {
+            throw std::invalid_argument("Word "s + (std::string)token.word + " is invalid"s);
+        }
+        tokens.push_back(token.word);
+    }
+
+    // Views into the document text or the analyzer buffer die with this call,
+    // so the result refers to the dictionary keys instead
     std::vector<std::string_view> words;
-    for (const std::string_view word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("Word "s + (std::string)word + " is invalid"s);
+    words.reserve(tokens.size());
+    postings.reserve(tokens.size());
+    std::string buffer;
+    for (const std::string_view token : tokens) {
+        analyzer_.ForEachPart(token, [&](std::string_view part) {
+            const std::string_view word = analyzer_.Normalize(part, buffer);
+            if (IsStopWord(word)) {
+                return;
+            }
+            const auto [key, word_postings] = AddWordToDictionary(word);
+            words.push_back(key);
+            postings.push_back(word_postings);
+            });
+    }
+    return words;
+}
+
+std::pair<std::string_view, SearchServer::Postings*> SearchServer::AddWordToDictionary(const std::string_view word) {
+    auto it = word_to_document_freqs_.find(word);
+    if (it == word_to_document_freqs_.end()) {
+        it = word_to_document_freqs_.emplace(std::string{ word }, Postings(&memory_counters_->postings, is_compact_)).first;
+        // Keys too long for the small string buffer own a heap block
+        if (it->first.capacity() > std::string().capacity()) {
+            memory_counters_->dictionary.Add(it->first.capacity() + 1);
         }
-        if (!IsStopWord(word)) {
-            words.push_back(word);
+        const auto term_id = static_cast<TermDictionary::TermId>(term_postings_.size());
+        term_dictionary_.Insert(it->first, term_id);
+        if (fuzzy_options_.max_edit_distance > 0) {
+            fuzzy_index_.Insert(it->first, term_id);
         }
+        term_postings_.push_back(&it->second);
+        term_words_.push_back(it->first);
+    }
+    return { it->first, &it->second };
+}
+
+std::vector<std::string_view> SearchServer::AnalyzeDocument(const std::string_view text, std::deque<std::string>& normalized_words) const {
+    std::vector<std::string_view> words;
+    std::string buffer;
+    for (const Token& token : WordTokenizer(text)) {
+        if (token.has_control_chars) {
+            throw std::invalid_argument("Word "s + (std::string)token.word + " is invalid"s);
+        }
+        analyzer_.ForEachPart(token.word, [&](std::string_view part) {
+            const std::string_view word = analyzer_.Normalize(part, buffer);
+            if (IsStopWord(word)) {
+                return;
+            }
+            if (word.data() == buffer.data()) {
+                words.push_back(normalized_words.emplace_back(word));
+            }
+            else {
+                words.push_back(word);
+            }
+            });
     }
     return words;
 }
 
+std::vector<std::string> SearchServer::AnalyzeStopWords(const std::set<std::string, std::less<>>& stop_words) const {
+    std::vector<std::string> result;
+    std::string buffer;
+    for (const std::string& stop_word : stop_words) {
+        analyzer_.ForEachPart(stop_word, [&](std::string_view part) {
+            result.emplace_back(analyzer_.Normalize(part, buffer));
+            });
+    }
+    return result;
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -284,73 +821,453 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
     if (word.empty() || word[0] == '-' || !IsValidWord(word)) {
         throw std::invalid_argument("Query word "s + (std::string)text + " is invalid"s);
     }
+    const bool is_pattern = use_wildcards_ && TermDictionary::IsPattern(word);
+    if (is_pattern && TermDictionary::IsPattern(word.substr(0, 1))) {
+        throw std::invalid_argument("Query word "s + (std::string)text + " must not start with a wildcard"s);
+    }
 
-    return { word, is_minus, IsStopWord(word) };
+    return { word, is_minus, IsStopWord(word), is_pattern };
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool is_par) const {
+    SEARCH_TRACE_SCOPE(PARSE);
     Query result;
+    std::set<std::string_view> plus, minus;
+    std::set<std::string_view> plus_patterns, minus_patterns;
+    std::optional<Phrase> phrase;
 
-    if (!is_par) {
-        std::set<std::string_view> plus, minus;
-        for (const std::string_view word : SplitIntoWords(text)) {
+    const auto add_word = [&](const QueryWord& query_word) {
+        if (query_word.is_stop) {
+            return;
+        }
+        if (query_word.is_pattern) {
+            (query_word.is_minus ? minus_patterns : plus_patterns).insert(query_word.data);
+            return;
+        }
+        if (query_word.is_minus) {
+            if (is_par) {
+                result.minus_words.push_back(query_word.data);
+            }
+            else {
+                minus.insert(query_word.data);
+            }
+        }
+        else {
+            if (is_par) {
+                result.plus_words.push_back(query_word.data);
+            }
+            else {
+                plus.insert(query_word.data);
+            }
+        }
+    };
+
+    std::string buffer;
+    // Runs the analyzer over a parsed word, which may yield several terms
+    const auto for_each_term = [&](const QueryWord& query_word, auto callback) {
+        analyzer_.ForEachPart(query_word.data, [&](std::string_view part) {
+            QueryWord term = query_word;
+            term.data = analyzer_.Normalize(part, buffer, !query_word.is_pattern);
+            if (term.data.data() == buffer.data()) {
+                term.data = result.normalized_words.emplace_back(term.data);
+            }
+            if (term.is_pattern && TermDictionary::IsPattern(term.data.substr(0, 1))) {
+                throw std::invalid_argument("Query word "s + (std::string)query_word.data + " must not start with a wildcard"s);
+            }
+            term.is_stop = IsStopWord(term.data);
+            callback(term);
+            });
+    };
+
+    for (const Token& token : WordTokenizer(text)) {
+        std::string_view word = token.word;
+        if (!phrase && word[0] == '"') {
+            phrase.emplace();
+            word.remove_prefix(1);
+        }
+        if (!phrase) {
+            for_each_term(ParseQueryWord(word), add_word);
+            continue;
+        }
+
+        const size_t quote = word.find('"');
+        std::string_view suffix;
+        if (quote != std::string_view::npos) {
+            suffix = word.substr(quote + 1);
+            word = word.substr(0, quote);
+        }
+        if (!word.empty()) {
             const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    minus.insert(query_word.data);
-                }
-                else {
-                    plus.insert(query_word.data);
+            if (query_word.is_minus || query_word.is_pattern) {
+                throw std::invalid_argument("Word "s + (std::string)word + " is not allowed inside a phrase"s);
+            }
+            for_each_term(query_word, [&](const QueryWord& term) {
+                add_word(term);
+                if (!term.is_stop) {
+                    phrase->words.push_back(term.data);
                 }
+                });
+        }
+        if (quote != std::string_view::npos) {
+            phrase->proximity = ParsePhraseProximity(suffix);
+            if (!phrase->words.empty()) {
+                result.phrases.push_back(std::move(*phrase));
             }
+            phrase.reset();
         }
+    }
+    if (phrase) {
+        throw std::invalid_argument("Unterminated phrase in query "s + (std::string)text);
+    }
+    if (!result.phrases.empty() && !use_positions_) {
+        throw std::invalid_argument("Phrase queries require the positional index"s);
+    }
+
+    result.plus_patterns.assign(plus_patterns.begin(), plus_patterns.end());
+    result.minus_patterns.assign(minus_patterns.begin(), minus_patterns.end());
 
+    if (!is_par) {
         for (const auto i : minus)
             result.minus_words.push_back(i);
         for (const auto i : plus)
             result.plus_words.push_back(i);
     }
-    else {
-        for (const std::string_view word : SplitIntoWords(text)) {
-            const auto query_word = ParseQueryWord(word);
-            if (!query_word.is_stop) {
-                if (query_word.is_minus) {
-                    result.minus_words.push_back(query_word.data);
-                }
-                else {
-                    result.plus_words.push_back(query_word.data);
-                }
+    return result;
+}
+
+std::optional<int> SearchServer::ParsePhraseProximity(const std::string_view suffix) {
+    if (suffix.empty()) {
+        return std::nullopt;
+    }
+    if (suffix.size() < 2 || suffix[0] != '~' || suffix.size() > 10
+        || !std::all_of(suffix.begin() + 1, suffix.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+        throw std::invalid_argument("Invalid phrase proximity "s + (std::string)suffix);
+    }
+    return std::stoi(std::string{ suffix.substr(1) });
+}
+
+bool SearchServer::MatchesPhrases(const Query& query, int document_id) const {
+    for (const Phrase& phrase : query.phrases) {
+        if (phrase.proximity) {
+            continue;
+        }
+        // Cheap document-level check before decoding positions
+        for (const std::string_view word : phrase.words) {
+            const auto it = word_to_document_freqs_.find(word);
+            if (it == word_to_document_freqs_.end() || it->second.count(document_id) == 0) {
+                return false;
             }
         }
+        if (!positional_index_.ContainsPhrase(phrase.words, document_id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SearchServer::ApplyPhrases(const Query& query, std::map<int, double>& document_to_relevance) const {
+    for (auto it = document_to_relevance.begin(); it != document_to_relevance.end();) {
+        if (!MatchesPhrases(query, it->first)) {
+            it = document_to_relevance.erase(it);
+            continue;
+        }
+        for (const Phrase& phrase : query.phrases) {
+            if (!phrase.proximity) {
+                continue;
+            }
+            const auto span = positional_index_.ComputeMinSpan(phrase.words, it->first);
+            const int phrase_size = static_cast<int>(phrase.words.size());
+            if (span && static_cast<int>(*span) <= phrase_size + *phrase.proximity) {
+                const int extra = std::max(0, static_cast<int>(*span) - phrase_size);
+                it->second *= 1.0 + PROXIMITY_WEIGHT / (1 + extra);
+            }
+        }
+        ++it;
+    }
+}
+
+void SearchServer::EnablePositionalIndex() {
+    if (!documents_.empty()) {
+        throw std::logic_error("Positional index must be enabled before adding documents"s);
     }
+    use_positions_ = true;
+}
+
+size_t SearchServer::GetPositionalIndexMemoryUsage() const {
+    return use_positions_ ? positional_index_.GetMemoryUsage() : 0;
+}
+
+MemoryStats SearchServer::GetMemoryStats() const {
+    MemoryStats result;
+    result.dictionary_bytes = memory_counters_->dictionary.GetBytes();
+    result.postings_bytes = memory_counters_->postings.GetBytes();
+    result.forward_index_bytes = memory_counters_->forward_index.GetBytes();
+    result.documents_bytes = memory_counters_->documents.GetBytes();
+    result.document_ids_bytes = memory_counters_->document_ids.GetBytes();
+    result.duplicate_index_bytes = memory_counters_->duplicate_index.GetBytes() + (use_near_duplicates_ ? near_duplicates_.GetMemoryUsage() : 0);
+    result.positional_index_bytes = GetPositionalIndexMemoryUsage();
+    result.term_dictionary_bytes = term_dictionary_.GetMemoryUsage();
+    result.fuzzy_index_bytes = fuzzy_index_.GetMemoryUsage();
+    result.impact_index_bytes = impact_index_ ? impact_index_->GetMemoryUsage() : 0;
     return result;
 }
 
-// Existence required
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string{ word }).size());
+void SearchServer::SetIndexMemory(const IndexMemoryOptions& options) {
+    MemoryCounter* const counters[] = { &memory_counters_->dictionary, &memory_counters_->postings, &memory_counters_->forward_index,
+        &memory_counters_->documents, &memory_counters_->document_ids, &memory_counters_->duplicate_index };
+    for (const MemoryCounter* counter : counters) {
+        if (counter->GetBytes() != 0) {
+            throw std::logic_error("Index memory must be set on an empty server"s);
+        }
+    }
+    auto index_memory = std::make_unique<IndexMemoryResource>(options);
+    for (MemoryCounter* counter : counters) {
+        counter->SetResource(index_memory.get());
+    }
+    // The old resource holds nothing, as nothing is counted
+    index_memory_ = std::move(index_memory);
 }
 
-std::set<int>::const_iterator SearchServer::begin() const {
-    return document_ids_.begin();
+IndexMemoryStats SearchServer::GetIndexMemoryStats() const {
+    return index_memory_ ? index_memory_->GetStats() : IndexMemoryStats{};
 }
-std::set<int>::const_iterator SearchServer::end() const {
-    return document_ids_.end();
+
+void SearchServer::Compact() {
+    for (auto& [_, postings] : word_to_document_freqs_) {
+        postings.Compact();
+    }
+    documents_.ForEach([](int, DocumentData& document) {
+        document.word_frequencies.Compact();
+        });
+    term_postings_.shrink_to_fit();
+    term_words_.shrink_to_fit();
+    is_compact_ = true;
+}
+
+bool SearchServer::IsCompact() const {
+    return is_compact_;
+}
+
+void SearchServer::SetMaxTermExpansions(size_t max_term_expansions) {
+    max_term_expansions_ = max_term_expansions;
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    //std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    static std::map<std::string_view, double> result;
-    result.clear();
+void SearchServer::SetWildcardMatching(bool is_enabled) {
+    use_wildcards_ = is_enabled;
+}
+
+std::vector<TermDictionary::TermId> SearchServer::ExpandPattern(std::string_view pattern) const {
+    SEARCH_TRACE_SCOPE(TERM_LOOKUP);
+    std::vector<TermDictionary::TermId> result;
+    if (max_term_expansions_ == 0) {
+        return result;
+    }
+    term_dictionary_.ForEachMatch(pattern, [this, &result](std::string_view, TermDictionary::TermId term_id) {
+        if (!term_postings_[term_id]->empty()) {
+            result.push_back(term_id);
+        }
+        return result.size() < max_term_expansions_;
+        });
+    return result;
+}
+
+void SearchServer::SetFuzzyMatching(const FuzzyMatchOptions& options) {
+    if (options.max_edit_distance < 0 || options.max_edit_distance > 1 || options.max_document_freq < 0) {
+        throw std::invalid_argument("Invalid fuzzy matching options"s);
+    }
+    // Terms added while fuzzy matching was off are missing from the index
+    if (options.max_edit_distance > 0 && fuzzy_index_.size() != term_words_.size()) {
+        fuzzy_index_ = FuzzyIndex();
+        for (size_t term_id = 0; term_id < term_words_.size(); ++term_id) {
+            fuzzy_index_.Insert(term_words_[term_id], static_cast<FuzzyIndex::TermId>(term_id));
+        }
+    }
+    fuzzy_options_ = options;
+}
+
+std::vector<std::pair<TermDictionary::TermId, int>> SearchServer::FindFuzzyCandidates(std::string_view word) const {
+    SEARCH_TRACE_SCOPE(TERM_LOOKUP);
+    std::vector<std::pair<TermDictionary::TermId, int>> result;
+    if (fuzzy_options_.max_edit_distance == 0 || word.size() <= 2 || fuzzy_options_.max_candidates == 0) {
+        return result;
+    }
+    const auto it = word_to_document_freqs_.find(word);
+    if (it != word_to_document_freqs_.end() && static_cast<int>(it->second.size()) > fuzzy_options_.max_document_freq) {
+        return result;
+    }
 
-    for (const auto [word, id_freq] : word_to_document_freqs_) {
-        for (const auto [id, freq] : id_freq) {
-            if (id == document_id) {
-                //std::pair<std::string, double> r = { word, freq };
-                result.insert({ word, freq });
+    fuzzy_index_.ForEachWithinOneEdit(word, fuzzy_options_.exact_prefix_length, [this, &result](std::string_view, FuzzyIndex::TermId term_id, int distance) {
+        if (distance > 0 && !term_postings_[term_id]->empty()) {
+            result.push_back({ term_id, distance });
+        }
+        return result.size() < fuzzy_options_.max_candidates;
+        });
+    return result;
+}
+
+std::vector<std::string_view> SearchServer::MatchFuzzyWords(const std::vector<std::string_view>& words, int document_id) const {
+    std::vector<std::string_view> result;
+    if (fuzzy_options_.max_edit_distance == 0) {
+        return result;
+    }
+    for (const std::string_view word : words) {
+        for (const auto& [term_id, _] : FindFuzzyCandidates(word)) {
+            if (term_postings_[term_id]->count(document_id)) {
+                result.push_back(term_words_[term_id]);
             }
         }
     }
+    return result;
+}
 
+std::vector<std::string_view> SearchServer::MatchPatterns(const std::vector<std::string_view>& patterns, int document_id) const {
+    std::vector<std::string_view> result;
+    for (const std::string_view pattern : patterns) {
+        for (const auto term_id : ExpandPattern(pattern)) {
+            if (term_postings_[term_id]->count(document_id)) {
+                result.push_back(term_words_[term_id]);
+            }
+        }
+    }
     return result;
-}
\ No newline at end of file
+}
+
+void SearchServer::RemovePositions(int document_id) {
+    if (!use_positions_) {
+        return;
+    }
+    if (documents_.count(document_id) == 0) {
+        return;
+    }
+    const WordFrequencies& word_freqs = documents_.at(document_id).word_frequencies;
+    std::vector<std::string_view> words;
+    words.reserve(word_freqs.size());
+    for (const auto& [word, _] : word_freqs) {
+        words.push_back(word);
+    }
+    positional_index_.RemoveDocument(document_id, words);
+}
+
+SearchServer::DocumentIdIterator SearchServer::begin() const {
+    return documents_.begin();
+}
+SearchServer::DocumentIdIterator SearchServer::end() const {
+    return documents_.end();
+}
+
+SearchServer::DocumentRange SearchServer::GetDocuments() const {
+    return DocumentRange(DocumentIterator(documents_.begin()), DocumentIterator(documents_.end()));
+}
+
+SearchServer::DocumentRange SearchServer::GetDocuments(int first_id, int last_id) const {
+    const auto [first, last] = documents_.GetRange(first_id, last_id);
+    return DocumentRange(DocumentIterator(first), DocumentIterator(last));
+}
+
+std::vector<SearchServer::DocumentRange> SearchServer::PartitionDocuments(size_t part_count) const {
+    return MakeDocumentRanges(documents_.Partition({ documents_.begin(), documents_.end() }, part_count));
+}
+
+std::vector<SearchServer::DocumentRange> SearchServer::PartitionDocuments(int first_id, int last_id, size_t part_count) const {
+    return MakeDocumentRanges(documents_.Partition(documents_.GetRange(first_id, last_id), part_count));
+}
+
+std::vector<SearchServer::DocumentRange> SearchServer::MakeDocumentRanges(const std::vector<DocumentColumn<DocumentData>::Range>& parts) {
+    std::vector<DocumentRange> result;
+    result.reserve(parts.size());
+    for (const auto& [first, last] : parts) {
+        result.emplace_back(DocumentIterator(first), DocumentIterator(last));
+    }
+    return result;
+}
+
+std::vector<Document> SearchServer::FindSimilarDocuments(int document_id, size_t k) const {
+    if (documents_.count(document_id) == 0) {
+        throw std::invalid_argument("Invalid document_id"s);
+    }
+    const TfIdfScorer scorer;
+    struct QueryTerm {
+        const Postings* postings;
+        TermStatistics stats;
+        double term_weight;
+        double query_weight;
+    };
+    std::vector<QueryTerm> terms;
+    for (const auto [word, term_freq] : documents_.at(document_id).word_frequencies) {
+        const Postings& postings = word_to_document_freqs_.find(word)->second;
+        const TermStatistics stats = GetTermStatistics(postings);
+        const double term_weight = scorer.ComputeTermWeight(stats);
+        // A word in every document tells nothing about similarity
+        if (term_weight > 0) {
+            terms.push_back({ &postings, stats, term_weight, term_freq * term_weight });
+        }
+    }
+    const auto is_heavier = [](const QueryTerm& lhs, const QueryTerm& rhs) {
+        return lhs.query_weight > rhs.query_weight;
+    };
+    if (terms.size() > MAX_SIMILARITY_TERMS) {
+        std::nth_element(terms.begin(), terms.begin() + MAX_SIMILARITY_TERMS, terms.end(), is_heavier);
+        terms.resize(MAX_SIMILARITY_TERMS);
+    }
+    std::sort(terms.begin(), terms.end(), is_heavier);
+
+    // Term at a time, heaviest first, into accumulators sorted by id. Heavy
+    // terms are rare ones, so the candidates come from short posting lists;
+    // once there are enough of them the rest of the terms seek only to them.
+    std::vector<std::pair<int, double>> accumulators;
+    std::vector<std::pair<int, double>> merged;
+    for (const QueryTerm& term : terms) {
+        if (accumulators.size() < MAX_SIMILARITY_CANDIDATES) {
+            merged.clear();
+            auto accumulator = accumulators.begin();
+            for (const auto [id, term_freq] : *term.postings) {
+                while (accumulator != accumulators.end() && accumulator->first < id) {
+                    merged.push_back(*accumulator++);
+                }
+                const DocumentData& document_data = documents_.at(id);
+                if (id == document_id || document_data.status != DocumentStatus::ACTUAL) {
+                    continue;
+                }
+                double score = term.query_weight * scorer.ComputeScore(term_freq, document_data.length, term.term_weight, term.stats);
+                if (accumulator != accumulators.end() && accumulator->first == id) {
+                    score += accumulator->second;
+                    ++accumulator;
+                }
+                merged.push_back({ id, score });
+            }
+            merged.insert(merged.end(), accumulator, accumulators.end());
+            accumulators.swap(merged);
+            continue;
+        }
+        auto posting = term.postings->begin();
+        for (auto& [id, score] : accumulators) {
+            posting = term.postings->Seek(posting, id);
+            if (posting == term.postings->end()) {
+                break;
+            }
+            const auto [posting_id, term_freq] = *posting;
+            if (posting_id == id) {
+                score += term.query_weight * scorer.ComputeScore(term_freq, documents_.at(id).length, term.term_weight, term.stats);
+            }
+        }
+    }
+
+    std::vector<Document> result;
+    result.reserve(accumulators.size());
+    for (const auto& [id, score] : accumulators) {
+        result.push_back({ id, score, documents_.at(id).rating });
+    }
+    if (result.size() > k) {
+        std::partial_sort(result.begin(), result.begin() + k, result.end(), IsRankedHigher);
+        result.resize(k);
+    }
+    else {
+        std::sort(result.begin(), result.end(), IsRankedHigher);
+    }
+    return result;
+}
+
+const SearchServer::WordFrequencies& SearchServer::GetWordFrequencies(int document_id) const {
+    static const WordFrequencies empty;
+    return documents_.count(document_id) ? documents_.at(document_id).word_frequencies : empty;
+}
@@ -11,45 +11,183 @@
 #include <vector>
 #include <deque>
 #include <numeric>
+#include <exception>
 #include <execution>
 #include <list>
+#include <memory>
+#include <optional>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <execution>
 
+#include "compactable_map.h"
+#include "boolean_query.h"
 #include "document.h"
+#include "document_column.h"
+#include "facets.h"
+#include "fuzzy_index.h"
+#include "impact_index.h"
+#include "index_memory.h"
+#include "memory_stats.h"
+#include "near_duplicates.h"
+#include "result_cursor.h"
+#include "search_hooks.h"
+#include "thread_pool.h"
 #include "string_processing.h"
-#include "log_duration.h"
+#include "trace.h"
 #include "concurrent_map.h"
+#include "positional_index.h"
+#include "relaxed_atomic.h"
+#include "scorers.h"
+#include "term_dictionary.h"
 
 using namespace std::string_literals;
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double DELTA = 1e-6;
+const double PROXIMITY_WEIGHT = 1.0;
+const size_t DEFAULT_MAX_TERM_EXPANSIONS = 64;
+// A similar-documents query keeps this many of the source document's terms
+const size_t MAX_SIMILARITY_TERMS = 25;
+// Once this many candidates are found, lighter terms only add to their scores
+const size_t MAX_SIMILARITY_CANDIDATES = 4096;
+// A query batch is scored QUERY_BATCH_BLOCK queries and DOCUMENT_BATCH_BLOCK
+// documents at a time, so that the blocks' accumulators stay in cache
+const size_t QUERY_BATCH_BLOCK = 64;
+const size_t DOCUMENT_BATCH_BLOCK = 2048;
 
-enum class DocumentStatus {
-    ACTUAL,
-    IRRELEVANT,
-    BANNED,
-    REMOVED,
+// Typo-tolerant matching of query words that are unknown or rare (document
+// frequency not above max_document_freq). Dictionary words one edit away
+// (see fuzzy_index.h; a transposition of adjacent characters counts as one
+// edit) are scored with their weight multiplied by penalty. max_edit_distance
+// is 0 or 1: larger distances would need an index of multiple deletions,
+// many times the size of the dictionary. As in common search engines, words
+// of up to 2 characters are matched exactly, and the first
+// exact_prefix_length characters must match.
+struct FuzzyMatchOptions {
+    int max_edit_distance = 0;  // 0 disables fuzzy matching, 1 enables it
+    int max_document_freq = 0;
+    double penalty = 0.5;
+    size_t max_candidates = 16;
+    size_t exact_prefix_length = 1;
+};
+
+// A document for SearchServer::AddDocuments
+struct DocumentInput {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
 };
 
 class SearchServer {
 public:
+    using WordFrequencies = CompactableMap<std::string_view, double>;
+
+private:
+    // Metadata and forward index of a document, kept together in id order.
+    // Rating and status may change while searches read them.
+    struct DocumentData {
+        RelaxedAtomic<int> rating = 0;
+        RelaxedAtomic<DocumentStatus> status = DocumentStatus::ACTUAL;
+        int length = 0;  // non-stop words count
+        WordFrequencies word_frequencies;
+    };
+
+public:
+    using DocumentIdIterator = DocumentColumn<DocumentData>::const_iterator;
+
+    // A document as seen by a scan; valid until the server changes
+    struct DocumentView {
+        int id;
+        DocumentStatus status;
+        int rating;
+        int length;
+        const WordFrequencies& word_frequencies;
+    };
+
+    class DocumentIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = DocumentView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = DocumentView;
+
+        DocumentIterator() = default;
+
+        explicit DocumentIterator(DocumentIdIterator it)
+            : it_(it) {
+        }
+
+        DocumentView operator*() const {
+            const DocumentData& data = it_.GetRecord();
+            return { *it_, data.status, data.rating, data.length, data.word_frequencies };
+        }
+
+        DocumentIterator& operator++() {
+            ++it_;
+            return *this;
+        }
+
+        bool operator==(const DocumentIterator& other) const {
+            return it_ == other.it_;
+        }
+
+        bool operator!=(const DocumentIterator& other) const {
+            return it_ != other.it_;
+        }
+
+    private:
+        DocumentIdIterator it_;
+    };
+
+    class DocumentRange {
+    public:
+        DocumentRange(DocumentIterator first, DocumentIterator last)
+            : first_(first)
+            , last_(last) {
+        }
+
+        DocumentIterator begin() const {
+            return first_;
+        }
+
+        DocumentIterator end() const {
+            return last_;
+        }
+
+    private:
+        DocumentIterator first_;
+        DocumentIterator last_;
+    };
+
+    // The analyzer is applied to stop words, documents and queries alike
     template <typename StringContainer>
-    SearchServer(const StringContainer& stop_words);
+    SearchServer(const StringContainer& stop_words, const AnalyzerOptions& analyzer_options = AnalyzerOptions{});
 
-    explicit SearchServer(const std::string& stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor
-                                                         // from string container
+    explicit SearchServer(const std::string& stop_words_text, const AnalyzerOptions& analyzer_options = AnalyzerOptions{})
+        : SearchServer(SplitIntoWords(stop_words_text), analyzer_options)  // Invoke delegating constructor
+                                                                           // from string container
     {
     }
-    explicit SearchServer(const std::string_view stop_words_text)
-        : SearchServer(SplitIntoWords(stop_words_text))  // Invoke delegating constructor
-                                                         // from string container
+    explicit SearchServer(const std::string_view stop_words_text, const AnalyzerOptions& analyzer_options = AnalyzerOptions{})
+        : SearchServer(SplitIntoWords(stop_words_text), analyzer_options)  // Invoke delegating constructor
+                                                                           // from string container
     {
     }
 
     //void AddDocument(int document_id, const std::string& document, DocumentStatus status, const std::vector<int>& ratings);
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    // Bulk loading: texts are analyzed in parallel and the documents are
+    // indexed in id order, so posting lists and the document column only
+    // grow at the end. Nothing is added if any id or text is invalid.
+    void AddDocuments(const std::vector<DocumentInput>& documents);
+
+    // Change a document's metadata in place, leaving its postings alone. The
+    // cost does not depend on the document length, and searches running on
+    // other threads at the same time see either the old or the new value.
+    void SetDocumentStatus(int document_id, DocumentStatus status);
+    void SetDocumentRating(int document_id, const std::vector<int>& ratings);
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy p, int document_id);
     void RemoveDocument(std::execution::parallel_policy p, int document_id);
@@ -60,6 +198,13 @@ public:
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocuments(const std::execution::parallel_policy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
     
     std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, const std::string_view raw_query, DocumentStatus status) const;
@@ -69,39 +214,234 @@ public:
     std::vector<Document> FindTopDocuments(const std::execution::sequenced_policy& policy, const std::string_view raw_query) const;
     std::vector<Document> FindTopDocuments(const std::execution::parallel_policy& policy, const std::string_view raw_query) const;
 
+    // FindTopDocuments(query) of every query, with exactly the same results.
+    // Queries are grouped by word, so a block of queries walks each posting
+    // list once and adds every posting's score to all queries of the block
+    // with that word. Queries with phrases or patterns, and all queries when
+    // fuzzy matching is on, are run one by one. With the parallel policy the
+    // blocks run in parallel.
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string>& raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string>& raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string>& raw_queries) const;
+    // Over queries kept elsewhere, e.g. in a network server's read buffers
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::sequenced_policy policy, const std::vector<std::string_view>& raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::parallel_policy policy, const std::vector<std::string_view>& raw_queries) const;
+
+    // Also adds the work the search did to cost
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, QueryCost& cost) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer, QueryCost& cost) const;
+
+    // Also fills facets (see facets.h) in the same scoring pass: the search
+    // hooks collect the status and rating of every match, the ones the
+    // predicate rejects included, before the top results are taken
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, SearchFacets& facets) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer, SearchFacets& facets) const;
+
+    // Boolean query (see boolean_query.h), e.g. "cat AND (dog OR bird) NOT fish".
+    // Matching documents are ranked by the scorer over the query words they
+    // contain; conjunctions skip through posting lists instead of merging them.
+    std::vector<Document> FindTopDocumentsBoolean(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsBoolean(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindTopDocumentsBoolean(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
+
+    // Stops scoring at the deadline or on cancellation and returns the best
+    // documents found by then, flagged as partial
+    template <typename DocumentPredicate, typename Scorer>
+    SearchResult FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer, const SearchLimits& limits) const;
+
+    // Builds the impact-ordered index (see impact_index.h) from the scores
+    // the scorer gives the current postings. Scores depend on all documents,
+    // so adding or removing a document drops the index; status and rating
+    // changes keep it.
+    void BuildImpactIndex();
+    template <typename Scorer>
+    void BuildImpactIndex(const Scorer& scorer);
+    bool HasImpactIndex() const;
+
+    // Score-at-a-time search over the impact index: segments of the query's
+    // plus words are scored from the highest impact down until all are done
+    // or the limits stop the search, so with max_postings the cost is bounded
+    // whatever the length of the posting lists. Relevance is the sum of the
+    // quantized scores. Minus words exclude documents; phrases and patterns
+    // are rejected with std::invalid_argument and fuzzy matching is not
+    // applied. Throws std::logic_error if the index is not built.
+    SearchResult FindTopDocumentsByImpact(const std::string_view raw_query, const SearchLimits& limits = SearchLimits{}) const;
+    template <typename DocumentPredicate>
+    SearchResult FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate, const SearchLimits& limits) const;
+
+    // Runs the limited search on the executor. The server must outlive the
+    // search and must not be modified until it completes.
+    std::future<SearchResult> FindTopDocumentsAsync(ThreadPool& executor, std::string raw_query, const SearchLimits& limits = SearchLimits{}) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::future<SearchResult> FindTopDocumentsAsync(ThreadPool& executor, std::string raw_query,
+        DocumentPredicate document_predicate, const Scorer& scorer, const SearchLimits& limits) const;
+
+    // All results of the query, without the MAX_RESULT_DOCUMENT_COUNT limit,
+    // to be read page by page in ranking order
+    ResultCursor OpenResultCursor(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    ResultCursor OpenResultCursor(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename DocumentPredicate, typename Scorer>
+    ResultCursor OpenResultCursor(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
+
     int GetDocumentCount() const;
+    double GetAverageDocumentLength() const;
+
+    // Document ids in increasing order
+    DocumentIdIterator begin() const;
+    DocumentIdIterator end() const;
 
-    std::set<int>::const_iterator begin() const;
-    std::set<int>::const_iterator end() const;
+    // Documents with first_id <= id < last_id in id order
+    DocumentRange GetDocuments() const;
+    DocumentRange GetDocuments(int first_id, int last_id) const;
+    // Consecutive parts of about the same size, to be scanned in parallel,
+    // e.g. each on its own ThreadPool task
+    std::vector<DocumentRange> PartitionDocuments(size_t part_count) const;
+    std::vector<DocumentRange> PartitionDocuments(int first_id, int last_id, size_t part_count) const;
+    // Calls function(const DocumentView&) for every document; with a
+    // parallel policy the calls come from several threads at once
+    template <typename ExecutionPolicy, typename Function>
+    void ForEachDocument(ExecutionPolicy&& policy, Function function) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy p, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy p, const std::string_view raw_query, int document_id) const;
     
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Empty for an unknown document
+    const WordFrequencies& GetWordFrequencies(int document_id) const;
+
+    // "More like this": ACTUAL documents ranked by the TF-IDF dot product
+    // with the given document, which is left out. The document's own word
+    // frequencies are the query, cut to its MAX_SIMILARITY_TERMS heaviest
+    // terms. Throws std::invalid_argument for an unknown document.
+    std::vector<Document> FindSimilarDocuments(int document_id, size_t k = MAX_RESULT_DOCUMENT_COUNT) const;
+    // Documents with the same words as one with a smaller id
     std::set<int> GetDuplicates() const;
+    // Jaccard similarity of the two documents' word sets, 1 for two empty
+    // ones. Throws std::invalid_argument for an unknown document.
+    double GetWordSimilarity(int lhs_document_id, int rhs_document_id) const;
+
+    // Keeps a MinHash signature of every document added after this call,
+    // so it must be called on an empty server
+    void EnableNearDuplicateIndex();
+    // Groups of documents with nearly the same words (see near_duplicates.h),
+    // joined by candidate pairs whose GetWordSimilarity is at least
+    // min_similarity. Without the index every call computes the signatures
+    // from the forward index, in parallel with the parallel policy.
+    std::vector<std::vector<int>> GetNearDuplicates(double min_similarity = DEFAULT_NEAR_DUPLICATE_SIMILARITY) const;
+    std::vector<std::vector<int>> GetNearDuplicates(std::execution::sequenced_policy policy, double min_similarity = DEFAULT_NEAR_DUPLICATE_SIMILARITY) const;
+    std::vector<std::vector<int>> GetNearDuplicates(std::execution::parallel_policy policy, double min_similarity = DEFAULT_NEAR_DUPLICATE_SIMILARITY) const;
+
+    // Positions are recorded only for documents added after this call,
+    // so it must be called on an empty server
+    void EnablePositionalIndex();
+    size_t GetPositionalIndexMemoryUsage() const;
+
+    MemoryStats GetMemoryStats() const;
+
+    // Allocates posting lists, the forward index and the document column
+    // from huge pages, optionally interleaved over NUMA nodes (see
+    // index_memory.h). Must be called on an empty server.
+    void SetIndexMemory(const IndexMemoryOptions& options);
+    // All zero with the default allocator
+    IndexMemoryStats GetIndexMemoryStats() const;
+
+    // Turns posting lists and word frequencies of documents into sorted
+    // arrays, for a read-mostly server after a bulk load. Searches get faster
+    // and the index smaller; documents may still be added, cheaply with ids
+    // above all present ones, while removing gets slower. The whole index
+    // shrinks about 2.2 times on the benchmark corpus, short of the 3-5
+    // times aimed at: dictionary nodes (about 150 bytes a word) stay as
+    // they are, and the forward index keeps a 16-byte word view per entry.
+    void Compact();
+    bool IsCompact() const;
+
+    // Upper bound on dictionary words a "prefix*" or wildcard query word expands to
+    void SetMaxTermExpansions(size_t max_term_expansions);
+    // Off by default, so '*' and '?' are plain characters as in any other
+    // word. Turned on, query words with them are patterns, and a word
+    // starting with one is rejected.
+    void SetWildcardMatching(bool is_enabled);
+
+    void SetFuzzyMatching(const FuzzyMatchOptions& options);
 
 private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
+    using Postings = CompactableMap<int, double>;
+    using DocumentIdSet = std::set<int, std::less<int>, CountingAllocator<int>>;
+
+    struct MemoryCounters {
+        MemoryCounter dictionary;
+        MemoryCounter postings;
+        MemoryCounter forward_index;
+        MemoryCounter documents;
+        MemoryCounter document_ids;
+        MemoryCounter duplicate_index;
     };
+
     //const std::set<std::string> stop_words_;
-    const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_ids_;
+    const TextAnalyzer analyzer_;
+    const HashedWordSet stop_words_;
+    // Declared before the counters and containers, as they return their
+    // memory to it when destroyed
+    std::unique_ptr<IndexMemoryResource> index_memory_;
+    // Allocators of the containers below point here, so the counters must
+    // not move with the server
+    std::unique_ptr<MemoryCounters> memory_counters_ = std::make_unique<MemoryCounters>();
+    std::map<std::string, Postings, std::less<>, CountingAllocator<std::pair<const std::string, Postings>>> word_to_document_freqs_{
+        CountingAllocator<std::pair<const std::string, Postings>>(&memory_counters_->dictionary) };
+    DocumentColumn<DocumentData> documents_{ &memory_counters_->document_ids, &memory_counters_->documents };
+    long long total_document_length_ = 0;
     std::vector<std::string> docs_;
+    bool is_compact_ = false;
 
     //std::vector<std::set<int>> duplicates_id;
-    std::map<std::set<std::string_view>, std::set<int>> words_to_id_;
+    // Documents by a hash of their distinct words. Keeping the hash instead
+    // of the words costs 8 bytes per group rather than 16 per word; the
+    // words of a group are compared in GetDuplicates, so a collision never
+    // makes a duplicate.
+    std::map<uint64_t, DocumentIdSet, std::less<uint64_t>, CountingAllocator<std::pair<const uint64_t, DocumentIdSet>>> words_to_id_{
+        CountingAllocator<std::pair<const uint64_t, DocumentIdSet>>(&memory_counters_->duplicate_index) };
+
+    bool use_positions_ = false;
+    PositionalIndex positional_index_;
+
+    bool use_near_duplicates_ = false;
+    NearDuplicateIndex near_duplicates_;
+
+    std::optional<ImpactIndex> impact_index_;
+
+    // Term ids index the vectors below
+    TermDictionary term_dictionary_;
+    std::vector<const Postings*, CountingAllocator<const Postings*>> term_postings_{
+        CountingAllocator<const Postings*>(&memory_counters_->dictionary) };
+    std::vector<std::string_view, CountingAllocator<std::string_view>> term_words_{
+        CountingAllocator<std::string_view>(&memory_counters_->dictionary) };
+    size_t max_term_expansions_ = DEFAULT_MAX_TERM_EXPANSIONS;
+    bool use_wildcards_ = false;
+    FuzzyMatchOptions fuzzy_options_;
+    // Holds every term while fuzzy matching is on
+    FuzzyIndex fuzzy_index_;
 
     bool IsStopWord(const std::string_view word) const;
 
     static bool IsValidWord(const std::string_view word);
 
-    std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+    // Analyzed non-stop words of a valid text as views of dictionary keys,
+    // along with their posting lists; new words are added to the dictionary
+    std::vector<std::string_view> AddWordsToDictionary(const std::string_view text, std::vector<Postings*>& postings);
+    // The dictionary key of the word and its posting list
+    std::pair<std::string_view, Postings*> AddWordToDictionary(const std::string_view word);
+    // Analyzed non-stop words of a valid text, as views of the text or of
+    // normalized_words; touches nothing, so texts can be analyzed in parallel
+    std::vector<std::string_view> AnalyzeDocument(const std::string_view text, std::deque<std::string>& normalized_words) const;
+    // words are dictionary keys, postings their posting lists
+    void IndexDocument(int document_id, const std::vector<std::string_view>& words, const std::vector<Postings*>& postings,
+        DocumentStatus status, const std::vector<int>& ratings);
+    std::vector<std::string> AnalyzeStopWords(const std::set<std::string, std::less<>>& stop_words) const;
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -109,29 +449,95 @@ private:
         std::string_view data;
         bool is_minus = false;
         bool is_stop = false;
+        bool is_pattern = false;
     };
 
     QueryWord ParseQueryWord(const std::string_view text) const;
 
+    // "quoted words" must appear as an exact phrase,
+    // "quoted words"~N only boosts documents where the words are within N extra positions
+    struct Phrase {
+        std::vector<std::string_view> words;
+        std::optional<int> proximity;
+    };
+
     struct Query {
+        // Words changed by the analyzer; a deque keeps the views below valid
+        std::deque<std::string> normalized_words;
         std::vector<std::string_view> plus_words;
         std::vector<std::string_view> minus_words;
+        std::vector<Phrase> phrases;
+        std::vector<std::string_view> plus_patterns;
+        std::vector<std::string_view> minus_patterns;
     };
 
     Query ParseQuery(const std::string_view text, bool is_par) const;
+    static std::optional<int> ParsePhraseProximity(const std::string_view suffix);
 
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    bool MatchesPhrases(const Query& query, int document_id) const;
+    void ApplyPhrases(const Query& query, std::map<int, double>& document_to_relevance) const;
+    void RemovePositions(int document_id);
+    void RemoveFromDuplicateIndexes(int document_id);
+    // Adds a word to the hash of a document's distinct words, taken in word order
+    static uint64_t AddToWordSetHash(uint64_t hash, std::string_view word);
+    bool HasSameWords(int lhs_document_id, int rhs_document_id) const;
 
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const;
-    template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate) const;
+    template <typename ExecutionPolicy>
+    std::vector<std::vector<int>> FindNearDuplicates(ExecutionPolicy&& policy, double min_similarity) const;
+
+    // Live documents in id order, as FindTopDocumentsBatch reads them
+    struct BatchDocuments {
+        std::vector<int> ids;
+        std::vector<int> lengths;
+        std::vector<int> ratings;
+        std::vector<bool> is_actual;
+    };
+
+    template <typename ExecutionPolicy, typename QueryContainer>
+    std::vector<std::vector<Document>> RunQueryBatch(ExecutionPolicy&& policy, const QueryContainer& raw_queries) const;
+    // Results of the queries [first, last) of a batch
+    void FindTopDocumentsBatchBlock(const std::vector<Query>& queries, const std::vector<bool>& is_batched, size_t first, size_t last,
+        const BatchDocuments& documents, std::vector<std::vector<Document>>& results) const;
+
+    static std::vector<DocumentRange> MakeDocumentRanges(const std::vector<DocumentColumn<DocumentData>::Range>& parts);
+
+    std::vector<TermDictionary::TermId> ExpandPattern(std::string_view pattern) const;
+    std::vector<std::string_view> MatchPatterns(const std::vector<std::string_view>& patterns, int document_id) const;
+
+    // (term id, edit distance) of dictionary words close to the word, empty
+    // if fuzzy matching is disabled or the word is frequent enough on its own
+    std::vector<std::pair<TermDictionary::TermId, int>> FindFuzzyCandidates(std::string_view word) const;
+    std::vector<std::string_view> MatchFuzzyWords(const std::vector<std::string_view>& words, int document_id) const;
+
+    TermStatistics GetTermStatistics(const Postings& postings) const;
+
+    // nullptr for a node of stop words only. Cursors of words that are not
+    // negated are added to scored_terms.
+    std::unique_ptr<QueryCursor> CompileBooleanQuery(const BooleanQueryNode& node, std::vector<TermCursor*>& scored_terms, bool is_scored) const;
+
+    // Merges posting lists of the pattern's words by document id with a heap
+    // and passes each document's summed score to accumulate(document_id, relevance)
+    template <typename DocumentPredicate, typename Scorer, typename Accumulator, typename Hooks>
+    void ScorePattern(std::string_view pattern, DocumentPredicate& document_predicate, const Scorer& scorer, Accumulator accumulate, Hooks& hooks) const;
+    template <typename DocumentPredicate, typename Scorer, typename Accumulator, typename Hooks>
+    void ScoreFuzzyWord(std::string_view word, DocumentPredicate& document_predicate, const Scorer& scorer, Accumulator accumulate, Hooks& hooks) const;
+
+    // Parses, scores and ranks the query; the sequential searches differ only in the hooks
+    template <typename DocumentPredicate, typename Scorer, typename Hooks>
+    std::vector<Document> FindTopDocumentsWithHooks(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer, Hooks& hooks) const;
+
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const Scorer& scorer) const;
+    template <typename DocumentPredicate, typename Scorer, typename Hooks>
+    std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const Scorer& scorer, Hooks& hooks) const;
+    template <typename DocumentPredicate, typename Scorer>
+    std::vector<Document> FindAllDocuments(const std::execution::parallel_policy& policy, const Query& query, DocumentPredicate document_predicate, const Scorer& scorer) const;
 };
 
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words))  // Extract non-empty stop words
+SearchServer::SearchServer(const StringContainer& stop_words, const AnalyzerOptions& analyzer_options)
+    : analyzer_(analyzer_options)
+    , stop_words_(AnalyzeStopWords(MakeUniqueNonEmptyStrings(stop_words)))  // Extract non-empty stop words
 {
     if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
         throw std::invalid_argument(std::string("Some of stop words are invalid"s));
@@ -148,110 +554,539 @@ template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& policy, 
     const std::string_view raw_query, DocumentPredicate document_predicate) const {
 
+    return FindTopDocuments(policy, raw_query, document_predicate, TfIdfScorer{});
+}
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& policy,
+    const std::string_view raw_query, DocumentPredicate document_predicate) const {
+
+    return FindTopDocuments(policy, raw_query, document_predicate, TfIdfScorer{});
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer) const {
+
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, scorer);
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::sequenced_policy& policy,
+    const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const {
+
+    NoSearchHooks hooks;
+    return FindTopDocumentsWithHooks(raw_query, document_predicate, scorer, hooks);
+}
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& policy,
+    const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const {
     const auto query = ParseQuery(raw_query, false);
 
-    auto matched_documents = FindAllDocuments(query, document_predicate);
+    auto matched_documents = FindAllDocuments(policy, query, document_predicate, scorer);
 
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
-            return lhs.rating > rhs.rating;
-        }
-        else {
-            return lhs.relevance > rhs.relevance;
-        }
-        });
+    SEARCH_TRACE_SCOPE(TOP_K);
+    sort(policy, matched_documents.begin(), matched_documents.end(), IsRankedHigher);
     if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
         matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
 
     return matched_documents;
 }
+
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindTopDocuments(const std::execution::parallel_policy& policy,
-    const std::string_view raw_query, DocumentPredicate document_predicate) const {
-    const auto query = ParseQuery(raw_query, false);
+std::vector<Document> SearchServer::FindTopDocumentsBoolean(const std::string_view raw_query,
+    DocumentPredicate document_predicate) const {
+
+    return FindTopDocumentsBoolean(raw_query, document_predicate, TfIdfScorer{});
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocumentsBoolean(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer) const {
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+    std::vector<TermCursor*> terms;
+    std::unique_ptr<QueryCursor> cursor;
+    {
+        SEARCH_TRACE_SCOPE(PARSE);
+        cursor = CompileBooleanQuery(ParseBooleanQuery(raw_query), terms, true);
+    }
+    std::vector<Document> matched_documents;
+    if (!cursor) {
+        return matched_documents;
+    }
 
-    sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        if (std::abs(lhs.relevance - rhs.relevance) < DELTA) {
-            return lhs.rating > rhs.rating;
+    {
+        SEARCH_TRACE_SCOPE(SCORING);
+        std::vector<TermStatistics> stats;
+        std::vector<double> term_weights;
+        for (const TermCursor* term : terms) {
+            stats.push_back(GetTermStatistics(term->GetPostings()));
+            term_weights.push_back(scorer.ComputeTermWeight(stats.back()));
         }
-        else {
-            return lhs.relevance > rhs.relevance;
+        for (int document_id = cursor->GetDocument(); document_id != QueryCursor::END;
+            cursor->SeekTo(document_id + 1), document_id = cursor->GetDocument()) {
+
+            const auto& document_data = documents_.at(document_id);
+            if (!document_predicate(document_id, document_data.status, document_data.rating)) {
+                continue;
+            }
+            double relevance = 0.0;
+            for (size_t i = 0; i < terms.size(); ++i) {
+                // Words of an OR branch that did not decide the match may lag behind
+                terms[i]->SeekTo(document_id);
+                if (terms[i]->GetDocument() == document_id) {
+                    relevance += scorer.ComputeScore(terms[i]->GetTermFreq(), document_data.length, term_weights[i], stats[i]);
+                }
+            }
+            matched_documents.push_back({ document_id, relevance, document_data.rating });
         }
-        });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
     }
 
+    SEARCH_TRACE_SCOPE(TOP_K);
+    const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(), IsRankedHigher);
+    matched_documents.resize(result_count);
     return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string{ word }) == 0) {
+template <typename DocumentPredicate, typename Scorer>
+SearchResult SearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer, const SearchLimits& limits) const {
+
+    LimitedSearchHooks hooks(limits);
+    SearchResult result;
+    // The search may have waited in a queue past its deadline
+    if (hooks.ShouldStop()) {
+        result.is_partial = true;
+        return result;
+    }
+    result.documents = FindTopDocumentsWithHooks(raw_query, document_predicate, scorer, hooks);
+    result.is_partial = hooks.IsStopped();
+    return result;
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer, QueryCost& cost) const {
+
+    const auto start = std::chrono::steady_clock::now();
+    QueryCostHooks hooks(cost);
+    auto result = FindTopDocumentsWithHooks(raw_query, document_predicate, scorer, hooks);
+    cost.total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer, SearchFacets& facets) const {
+
+    SearchFacetsHooks hooks(facets);
+    auto result = FindTopDocumentsWithHooks(raw_query, document_predicate, scorer, hooks);
+    hooks.CountFacets();
+    return result;
+}
+
+template <typename DocumentPredicate, typename Scorer, typename Hooks>
+std::vector<Document> SearchServer::FindTopDocumentsWithHooks(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer, Hooks& hooks) const {
+
+    Query query;
+    {
+        [[maybe_unused]] const auto phase_timer = hooks.MeasurePhase(TracePhase::PARSE);
+        query = ParseQuery(raw_query, false);
+    }
+    hooks.OnQueryParsed(query.plus_words.size() + query.minus_words.size()
+        + query.plus_patterns.size() + query.minus_patterns.size());
+
+    auto matched_documents = FindAllDocuments(query, document_predicate, scorer, hooks);
+
+    SEARCH_TRACE_SCOPE(TOP_K);
+    [[maybe_unused]] const auto phase_timer = hooks.MeasurePhase(TracePhase::TOP_K);
+    const size_t result_count = std::min(matched_documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(matched_documents.begin(), matched_documents.begin() + result_count, matched_documents.end(),
+        [&hooks](const Document& lhs, const Document& rhs) {
+            hooks.OnRankingComparison();
+            return IsRankedHigher(lhs, rhs);
+        });
+    matched_documents.resize(result_count);
+
+    return matched_documents;
+}
+
+template <typename Scorer>
+void SearchServer::BuildImpactIndex(const Scorer& scorer) {
+    std::map<std::string_view, ImpactIndex::ScoredPostings> term_scores;
+    for (const auto& [word, postings] : word_to_document_freqs_) {
+        if (postings.empty()) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(std::string{ word });
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string{ word })) {
-            const auto& document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        const TermStatistics stats = GetTermStatistics(postings);
+        const double term_weight = scorer.ComputeTermWeight(stats);
+        ImpactIndex::ScoredPostings& scores = term_scores[word];
+        scores.reserve(postings.size());
+        for (const auto [document_id, term_freq] : postings) {
+            scores.emplace_back(document_id, scorer.ComputeScore(term_freq, documents_.at(document_id).length, term_weight, stats));
+        }
+    }
+    impact_index_.emplace(term_scores);
+}
+
+template <typename DocumentPredicate>
+SearchResult SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query,
+    DocumentPredicate document_predicate, const SearchLimits& limits) const {
+
+    if (!impact_index_) {
+        throw std::logic_error("Impact index is not built"s);
+    }
+    const auto query = ParseQuery(raw_query, false);
+    if (!query.phrases.empty() || !query.plus_patterns.empty() || !query.minus_patterns.empty()) {
+        throw std::invalid_argument("Impact-ordered search supports plus and minus words only"s);
+    }
+
+    LimitedSearchHooks hooks(limits);
+    SearchResult result;
+    struct Accumulator {
+        uint64_t impact = 0;
+        int rating = 0;
+        bool is_accepted = false;
+    };
+    std::unordered_map<int, Accumulator> accumulators;
+    {
+        SEARCH_TRACE_SCOPE(SCORING);
+        std::vector<ImpactIndex::Segment> segments;
+        for (const std::string_view word : query.plus_words) {
+            const auto word_segments = impact_index_->GetSegments(word);
+            segments.insert(segments.end(), word_segments.begin(), word_segments.end());
+        }
+        std::stable_sort(segments.begin(), segments.end(), [](const ImpactIndex::Segment& lhs, const ImpactIndex::Segment& rhs) {
+            return lhs.impact > rhs.impact;
+            });
+
+        size_t postings_left_in_block = POSTING_BLOCK_SIZE;
+        for (const ImpactIndex::Segment& segment : segments) {
+            if (result.is_partial || (result.is_partial = hooks.ShouldStop())) {
+                break;
+            }
+            for (const int* it = segment.first; it != segment.last; ++it) {
+                if (--postings_left_in_block == 0) {
+                    postings_left_in_block = POSTING_BLOCK_SIZE;
+                    if ((result.is_partial = hooks.ShouldStop())) {
+                        break;
+                    }
+                }
+                hooks.OnPostingScanned();
+                const auto [accumulator, is_new] = accumulators.try_emplace(*it);
+                if (is_new) {
+                    const auto& document_data = documents_.at(*it);
+                    accumulator->second.rating = document_data.rating;
+                    accumulator->second.is_accepted = document_predicate(*it, document_data.status, document_data.rating);
+                }
+                accumulator->second.impact += segment.impact;
             }
         }
     }
 
+    SEARCH_TRACE_SCOPE(TOP_K);
+    // Checked per scored document, so the cost stays bounded by the budget
+    std::vector<const Postings*> minus_postings;
     for (const std::string_view word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string{ word }) == 0) {
-            continue;
+        const auto postings_it = word_to_document_freqs_.find(word);
+        if (postings_it != word_to_document_freqs_.end()) {
+            minus_postings.push_back(&postings_it->second);
+        }
+    }
+    for (const auto& [document_id, accumulator] : accumulators) {
+        if (accumulator.is_accepted && std::none_of(minus_postings.begin(), minus_postings.end(), [document_id = document_id](const Postings* postings) {
+            return postings->count(document_id) > 0;
+            })) {
+            result.documents.push_back({ document_id, impact_index_->GetScore(accumulator.impact), accumulator.rating });
+        }
+    }
+    const size_t result_count = std::min(result.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    std::partial_sort(result.documents.begin(), result.documents.begin() + result_count, result.documents.end(), IsRankedHigher);
+    result.documents.resize(result_count);
+    return result;
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::future<SearchResult> SearchServer::FindTopDocumentsAsync(ThreadPool& executor, std::string raw_query,
+    DocumentPredicate document_predicate, const Scorer& scorer, const SearchLimits& limits) const {
+
+    return executor.Submit([this, raw_query = std::move(raw_query), document_predicate, scorer, limits] {
+        return FindTopDocuments(raw_query, document_predicate, scorer, limits);
+        });
+}
+
+template <typename ExecutionPolicy, typename Function>
+void SearchServer::ForEachDocument(ExecutionPolicy&& policy, Function function) const {
+    // A few parts per thread even out parts slowed down by tombstones
+    const auto parts = PartitionDocuments(std::max(1u, std::thread::hardware_concurrency()) * 4);
+    std::for_each(policy, parts.begin(), parts.end(), [&function](const DocumentRange& part) {
+        for (const DocumentView document : part) {
+            function(document);
+        }
+        });
+}
+
+template <typename ExecutionPolicy>
+std::vector<std::vector<int>> SearchServer::FindNearDuplicates(ExecutionPolicy&& policy, double min_similarity) const {
+    const auto compute_similarity = [this](int lhs, int rhs) {
+        return GetWordSimilarity(lhs, rhs);
+    };
+    if (use_near_duplicates_) {
+        return near_duplicates_.GetClusters(min_similarity, compute_similarity);
+    }
+    const std::vector<int> document_ids(begin(), end());
+    std::vector<MinHashSignature> signatures(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), signatures.begin(), [this](int document_id) {
+        MinHashSignature signature;
+        for (const auto [word, _] : documents_.at(document_id).word_frequencies) {
+            signature.AddWord(word);
+        }
+        return signature;
+        });
+    NearDuplicateIndex index;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        index.Add(document_ids[i], signatures[i]);
+    }
+    return index.GetClusters(min_similarity, compute_similarity);
+}
+
+template <typename ExecutionPolicy, typename QueryContainer>
+std::vector<std::vector<Document>> SearchServer::RunQueryBatch(ExecutionPolicy&& policy,
+    const QueryContainer& raw_queries) const {
+
+    std::vector<Query> queries;
+    queries.reserve(raw_queries.size());
+    std::vector<bool> is_batched(raw_queries.size());
+    for (size_t i = 0; i < raw_queries.size(); ++i) {
+        const Query& query = queries.emplace_back(ParseQuery(raw_queries[i], false));
+        is_batched[i] = fuzzy_options_.max_edit_distance == 0 && query.phrases.empty()
+            && query.plus_patterns.empty() && query.minus_patterns.empty();
+    }
+
+    BatchDocuments documents;
+    documents.ids.reserve(documents_.size());
+    for (const DocumentView document : GetDocuments()) {
+        documents.ids.push_back(document.id);
+        documents.lengths.push_back(document.length);
+        documents.ratings.push_back(document.rating);
+        documents.is_actual.push_back(document.status == DocumentStatus::ACTUAL);
+    }
+
+    // An exception escaping a parallel algorithm would terminate the program
+    std::vector<std::vector<Document>> results(raw_queries.size());
+    std::vector<size_t> block_firsts;
+    for (size_t first = 0; first < raw_queries.size(); first += QUERY_BATCH_BLOCK) {
+        block_firsts.push_back(first);
+    }
+    std::vector<std::exception_ptr> errors(block_firsts.size());
+    std::for_each(policy, block_firsts.begin(), block_firsts.end(), [&](size_t first) {
+        try {
+            const size_t last = std::min(first + QUERY_BATCH_BLOCK, raw_queries.size());
+            FindTopDocumentsBatchBlock(queries, is_batched, first, last, documents, results);
+            for (size_t i = first; i < last; ++i) {
+                if (!is_batched[i]) {
+                    results[i] = FindTopDocuments(raw_queries[i]);
+                }
+            }
+        }
+        catch (...) {
+            errors[first / QUERY_BATCH_BLOCK] = std::current_exception();
+        }
+        });
+    for (const std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+    return results;
+}
+
+template <typename DocumentPredicate>
+ResultCursor SearchServer::OpenResultCursor(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return OpenResultCursor(raw_query, document_predicate, TfIdfScorer{});
+}
+
+template <typename DocumentPredicate, typename Scorer>
+ResultCursor SearchServer::OpenResultCursor(const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const {
+    const auto query = ParseQuery(raw_query, false);
+    auto matched_documents = FindAllDocuments(query, document_predicate, scorer);
+
+    SEARCH_TRACE_SCOPE(TOP_K);
+    return ResultCursor(std::move(matched_documents));
+}
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const Scorer& scorer) const {
+    NoSearchHooks hooks;
+    return FindAllDocuments(query, document_predicate, scorer, hooks);
+}
+
+template <typename DocumentPredicate, typename Scorer, typename Hooks>
+std::vector<Document> SearchServer::FindAllDocuments(const Query& query, DocumentPredicate document_predicate, const Scorer& scorer, Hooks& hooks) const {
+    std::map<int, double> document_to_relevance;
+    {
+        SEARCH_TRACE_SCOPE(SCORING);
+        [[maybe_unused]] const auto phase_timer = hooks.MeasurePhase(TracePhase::SCORING);
+        size_t postings_left_in_block = POSTING_BLOCK_SIZE;
+        bool is_stopped = false;
+        for (const std::string_view word : query.plus_words) {
+            if (is_stopped || (is_stopped = hooks.ShouldStop())) {
+                break;
+            }
+            if (fuzzy_options_.max_edit_distance > 0) {
+                ScoreFuzzyWord(word, document_predicate, scorer, [&document_to_relevance](int document_id, double relevance) {
+                    document_to_relevance[document_id] += relevance;
+                    }, hooks);
+            }
+            const auto postings_it = word_to_document_freqs_.find(word);
+            if (postings_it == word_to_document_freqs_.end() || postings_it->second.empty()) {
+                continue;
+            }
+            const TermStatistics stats = GetTermStatistics(postings_it->second);
+            const double term_weight = scorer.ComputeTermWeight(stats);
+            for (const auto [document_id, term_freq] : postings_it->second) {
+                if (--postings_left_in_block == 0) {
+                    postings_left_in_block = POSTING_BLOCK_SIZE;
+                    if ((is_stopped = hooks.ShouldStop())) {
+                        break;
+                    }
+                }
+                hooks.OnPostingScanned();
+                const auto& document_data = documents_.at(document_id);
+                if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                    document_to_relevance[document_id] += scorer.ComputeScore(term_freq, document_data.length, term_weight, stats);
+                }
+                else {
+                    hooks.OnPredicateRejected(document_id, document_data.status);
+                }
+            }
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(std::string{ word })) {
+        for (const std::string_view pattern : query.plus_patterns) {
+            if (is_stopped || (is_stopped = hooks.ShouldStop())) {
+                break;
+            }
+            ScorePattern(pattern, document_predicate, scorer, [&document_to_relevance](int document_id, double relevance) {
+                document_to_relevance[document_id] += relevance;
+                }, hooks);
+        }
+    }
+    const size_t scored_count = document_to_relevance.size();
+    hooks.OnDocumentsScored(scored_count);
+
+    {
+        SEARCH_TRACE_SCOPE(FILTERING);
+        [[maybe_unused]] const auto phase_timer = hooks.MeasurePhase(TracePhase::FILTERING);
+        // Null unless the hooks keep the matches the predicate rejected
+        std::map<int, DocumentStatus>* const rejected_documents = hooks.GetRejectedDocuments();
+        const auto exclude = [&document_to_relevance, rejected_documents](int document_id) {
             document_to_relevance.erase(document_id);
+            if (rejected_documents) {
+                rejected_documents->erase(document_id);
+            }
+        };
+        for (const std::string_view word : query.minus_words) {
+            if (word_to_document_freqs_.count(std::string{ word }) == 0) {
+                continue;
+            }
+            for (const auto [document_id, _] : word_to_document_freqs_.at(std::string{ word })) {
+                exclude(document_id);
+            }
+        }
+        for (const std::string_view pattern : query.minus_patterns) {
+            for (const auto term_id : ExpandPattern(pattern)) {
+                for (const auto [document_id, _] : *term_postings_[term_id]) {
+                    exclude(document_id);
+                }
+            }
+        }
+
+        if (!query.phrases.empty()) {
+            ApplyPhrases(query, document_to_relevance);
+            if (rejected_documents) {
+                for (auto it = rejected_documents->begin(); it != rejected_documents->end();) {
+                    it = MatchesPhrases(query, it->first) ? std::next(it) : rejected_documents->erase(it);
+                }
+            }
         }
     }
+    hooks.OnDocumentsExcluded(scored_count - document_to_relevance.size());
 
     std::vector<Document> matched_documents;
     for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+        const auto& document_data = documents_.at(document_id);
+        hooks.OnDocumentMatched(document_data.status, document_data.rating);
+        matched_documents.push_back({ document_id, relevance, document_data.rating });
     }
     return matched_documents;
 }
-template <typename DocumentPredicate>
+template <typename DocumentPredicate, typename Scorer>
 std::vector<Document> SearchServer::FindAllDocuments(const std::execution::parallel_policy& policy, 
-    const Query& query, DocumentPredicate document_predicate) const {
+    const Query& query, DocumentPredicate document_predicate, const Scorer& scorer) const {
 
-    ConcurrentMap<int, double> document_to_relevance_concurent(4);
-    
-    for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance_concurent, &document_predicate](const auto& word)
-        {
-            if (word_to_document_freqs_.count(word) == 0)
-            {
-                return;
-            }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second)
+    std::map<int, double> document_to_relevance;
+    {
+        SEARCH_TRACE_SCOPE(SCORING);
+        ConcurrentMap<int, double> document_to_relevance_concurent(4);
+
+        for_each(std::execution::par, query.plus_words.begin(), query.plus_words.end(), [this, &document_to_relevance_concurent, &document_predicate, &scorer](const auto& word)
             {
-                const auto& document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating))
+                if (fuzzy_options_.max_edit_distance > 0) {
+                    NoSearchHooks hooks;
+                    ScoreFuzzyWord(word, document_predicate, scorer, [&document_to_relevance_concurent](int document_id, double relevance) {
+                        document_to_relevance_concurent[document_id].ref_to_value += relevance;
+                        }, hooks);
+                }
+                const auto postings_it = word_to_document_freqs_.find(word);
+                if (postings_it == word_to_document_freqs_.end() || postings_it->second.empty())
                 {
-                    document_to_relevance_concurent[document_id].ref_to_value += term_freq * inverse_document_freq;
+                    return;
                 }
-            } });
-    std::map<int, double> document_to_relevance = document_to_relevance_concurent.BuildOrdinaryMap();
-    
-    for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](const auto word)
-        {
-            if (word_to_document_freqs_.count(word) == 0)
+                const TermStatistics stats = GetTermStatistics(postings_it->second);
+                const double term_weight = scorer.ComputeTermWeight(stats);
+                for (const auto [document_id, term_freq] : postings_it->second)
+                {
+                    const auto& document_data = documents_.at(document_id);
+                    if (document_predicate(document_id, document_data.status, document_data.rating))
+                    {
+                        document_to_relevance_concurent[document_id].ref_to_value += scorer.ComputeScore(term_freq, document_data.length, term_weight, stats);
+                    }
+                } });
+        for_each(std::execution::par, query.plus_patterns.begin(), query.plus_patterns.end(), [this, &document_to_relevance_concurent, &document_predicate, &scorer](const auto pattern)
             {
-                return;
-            }
-            for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second)
+                NoSearchHooks hooks;
+                ScorePattern(pattern, document_predicate, scorer, [&document_to_relevance_concurent](int document_id, double relevance) {
+                    document_to_relevance_concurent[document_id].ref_to_value += relevance;
+                    }, hooks);
+            });
+        document_to_relevance = document_to_relevance_concurent.BuildOrdinaryMap();
+    }
+
+    {
+        SEARCH_TRACE_SCOPE(FILTERING);
+        for_each(std::execution::par, query.minus_words.begin(), query.minus_words.end(), [this, &document_to_relevance](const auto word)
             {
-                document_to_relevance.erase(document_id);
-            } }); 
+                if (word_to_document_freqs_.count(word) == 0)
+                {
+                    return;
+                }
+                for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second)
+                {
+                    document_to_relevance.erase(document_id);
+                } }); 
+        for (const std::string_view pattern : query.minus_patterns) {
+            for (const auto term_id : ExpandPattern(pattern)) {
+                for (const auto [document_id, _] : *term_postings_[term_id]) {
+                    document_to_relevance.erase(document_id);
+                }
+            }
+        }
+
+        if (!query.phrases.empty()) {
+            ApplyPhrases(query, document_to_relevance);
+        }
+    }
 
     //std::map<int, double> document_to_relevance = document_to_relevance_concurent.BuildOrdinaryMap();
     std::vector<Document> matched_documents(document_to_relevance.size());
@@ -260,4 +1095,85 @@ std::vector<Document> SearchServer::FindAllDocuments(const std::execution::paral
         { matched_documents[idx++] = { entry.first, entry.second, documents_.at(entry.first).rating }; });
 
     return matched_documents;
-}
\ No newline at end of file
+}
+
+template <typename DocumentPredicate, typename Scorer, typename Accumulator, typename Hooks>
+void SearchServer::ScorePattern(std::string_view pattern, DocumentPredicate& document_predicate,
+    const Scorer& scorer, Accumulator accumulate, Hooks& hooks) const {
+
+    struct Cursor {
+        Postings::const_iterator it;
+        Postings::const_iterator end;
+        TermStatistics stats;
+        double term_weight;
+    };
+    std::vector<Cursor> cursors;
+    for (const auto term_id : ExpandPattern(pattern)) {
+        const auto& postings = *term_postings_[term_id];
+        const TermStatistics stats = GetTermStatistics(postings);
+        cursors.push_back({ postings.begin(), postings.end(), stats, scorer.ComputeTermWeight(stats) });
+    }
+
+    const auto greater_id = [&cursors](size_t lhs, size_t rhs) {
+        return (*cursors[lhs].it).first > (*cursors[rhs].it).first;
+    };
+    std::vector<size_t> heap(cursors.size());
+    std::iota(heap.begin(), heap.end(), 0);
+    std::make_heap(heap.begin(), heap.end(), greater_id);
+
+    int current_id = -1;
+    const DocumentData* current_data = nullptr;
+    bool is_accepted = false;
+    double relevance = 0.0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater_id);
+        Cursor& cursor = cursors[heap.back()];
+        const auto [document_id, term_freq] = *cursor.it;
+        hooks.OnPostingScanned();
+        if (document_id != current_id) {
+            if (is_accepted) {
+                accumulate(current_id, relevance);
+            }
+            current_id = document_id;
+            current_data = &documents_.at(document_id);
+            is_accepted = document_predicate(document_id, current_data->status, current_data->rating);
+            relevance = 0.0;
+        }
+        if (is_accepted) {
+            relevance += scorer.ComputeScore(term_freq, current_data->length, cursor.term_weight, cursor.stats);
+        }
+        else {
+            hooks.OnPredicateRejected(document_id, current_data->status);
+        }
+        if (++cursor.it != cursor.end) {
+            std::push_heap(heap.begin(), heap.end(), greater_id);
+        }
+        else {
+            heap.pop_back();
+        }
+    }
+    if (is_accepted) {
+        accumulate(current_id, relevance);
+    }
+}
+
+template <typename DocumentPredicate, typename Scorer, typename Accumulator, typename Hooks>
+void SearchServer::ScoreFuzzyWord(std::string_view word, DocumentPredicate& document_predicate,
+    const Scorer& scorer, Accumulator accumulate, Hooks& hooks) const {
+
+    for (const auto& [term_id, distance] : FindFuzzyCandidates(word)) {
+        const auto& postings = *term_postings_[term_id];
+        const TermStatistics stats = GetTermStatistics(postings);
+        const double term_weight = scorer.ComputeTermWeight(stats) * std::pow(fuzzy_options_.penalty, distance);
+        for (const auto [document_id, term_freq] : postings) {
+            hooks.OnPostingScanned();
+            const auto& document_data = documents_.at(document_id);
+            if (document_predicate(document_id, document_data.status, document_data.rating)) {
+                accumulate(document_id, scorer.ComputeScore(term_freq, document_data.length, term_weight, stats));
+            }
+            else {
+                hooks.OnPredicateRejected(document_id, document_data.status);
+            }
+        }
+    }
+}
@@ -0,0 +1,78 @@
+#include "slow_query_log.h"
+
+namespace {
+
+void PrintJsonString(std::ostream& out, std::string_view text) {
+    out << '"';
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            const char* digits = "0123456789abcdef";
+            out << "\\u00" << digits[c >> 4] << digits[c & 0xf];
+        }
+        else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+}  // namespace
+
+SlowQueryLog::SlowQueryLog(std::chrono::nanoseconds threshold, size_t capacity)
+    : threshold_(threshold)
+    , capacity_(capacity) {
+}
+
+bool SlowQueryLog::Record(std::string_view query, const QueryCost& cost) {
+    if (cost.total_ns < static_cast<uint64_t>(threshold_.count())) {
+        return false;
+    }
+    std::lock_guard guard(mutex_);
+    ++slow_query_count_;
+    if (capacity_ == 0) {
+        return true;
+    }
+    if (entries_.size() == capacity_) {
+        entries_.pop_front();
+    }
+    entries_.push_back({ std::string(query), cost });
+    return true;
+}
+
+std::vector<SlowQuery> SlowQueryLog::GetEntries() const {
+    std::lock_guard guard(mutex_);
+    return { entries_.begin(), entries_.end() };
+}
+
+uint64_t SlowQueryLog::GetSlowQueryCount() const {
+    std::lock_guard guard(mutex_);
+    return slow_query_count_;
+}
+
+void SlowQueryLog::Clear() {
+    std::lock_guard guard(mutex_);
+    entries_.clear();
+    slow_query_count_ = 0;
+}
+
+void SlowQueryLog::PrintJson(std::ostream& out) const {
+    for (const SlowQuery& entry : GetEntries()) {
+        const QueryCost& cost = entry.cost;
+        out << "{\"query\":";
+        PrintJsonString(out, entry.query);
+        out << ",\"total_ns\":" << cost.total_ns
+            << ",\"terms_parsed\":" << cost.terms_parsed
+            << ",\"postings_scanned\":" << cost.postings_scanned
+            << ",\"documents_scored\":" << cost.documents_scored
+            << ",\"predicate_rejections\":" << cost.predicate_rejections
+            << ",\"documents_excluded\":" << cost.documents_excluded
+            << ",\"top_k_comparisons\":" << cost.top_k_comparisons;
+        for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+            out << ",\"" << trace::GetPhaseName(static_cast<TracePhase>(phase)) << "_ns\":" << cost.phase_ns[phase];
+        }
+        out << "}\n";
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_hooks.h"
+
+struct SlowQuery {
+    std::string query;
+    QueryCost cost;
+};
+
+// The last capacity queries whose total time reached the threshold, oldest
+// first. Thread-safe; a query under the threshold does not take the lock.
+class SlowQueryLog {
+public:
+    SlowQueryLog(std::chrono::nanoseconds threshold, size_t capacity);
+
+    // Returns whether the query was slow enough to be logged
+    bool Record(std::string_view query, const QueryCost& cost);
+
+    std::vector<SlowQuery> GetEntries() const;
+    // Slow queries since the start or the last Clear, evicted ones included
+    uint64_t GetSlowQueryCount() const;
+    void Clear();
+
+    // One JSON object per line
+    void PrintJson(std::ostream& out) const;
+
+private:
+    const std::chrono::nanoseconds threshold_;
+    const size_t capacity_;
+    mutable std::mutex mutex_;
+    std::deque<SlowQuery> entries_;
+    uint64_t slow_query_count_ = 0;
+};
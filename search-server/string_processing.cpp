@@ -1,5 +1,9 @@
 #include "string_processing.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 std::string ReadLine() {
     std::string s;
     std::getline(std::cin, s);
@@ -36,13 +40,193 @@ std::vector<std::string> SplitIntoWords(const std::string& text) {
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text) {
     std::vector<std::string_view> result;
-    text.remove_prefix(std::min(text.find_first_not_of(" "), text.size())); //   
-    while (!text.empty()) {
-        size_t position_first_space = text.find(' ');
-        std::string_view tmp_substr = text.substr(0, position_first_space);
-        result.push_back(tmp_substr);
-        text.remove_prefix(tmp_substr.size());
-        text.remove_prefix(std::min(text.find_first_not_of(" "), text.size())); //   
+    for (const Token& token : WordTokenizer(text)) {
+        result.push_back(token.word);
+    }
+    return result;
+}
+
+size_t FindSpaceOrControl(std::string_view text) {
+    const char* const data = text.data();
+    size_t position = 0;
+#ifdef __SSE2__
+    // Bytes 0..32 are exactly those equal to their unsigned minimum with 32
+    const __m128i limit = _mm_set1_epi8(' ');
+    for (; position + 16 <= text.size(); position += 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(bytes, limit), bytes));
+        if (mask != 0) {
+            return position + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    for (; position < text.size(); ++position) {
+        if (static_cast<unsigned char>(data[position]) <= ' ') {
+            return position;
+        }
+    }
+    return text.size();
+}
+
+WordTokenizer::Iterator::Iterator(std::string_view text)
+    : rest_(text) {
+    Advance();
+}
+
+void WordTokenizer::Iterator::Advance() {
+    size_t start = 0;
+    while (start < rest_.size() && rest_[start] == ' ') {
+        ++start;
+    }
+    if (start == rest_.size()) {
+        *this = Iterator();
+        return;
+    }
+    rest_.remove_prefix(start);
+
+    bool has_control_chars = false;
+    size_t end = FindSpaceOrControl(rest_);
+    while (end < rest_.size() && rest_[end] != ' ') {
+        has_control_chars = true;
+        ++end;
+        end += FindSpaceOrControl(rest_.substr(end));
+    }
+    token_ = { rest_.substr(0, end), has_control_chars };
+    rest_.remove_prefix(end);
+}
+
+void HashedWordSet::Build() {
+    size_t capacity = 1;
+    while (capacity < words_.size() * 2) {
+        capacity *= 2;
+    }
+    slots_.assign(words_.empty() ? 0 : capacity, EMPTY_SLOT);
+    length_mask_ = 0;
+    for (uint32_t i = 0; i < words_.size(); ++i) {
+        length_mask_ |= GetLengthBit(words_[i].size());
+        size_t slot = std::hash<std::string_view>{}(words_[i]) & (slots_.size() - 1);
+        while (slots_[slot] != EMPTY_SLOT) {
+            slot = (slot + 1) & (slots_.size() - 1);
+        }
+        slots_[slot] = i;
+    }
+}
+
+bool HashedWordSet::Contains(std::string_view word) const {
+    if ((length_mask_ & GetLengthBit(word.size())) == 0) {
+        return false;
+    }
+    size_t slot = std::hash<std::string_view>{}(word) & (slots_.size() - 1);
+    while (slots_[slot] != EMPTY_SLOT) {
+        if (words_[slots_[slot]] == word) {
+            return true;
+        }
+        slot = (slot + 1) & (slots_.size() - 1);
+    }
+    return false;
+}
+
+namespace {
+
+uint32_t FoldCodePoint(uint32_t code_point) {
+    if ((code_point >= 0xC0 && code_point <= 0xDE && code_point != 0xD7)  // Latin-1
+        || (code_point >= 0x391 && code_point <= 0x3A9 && code_point != 0x3A2)  // Greek
+        || (code_point >= 0x410 && code_point <= 0x42F)) {  // Cyrillic
+        return code_point + 0x20;
+    }
+    if (code_point >= 0x400 && code_point <= 0x40F) {  // Cyrillic with diacritics
+        return code_point + 0x50;
+    }
+    return code_point;
+}
+
+// All folded letters keep their UTF-8 length, so folding works in place
+void FoldCase(std::string& word) {
+    for (size_t i = 0; i < word.size(); ++i) {
+        const unsigned char c = word[i];
+        if (c >= 'A' && c <= 'Z') {
+            word[i] = static_cast<char>(c + ('a' - 'A'));
+        }
+        else if ((c & 0xE0) == 0xC0 && i + 1 < word.size() && (static_cast<unsigned char>(word[i + 1]) & 0xC0) == 0x80) {
+            const uint32_t code_point = ((c & 0x1Fu) << 6) | (static_cast<unsigned char>(word[i + 1]) & 0x3Fu);
+            const uint32_t folded = FoldCodePoint(code_point);
+            word[i] = static_cast<char>(0xC0 | (folded >> 6));
+            word[i + 1] = static_cast<char>(0x80 | (folded & 0x3F));
+            ++i;
+        }
+    }
+}
+
+bool MayNeedCaseFolding(std::string_view word) {
+    return std::any_of(word.begin(), word.end(), [](char c) {
+        return (c >= 'A' && c <= 'Z') || static_cast<unsigned char>(c) >= 0x80;
+        });
+}
+
+bool EndsWith(std::string_view word, std::string_view suffix) {
+    return word.size() >= suffix.size() && word.substr(word.size() - suffix.size()) == suffix;
+}
+
+// The S-stemmer (Harman, 1991): how many bytes of the word to keep and what
+// to append to them
+std::pair<size_t, std::string_view> GetStemEdit(std::string_view word) {
+    using namespace std::string_view_literals;
+    if (word.size() <= 3) {
+        return { word.size(), {} };
+    }
+    if (EndsWith(word, "ies"sv) && !EndsWith(word, "eies"sv) && !EndsWith(word, "aies"sv)) {
+        return { word.size() - 3, "y"sv };
+    }
+    if (EndsWith(word, "es"sv) && !EndsWith(word, "aes"sv) && !EndsWith(word, "ees"sv) && !EndsWith(word, "oes"sv)) {
+        return { word.size() - 1, {} };
+    }
+    if (EndsWith(word, "s"sv) && !EndsWith(word, "us"sv) && !EndsWith(word, "ss"sv)) {
+        return { word.size() - 1, {} };
+    }
+    return { word.size(), {} };
+}
+
+}  // namespace
+
+std::string_view TextAnalyzer::Normalize(std::string_view word, std::string& buffer, bool allow_stemming) const {
+    std::string_view result = word;
+    if (options_.fold_case && MayNeedCaseFolding(word)) {
+        buffer.assign(word);
+        FoldCase(buffer);
+        result = buffer;
+    }
+    if (options_.stem && allow_stemming) {
+        const auto [keep, suffix] = GetStemEdit(result);
+        if (keep != result.size() || !suffix.empty()) {
+            if (result.data() != buffer.data()) {
+                buffer.assign(result);
+            }
+            buffer.resize(keep);
+            buffer.append(suffix);
+            result = buffer;
+        }
     }
     return result;
-} 
\ No newline at end of file
+}
+
+size_t TextAnalyzer::GetUnicodeSpaceLength(std::string_view text) {
+    const auto byte = [&text](size_t i) {
+        return i < text.size() ? static_cast<unsigned char>(text[i]) : 0u;
+    };
+    switch (byte(0)) {
+    case 0xC2:  // U+0085, U+00A0
+        return byte(1) == 0x85 || byte(1) == 0xA0 ? 2 : 0;
+    case 0xE1:  // U+1680
+        return byte(1) == 0x9A && byte(2) == 0x80 ? 3 : 0;
+    case 0xE2:  // U+2000-U+200B, U+2028, U+2029, U+202F, U+205F
+        if (byte(1) == 0x80) {
+            const unsigned c = byte(2);
+            return (c >= 0x80 && c <= 0x8B) || c == 0xA8 || c == 0xA9 || c == 0xAF ? 3 : 0;
+        }
+        return byte(1) == 0x81 && byte(2) == 0x9F ? 3 : 0;
+    case 0xE3:  // U+3000
+        return byte(1) == 0x80 && byte(2) == 0x80 ? 3 : 0;
+    default:
+        return 0;
+    }
+}
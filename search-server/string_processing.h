@@ -10,6 +10,9 @@
 #include <utility>
 #include <vector>
 #include <deque>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
 
 std::string ReadLine();
 
@@ -18,6 +21,181 @@ int ReadLineWithNumber();
 //std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWords(const std::string_view text);
 
+struct Token {
+    std::string_view word;
+    // Control characters (codes 0-31) make a word invalid
+    bool has_control_chars = false;
+};
+
+// Lazily splits a text by spaces without building a vector of words. Word
+// ends and control characters are found in the same pass, 16 bytes at a time
+// with SSE2 where available.
+class WordTokenizer {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Token;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Token*;
+        using reference = const Token&;
+
+        Iterator() = default;
+
+        const Token& operator*() const {
+            return token_;
+        }
+        const Token* operator->() const {
+            return &token_;
+        }
+        Iterator& operator++() {
+            Advance();
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return rest_.data() == other.rest_.data() && token_.word.data() == other.token_.word.data();
+        }
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class WordTokenizer;
+        explicit Iterator(std::string_view text);
+
+        std::string_view rest_;
+        Token token_;
+
+        void Advance();
+    };
+
+    explicit WordTokenizer(std::string_view text)
+        : text_(text) {
+    }
+
+    Iterator begin() const {
+        return Iterator(text_);
+    }
+    Iterator end() const {
+        return Iterator();
+    }
+
+private:
+    std::string_view text_;
+};
+
+// Position of the first byte in text that is a space or a control character,
+// text.size() if there is none
+size_t FindSpaceOrControl(std::string_view text);
+
+struct AnalyzerOptions {
+    // Lower-case ASCII, Latin-1, Greek and Cyrillic letters
+    bool fold_case = false;
+    // Also split words on Unicode space characters (no-break space, U+2000-U+200B, ...)
+    bool split_unicode_spaces = false;
+    // Strip English plural endings ("cats" -> "cat", "queries" -> "query")
+    bool stem = false;
+};
+
+// Turns space-separated tokens into index terms. The same analyzer is applied
+// to documents, stop words and queries, so that "Cats" in a query finds "cat".
+// Nothing is allocated: unchanged words are returned as they are, changed ones
+// are written into a buffer supplied by the caller.
+class TextAnalyzer {
+public:
+    TextAnalyzer() = default;
+    explicit TextAnalyzer(const AnalyzerOptions& options)
+        : options_(options) {
+    }
+
+    const AnalyzerOptions& GetOptions() const {
+        return options_;
+    }
+
+    // Calls callback(part) for the parts of the token between Unicode spaces
+    template <typename Callback>
+    void ForEachPart(std::string_view token, Callback callback) const;
+
+    // The result is either word itself or a view of buffer, valid until the buffer changes.
+    // Prefix patterns are only case folded, a stemmed prefix would miss words.
+    std::string_view Normalize(std::string_view word, std::string& buffer, bool allow_stemming = true) const;
+
+    // Length in bytes of the Unicode space character at the start of text, 0 if there is none
+    static size_t GetUnicodeSpaceLength(std::string_view text);
+
+private:
+    AnalyzerOptions options_;
+};
+
+template <typename Callback>
+void TextAnalyzer::ForEachPart(std::string_view token, Callback callback) const {
+    if (!options_.split_unicode_spaces) {
+        callback(token);
+        return;
+    }
+    size_t start = 0;
+    for (size_t i = 0; i < token.size();) {
+        const size_t space_length = static_cast<unsigned char>(token[i]) < 0x80 ? 0 : GetUnicodeSpaceLength(token.substr(i));
+        if (space_length == 0) {
+            ++i;
+            continue;
+        }
+        if (i > start) {
+            callback(token.substr(start, i - start));
+        }
+        i += space_length;
+        start = i;
+    }
+    if (start < token.size()) {
+        callback(token.substr(start));
+    }
+}
+
+// Immutable set of words for the membership tests on the indexing path:
+// an open-addressing hash table with a per-length filter that rejects most
+// words before hashing them
+class HashedWordSet {
+public:
+    HashedWordSet() = default;
+
+    template <typename StringContainer>
+    explicit HashedWordSet(const StringContainer& words);
+
+    bool Contains(std::string_view word) const;
+
+    size_t size() const {
+        return words_.size();
+    }
+    std::vector<std::string>::const_iterator begin() const {
+        return words_.begin();
+    }
+    std::vector<std::string>::const_iterator end() const {
+        return words_.end();
+    }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    std::vector<std::string> words_;
+    std::vector<uint32_t> slots_;  // indexes into words_, size is a power of two
+    uint64_t length_mask_ = 0;     // bit min(length, 63) is set for stored lengths
+
+    void Build();
+    static uint64_t GetLengthBit(size_t length) {
+        return uint64_t{ 1 } << std::min<size_t>(length, 63);
+    }
+};
+
+template <typename StringContainer>
+HashedWordSet::HashedWordSet(const StringContainer& words) {
+    for (const auto& word : words) {
+        words_.emplace_back(word);
+    }
+    std::sort(words_.begin(), words_.end());
+    words_.erase(std::unique(words_.begin(), words_.end()), words_.end());
+    Build();
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,239 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "varint.h"
+
+namespace {
+const size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+}
+
+void TermDictionary::Insert(std::string_view term, TermId id) {
+    pending_.emplace(term, id);
+    if (pending_.size() >= std::max(MIN_PENDING_TO_MERGE, ids_.size() / 8)) {
+        Merge();
+    }
+}
+
+size_t TermDictionary::size() const {
+    return ids_.size() + pending_.size();
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    return sizeof(*this)
+        + data_.capacity()
+        + block_offsets_.capacity() * sizeof(uint32_t)
+        + block_keys_.capacity() * sizeof(uint64_t)
+        + ids_.capacity() * sizeof(TermId)
+        + pending_.size() * (MAP_NODE_OVERHEAD + sizeof(std::pair<const std::string_view, TermId>));
+}
+
+TermDictionary::Iterator TermDictionary::Begin() const {
+    return Iterator(*this);
+}
+
+bool TermDictionary::IsPattern(std::string_view word) {
+    return word.find_first_of("*?") != std::string_view::npos;
+}
+
+bool TermDictionary::MatchesPattern(std::string_view pattern, std::string_view term) {
+    size_t p = 0, t = 0;
+    size_t star = std::string_view::npos, star_t = 0;
+    while (t < term.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == term[t])) {
+            ++p;
+            ++t;
+        }
+        else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            star_t = t;
+        }
+        else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++star_t;
+        }
+        else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+void TermDictionary::Merge() {
+    std::vector<std::pair<std::string, TermId>> terms;
+    terms.reserve(size());
+    for (Iterator it = Begin(); it.IsValid(); it.Next()) {
+        terms.emplace_back(std::string{ it.GetTerm() }, it.GetId());
+    }
+
+    data_.clear();
+    block_offsets_.clear();
+    block_keys_.clear();
+    ids_.clear();
+    pending_.clear();
+
+    std::string_view previous;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        const std::string_view term = terms[i].first;
+        if (i % BLOCK_SIZE == 0) {
+            block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+            block_keys_.push_back(ComputeKey(term));
+            WriteVarint(data_, term.size());
+            data_.insert(data_.end(), term.begin(), term.end());
+        }
+        else {
+            const size_t max_shared = std::min(previous.size(), term.size());
+            const size_t shared = std::mismatch(term.begin(), term.begin() + max_shared, previous.begin()).first - term.begin();
+            WriteVarint(data_, shared);
+            WriteVarint(data_, term.size() - shared);
+            data_.insert(data_.end(), term.begin() + shared, term.end());
+        }
+        ids_.push_back(terms[i].second);
+        previous = term;
+    }
+    data_.shrink_to_fit();
+    block_offsets_.shrink_to_fit();
+    block_keys_.shrink_to_fit();
+    ids_.shrink_to_fit();
+}
+
+std::string_view TermDictionary::GetBlockHead(size_t block) const {
+    size_t offset = block_offsets_[block];
+    const size_t length = ReadVarint(data_.data(), offset);
+    return { reinterpret_cast<const char*>(data_.data() + offset), length };
+}
+
+bool TermDictionary::IsBlockHeadGreater(size_t block, std::string_view target, uint64_t target_key) const {
+    if (block_keys_[block] != target_key) {
+        return block_keys_[block] > target_key;
+    }
+    return GetBlockHead(block) > target;
+}
+
+// Big-endian first 8 bytes, so integer order matches string order up to ties
+uint64_t TermDictionary::ComputeKey(std::string_view term) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < sizeof(key); ++i) {
+        key = (key << 8) | (i < term.size() ? static_cast<unsigned char>(term[i]) : 0);
+    }
+    return key;
+}
+
+TermDictionary::Iterator::Iterator(const TermDictionary& dictionary)
+    : dictionary_(&dictionary)
+    , pending_it_(dictionary.pending_.begin()) {
+    if (IsArrayValid()) {
+        DecodeArrayTerm();
+    }
+    UpdateCurrent();
+}
+
+bool TermDictionary::Iterator::IsValid() const {
+    return IsArrayValid() || pending_it_ != dictionary_->pending_.end();
+}
+
+bool TermDictionary::Iterator::IsArrayValid() const {
+    return index_ < dictionary_->ids_.size();
+}
+
+void TermDictionary::Iterator::UpdateCurrent() {
+    is_array_current_ = IsArrayValid() && (pending_it_ == dictionary_->pending_.end() || term_ < pending_it_->first);
+}
+
+std::string_view TermDictionary::Iterator::GetTerm() const {
+    return is_array_current_ ? std::string_view{ term_ } : pending_it_->first;
+}
+
+TermDictionary::TermId TermDictionary::Iterator::GetId() const {
+    return is_array_current_ ? dictionary_->ids_[index_] : pending_it_->second;
+}
+
+void TermDictionary::Iterator::Next() {
+    if (is_array_current_) {
+        if (++index_ < dictionary_->ids_.size()) {
+            DecodeArrayTerm();
+        }
+    }
+    else {
+        ++pending_it_;
+    }
+    UpdateCurrent();
+}
+
+void TermDictionary::Iterator::Seek(std::string_view target) {
+    const auto& pending = dictionary_->pending_;
+    // pending_it_ is the first fresh term not less than the current one,
+    // so a short forward seek is cheaper by stepping than by a tree search
+    bool is_found = false;
+    if (IsValid() && GetTerm() < target) {
+        for (int step = 0; step < 8 && pending_it_ != pending.end() && pending_it_->first < target; ++step) {
+            ++pending_it_;
+        }
+        is_found = pending_it_ == pending.end() || pending_it_->first >= target;
+    }
+    SeekArray(target);
+    if (!is_found) {
+        pending_it_ = pending.lower_bound(target);
+    }
+    UpdateCurrent();
+}
+
+void TermDictionary::Iterator::DecodeArrayTerm() {
+    // Locals keep the compiler from reloading members after every byte write
+    const uint8_t* data = dictionary_->data_.data();
+    size_t offset = offset_;
+    size_t shared = 0;
+    if (index_ % BLOCK_SIZE == 0) {
+        offset = dictionary_->block_offsets_[index_ / BLOCK_SIZE];
+    }
+    else {
+        shared = ReadVarint(data, offset);
+    }
+    const size_t suffix_length = ReadVarint(data, offset);
+    term_.resize(shared + suffix_length);
+    std::copy_n(data + offset, suffix_length, term_.begin() + shared);
+    offset_ = offset + suffix_length;
+}
+
+void TermDictionary::Iterator::SeekArray(std::string_view target) {
+    const auto& blocks = dictionary_->block_offsets_;
+    if (blocks.empty()) {
+        return;
+    }
+    const uint64_t target_key = ComputeKey(target);
+    // Seeks mostly move a little forward, so gallop from the current block
+    // instead of searching the whole array
+    const bool is_forward = IsArrayValid() && term_ < target;
+    size_t left = is_forward ? index_ / BLOCK_SIZE : 0;
+    size_t right = blocks.size();
+    if (is_forward) {
+        for (size_t step = 1; left + step < blocks.size(); step *= 2) {
+            if (dictionary_->IsBlockHeadGreater(left + step, target, target_key)) {
+                right = left + step;
+                break;
+            }
+            left += step;
+        }
+    }
+    // Last block whose head is not greater than target
+    while (right - left > 1) {
+        const size_t middle = (left + right) / 2;
+        if (dictionary_->IsBlockHeadGreater(middle, target, target_key)) {
+            right = middle;
+        }
+        else {
+            left = middle;
+        }
+    }
+    if (!is_forward || left != index_ / BLOCK_SIZE) {
+        index_ = left * BLOCK_SIZE;
+        DecodeArrayTerm();
+    }
+    while (term_ < target && ++index_ < dictionary_->ids_.size()) {
+        DecodeArrayTerm();
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Sorted term -> id dictionary for prefix and wildcard expansion.
+//
+// Most terms live in a front-coded array: blocks of BLOCK_SIZE terms, where the
+// first term of a block is stored in full and the others as
+// (shared prefix length, suffix). Fresh terms go to a small ordered buffer
+// which is merged into the array once it grows, so Insert stays cheap.
+class TermDictionary {
+public:
+    using TermId = uint32_t;
+
+    // The term must outlive the dictionary
+    void Insert(std::string_view term, TermId id);
+
+    size_t size() const;
+    size_t GetMemoryUsage() const;
+
+    // Visits terms in lexicographic order
+    class Iterator {
+    public:
+        bool IsValid() const;
+        std::string_view GetTerm() const;
+        TermId GetId() const;
+        void Next();
+        // Moves to the first term not less than target
+        void Seek(std::string_view target);
+
+    private:
+        friend class TermDictionary;
+        explicit Iterator(const TermDictionary& dictionary);
+
+        const TermDictionary* dictionary_;
+
+        // Position in the front-coded array
+        size_t index_ = 0;
+        size_t offset_ = 0;
+        std::string term_;
+
+        std::map<std::string_view, TermId>::const_iterator pending_it_;
+        bool is_array_current_ = false;
+
+        bool IsArrayValid() const;
+        void UpdateCurrent();
+        void DecodeArrayTerm();
+        void SeekArray(std::string_view target);
+    };
+
+    Iterator Begin() const;
+
+    // Calls callback(term, id) for terms matching the pattern in lexicographic order
+    // while it returns true. '*' matches any sequence of characters, '?' any single one.
+    template <typename Callback>
+    void ForEachMatch(std::string_view pattern, Callback callback) const;
+
+    static bool IsPattern(std::string_view word);
+    static bool MatchesPattern(std::string_view pattern, std::string_view term);
+
+private:
+    static constexpr size_t BLOCK_SIZE = 16;
+    static constexpr size_t MIN_PENDING_TO_MERGE = 1024;
+
+    std::vector<uint8_t> data_;
+    std::vector<uint32_t> block_offsets_;
+    // First bytes of every block head, so that searching for a block
+    // mostly compares integers instead of decoding heads from data_
+    std::vector<uint64_t> block_keys_;
+    std::vector<TermId> ids_;  // in term order
+
+    std::map<std::string_view, TermId> pending_;
+
+    void Merge();
+    std::string_view GetBlockHead(size_t block) const;
+    bool IsBlockHeadGreater(size_t block, std::string_view target, uint64_t target_key) const;
+    static uint64_t ComputeKey(std::string_view term);
+};
+
+template <typename Callback>
+void TermDictionary::ForEachMatch(std::string_view pattern, Callback callback) const {
+    const std::string_view prefix = pattern.substr(0, pattern.find_first_of("*?"));
+    Iterator it = Begin();
+    for (it.Seek(prefix); it.IsValid(); it.Next()) {
+        const std::string_view term = it.GetTerm();
+        if (term.substr(0, prefix.size()) != prefix) {
+            break;
+        }
+        if (MatchesPattern(pattern, term) && !callback(term, it.GetId())) {
+            break;
+        }
+    }
+}
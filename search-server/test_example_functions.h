@@ -10,6 +10,17 @@
 #include <utility>
 #include <vector>
 #include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "log_duration.h"
 #include "string_processing.h"
@@ -17,10 +28,14 @@
 #include "search_server.h"
 #include "paginator.h"
 #include "request_queue.h"
+#include "process_queries.h"
+#include "document_reordering.h"
+#include "durable_index.h"
+#include "query_server.h"
+#include "remove_duplicates.h"
 
 // -------    ----------
 using namespace std::string_literals;
-const double DELTA = 1e-5;
 
 template <typename T>
 void RunTestImpl(T t, const std::string& s) {
@@ -263,6 +278,1524 @@ void TestDocuments() {
     ASSERT(a2.size() == 0);
 }
 
+void TestPhraseQueries() {
+    SearchServer server("in the"s);
+    server.EnablePositionalIndex();
+    server.AddDocument(1, "cat in the big city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "big cat and city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "city cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 1 });
+
+    const auto found_docs = server.FindTopDocuments("\"big city\""s);
+    ASSERT_EQUAL(found_docs.size(), 1u);
+    ASSERT_EQUAL(found_docs[0].id, 1);
+
+    // Stop words are skipped both in documents and in phrases
+    ASSERT_EQUAL(server.FindTopDocuments("\"cat in the big\""s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "\"big city\" -cat"s).size(), 0u);
+
+    const auto [words, status] = server.MatchDocument("\"cat city\""s, 3);
+    ASSERT(words.empty());
+
+    // Proximity does not filter, it only boosts close words
+    const auto near_docs = server.FindTopDocuments("\"cat city\"~1"s);
+    ASSERT_EQUAL(near_docs.size(), 3u);
+    ASSERT_EQUAL(near_docs[0].id, 3);
+
+    ASSERT(server.GetPositionalIndexMemoryUsage() > 0);
+    server.RemoveDocument(1);
+    ASSERT(server.FindTopDocuments("\"big city\""s).empty());
+
+    SearchServer plain(""s);
+    plain.AddDocument(1, "big city"s, DocumentStatus::ACTUAL, { 1 });
+    try {
+        plain.FindTopDocuments("\"big city\""s);
+        ASSERT_HINT(false, "phrase query without positional index must throw"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestScorers() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat city"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat cat dog dog dog dog dog dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "bird"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(std::abs(server.GetAverageDocumentLength() - 11.0 / 3) < DELTA);
+
+    const auto all = [](int, DocumentStatus, int) { return true; };
+    const auto tf_idf = server.FindTopDocuments("cat"s, all, TfIdfScorer{});
+    const auto by_default = server.FindTopDocuments("cat"s, all);
+    ASSERT_EQUAL(tf_idf.size(), by_default.size());
+    for (size_t i = 0; i < tf_idf.size(); ++i) {
+        ASSERT_EQUAL(tf_idf[i].id, by_default[i].id);
+        ASSERT(std::abs(tf_idf[i].relevance - by_default[i].relevance) < DELTA);
+    }
+
+    // BM25 saturates term frequency: two "cat"s in a long document
+    // do not outweigh one "cat" in a short one
+    const auto bm25 = server.FindTopDocuments(std::execution::par, "cat"s, all, Bm25Scorer{});
+    ASSERT_EQUAL(bm25.size(), 2u);
+    ASSERT_EQUAL(bm25[0].id, 1);
+    const double idf = std::log(1.0 + (3 - 2 + 0.5) / (2 + 0.5));
+    const double length_norm = 1.0 - 0.75 + 0.75 * 2 / (11.0 / 3);
+    ASSERT(std::abs(bm25[0].relevance - idf * 2.2 / (1.0 + 1.2 * length_norm)) < DELTA);
+
+    server.RemoveDocument(2);
+    ASSERT(std::abs(server.GetAverageDocumentLength() - 1.5) < DELTA);
+}
+
+void TestTermDictionary() {
+    std::vector<std::string> terms;
+    for (int i = 0; i < 3000; ++i) {
+        terms.push_back("w"s + std::to_string(i * 7 % 3000));
+    }
+    TermDictionary dictionary;
+    for (size_t i = 0; i < terms.size(); ++i) {
+        dictionary.Insert(terms[i], static_cast<TermDictionary::TermId>(i));
+    }
+    ASSERT_EQUAL(dictionary.size(), terms.size());
+
+    std::vector<std::string> sorted_terms;
+    for (auto it = dictionary.Begin(); it.IsValid(); it.Next()) {
+        ASSERT_EQUAL(terms[it.GetId()], std::string{ it.GetTerm() });
+        sorted_terms.push_back(std::string{ it.GetTerm() });
+    }
+    ASSERT(std::is_sorted(sorted_terms.begin(), sorted_terms.end()));
+    ASSERT_EQUAL(sorted_terms.size(), terms.size());
+
+    std::vector<std::string_view> matches;
+    dictionary.ForEachMatch("w29?9"s, [&matches](std::string_view term, TermDictionary::TermId) {
+        matches.push_back(term);
+        return true;
+        });
+    ASSERT_EQUAL(matches.size(), 10u);
+    ASSERT_EQUAL(matches[0], "w2909"s);
+
+    size_t visited = 0;
+    dictionary.ForEachMatch("w1*"s, [&visited](std::string_view, TermDictionary::TermId) {
+        return ++visited < 5;
+        });
+    ASSERT_EQUAL(visited, 5u);
+
+    ASSERT(TermDictionary::MatchesPattern("c*t"s, "cat"s));
+    ASSERT(TermDictionary::MatchesPattern("c*"s, "c"s));
+    ASSERT(!TermDictionary::MatchesPattern("c?t"s, "cart"s));
+}
+
+void TestPrefixQueries() {
+    SearchServer server(""s);
+    server.SetWildcardMatching(true);
+    server.AddDocument(1, "search server"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "searching cats"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "seals"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "dogs"s, DocumentStatus::ACTUAL, { 4 });
+
+    ASSERT_EQUAL(server.FindTopDocuments("searc*"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "se*s"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("sea* -cat?"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("searc* -cat?"s)[0].id, 1);
+
+    const auto [words, status] = server.MatchDocument("searc* dogs"s, 2);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "searching"s);
+
+    server.SetMaxTermExpansions(1);
+    ASSERT_EQUAL(server.FindTopDocuments("sea*"s).size(), 1u);
+
+    try {
+        server.FindTopDocuments("*cat"s);
+        ASSERT_HINT(false, "leading wildcard must throw"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestWildcardCharactersInDocuments() {
+    SearchServer server(""s);
+    server.AddDocument(1, "what? c*t"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "whats cart"s, DocumentStatus::ACTUAL, { 2 });
+
+    // Wildcards are off by default: '*' and '?' are plain characters
+    ASSERT_EQUAL(server.FindTopDocuments("what?"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("c*t"s)[0].id, 1);
+    ASSERT_EQUAL(server.FindTopDocuments("c*t"s).size(), 1u);
+    ASSERT(server.FindTopDocuments("?"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("ca*"s).size(), 0u);
+    const auto [words, status] = server.MatchDocument("what? whats"s, 1);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "what?"s);
+
+    // Turned on, such words still match themselves, but as patterns they
+    // match other words too, and a leading wildcard is rejected
+    server.SetWildcardMatching(true);
+    ASSERT_EQUAL(server.FindTopDocuments("what?"s).size(), 2u);
+    ASSERT_EQUAL(server.FindTopDocuments("c*t"s).size(), 2u);
+    try {
+        server.FindTopDocuments("?"s);
+        ASSERT_HINT(false, "leading wildcard must throw"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestFuzzyMatching() {
+    FuzzyIndex index;
+    const std::vector<std::string> terms = { "cat"s, "cart"s, "cast"s, "dog"s, "search"s, "seaside"s, "starch"s, "aab"s };
+    for (size_t i = 0; i < terms.size(); ++i) {
+        index.Insert(terms[i], static_cast<FuzzyIndex::TermId>(i));
+    }
+    std::map<std::string, int> close_terms;
+    index.ForEachWithinOneEdit("cst"s, 0, [&close_terms](std::string_view term, FuzzyIndex::TermId, int distance) {
+        close_terms[std::string{ term }] = distance;
+        return true;
+        });
+    ASSERT_EQUAL(close_terms.size(), 2u);
+    ASSERT_EQUAL(close_terms.at("cat"s), 1);
+    ASSERT_EQUAL(close_terms.at("cast"s), 1);
+
+    size_t with_exact_prefix = 0;
+    index.ForEachWithinOneEdit("dat"s, 1, [&with_exact_prefix](std::string_view, FuzzyIndex::TermId, int) {
+        ++with_exact_prefix;
+        return true;
+        });
+    ASSERT_EQUAL(with_exact_prefix, 0u);
+
+    // Transposed letters are one edit, the word itself is reported too, and
+    // the callback stops the lookup
+    std::vector<std::string> found_terms;
+    index.ForEachWithinOneEdit("cta"s, 0, [&found_terms](std::string_view term, FuzzyIndex::TermId, int) {
+        found_terms.push_back(std::string{ term });
+        return true;
+        });
+    ASSERT((found_terms == std::vector<std::string>{ "cat"s }));
+    ASSERT_EQUAL(FuzzyIndex::ComputeDistanceUpToOne("aab"s, "ab"s), 1);
+    ASSERT_EQUAL(FuzzyIndex::ComputeDistanceUpToOne("search"s, "seaside"s), 2);
+    size_t calls = 0;
+    index.ForEachWithinOneEdit("cast"s, 0, [&calls](std::string_view term, FuzzyIndex::TermId, int distance) {
+        ASSERT_EQUAL(term, "cart"s);
+        ASSERT_EQUAL(distance, 1);
+        ++calls;
+        return false;
+        });
+    ASSERT_EQUAL(calls, 1u);
+
+    SearchServer server(""s);
+    server.AddDocument(1, "search engine"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "seaside town"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "engine room"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(server.FindTopDocuments("serach"s).empty());
+
+    try {
+        server.SetFuzzyMatching({ 2, 0, 0.5, 16, 1 });
+        ASSERT_HINT(false, "Distances above 1 must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    server.SetFuzzyMatching({ 1, 0, 0.5, 16, 1 });
+    const auto found_docs = server.FindTopDocuments("serach"s);
+    ASSERT_EQUAL(found_docs.size(), 1u);
+    ASSERT_EQUAL(found_docs[0].id, 1);
+
+    // The exact word always outweighs a close one
+    const auto ranked = server.FindTopDocuments(std::execution::par, "serach room"s);
+    ASSERT_EQUAL(ranked.size(), 2u);
+    ASSERT_EQUAL(ranked[0].id, 3);
+
+    const auto [words, status] = server.MatchDocument("serach"s, 1);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "search"s);
+
+    // Words added while fuzzy matching is on are found too
+    server.AddDocument(4, "harbour"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("harbor"s).size(), 1u);
+    ASSERT(server.GetMemoryStats().fuzzy_index_bytes > 0);
+}
+
+void TestRequestStatistics() {
+    using namespace std::chrono;
+    for (const uint64_t value : { 0ull, 15ull, 16ull, 1000ull, 123456789ull }) {
+        const int index = latency_buckets::GetIndex(value);
+        ASSERT(value <= latency_buckets::GetUpperBound(index));
+        ASSERT(index == 0 || value > latency_buckets::GetUpperBound(index - 1));
+    }
+
+    RequestStatistics statistics(4);
+    const auto start = RequestStatistics::Clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&statistics, start, t] {
+            for (int i = 0; i < 1000; ++i) {
+                statistics.Record(microseconds(i < 990 ? 100 : 10'000), i % 4 == t, start);
+            }
+            });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    statistics.Record(microseconds(100), false, start + seconds(2));
+
+    const auto last_second = statistics.GetWindowStatistics(seconds(1), start + seconds(2));
+    ASSERT_EQUAL(last_second.requests, 1u);
+
+    const auto window = statistics.GetWindowStatistics(seconds(10), start + seconds(2));
+    ASSERT_EQUAL(window.requests, 4001u);
+    ASSERT_EQUAL(window.empty_requests, 1000u);
+    ASSERT(std::abs(window.queries_per_second - 400.1) < DELTA);
+    ASSERT(window.p50_ns >= 100'000 && window.p50_ns < 120'000);
+    ASSERT(window.p999_ns >= 10'000'000);
+
+    // Slots are recycled after HISTORY_SECONDS
+    statistics.Record(microseconds(100), false, start + seconds(RequestStatistics::HISTORY_SECONDS));
+    ASSERT_EQUAL(statistics.GetWindowStatistics(seconds(1), start + seconds(RequestStatistics::HISTORY_SECONDS)).requests, 1u);
+    // A late record for the recycled second is dropped, not counted in the newer one
+    ASSERT_EQUAL(statistics.GetDroppedRecords(), 0u);
+    statistics.Record(microseconds(100), false, start);
+    ASSERT_EQUAL(statistics.GetDroppedRecords(), 1u);
+    ASSERT_EQUAL(statistics.GetWindowStatistics(seconds(1), start + seconds(RequestStatistics::HISTORY_SECONDS)).requests, 1u);
+
+    // Threads sharing a shard lose no records, and stale counters of a
+    // recycled slot are not read as the new second's
+    RequestStatistics shared(1);
+    shared.Record(microseconds(100), true, start);
+    threads.clear();
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&shared, start] {
+            for (int i = 0; i < 1000; ++i) {
+                shared.Record(microseconds(100), false, start + seconds(RequestStatistics::HISTORY_SECONDS));
+            }
+            });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const auto shared_window = shared.GetWindowStatistics(seconds(1), start + seconds(RequestStatistics::HISTORY_SECONDS));
+    ASSERT_EQUAL(shared_window.requests, 4000u);
+    ASSERT_EQUAL(shared_window.empty_requests, 0u);
+    ASSERT_EQUAL(shared.GetDroppedRecords(), 0u);
+
+    SearchServer server(""s);
+    server.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    RequestQueue queue(server);
+    queue.AddFindRequest("cat"s);
+    queue.AddFindRequest("dog"s);
+    const auto queue_statistics = queue.GetStatistics(seconds(60));
+    ASSERT_EQUAL(queue_statistics.requests, 2u);
+    ASSERT_EQUAL(queue_statistics.empty_requests, 1u);
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 1);
+}
+
+void TestTracing() {
+#ifndef SEARCH_SERVER_NO_TRACING
+    SearchServer server(""s);
+    server.AddDocument(1, "white cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "black dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.SetWildcardMatching(true);
+
+    const auto get_count = [](TracePhase phase) {
+        return trace::GetSnapshot()[static_cast<int>(phase)].count;
+    };
+
+    trace::SetEnabled(false);
+    trace::Reset();
+    server.FindTopDocuments("cat"s);
+    ASSERT_EQUAL(get_count(TracePhase::PARSE), 0u);
+
+    trace::SetEnabled(true);
+    server.FindTopDocuments("cat -dog"s);
+    server.FindTopDocuments(std::execution::par, "cat ca*"s);
+    server.MatchDocument("cat"s, 1);
+    trace::SetEnabled(false);
+
+    ASSERT_EQUAL(get_count(TracePhase::PARSE), 3u);
+    ASSERT_EQUAL(get_count(TracePhase::SCORING), 2u);
+    ASSERT_EQUAL(get_count(TracePhase::FILTERING), 2u);
+    ASSERT_EQUAL(get_count(TracePhase::TOP_K), 2u);
+    ASSERT_EQUAL(get_count(TracePhase::MATCH), 1u);
+    ASSERT(get_count(TracePhase::TERM_LOOKUP) >= 1u);
+
+    std::ostringstream json;
+    trace::PrintSnapshotJson(json);
+    ASSERT(json.str().find("\"match\":{\"count\":1,"s) != std::string::npos);
+
+    trace::Reset();
+    ASSERT_EQUAL(get_count(TracePhase::PARSE), 0u);
+#endif
+}
+
+void TestTokenizer() {
+    using namespace std::string_view_literals;
+    const auto split = [](std::string_view text) {
+        std::vector<std::pair<std::string_view, bool>> tokens;
+        for (const Token& token : WordTokenizer(text)) {
+            tokens.emplace_back(token.word, token.has_control_chars);
+        }
+        return tokens;
+    };
+    using Tokens = std::vector<std::pair<std::string_view, bool>>;
+    ASSERT(split(""s).empty());
+    ASSERT(split("    "s).empty());
+    ASSERT((split("  cat   dog "s) == Tokens{ { "cat"sv, false }, { "dog"sv, false } }));
+
+    // Words and separators across the 16-byte blocks of the scanner
+    const std::string long_word(37, 'a');
+    std::string text = long_word + "  "s + long_word + '\x01' + long_word + " x\x1f"s;
+    const auto tokens = split(text);
+    ASSERT_EQUAL(tokens.size(), 3u);
+    ASSERT((tokens[0] == std::make_pair(std::string_view{ long_word }, false)));
+    ASSERT_EQUAL(tokens[1].first.size(), 2 * long_word.size() + 1);
+    ASSERT(tokens[1].second);
+    ASSERT((tokens[2] == std::make_pair("x\x1f"sv, true)));
+    // Bytes above 127 (UTF-8) are ordinary word characters
+    ASSERT((split("\xd0\xba\xd0\xbe\xd1\x82"s) == Tokens{ { "\xd0\xba\xd0\xbe\xd1\x82"sv, false } }));
+
+    const HashedWordSet stop_words(std::vector<std::string>{ "in"s, "the"s, "and"s, "in"s, long_word });
+    ASSERT_EQUAL(stop_words.size(), 4u);
+    ASSERT(stop_words.Contains("the"sv));
+    ASSERT(stop_words.Contains(long_word));
+    ASSERT(!stop_words.Contains("then"sv));
+    ASSERT(!stop_words.Contains("a"sv));
+    ASSERT(!HashedWordSet().Contains("the"sv));
+
+    try {
+        SearchServer server("in the"s);
+        server.AddDocument(1, "cat in the\x12 city"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Control characters must be rejected");
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestTextAnalyzer() {
+    using namespace std::string_view_literals;
+    {
+        const TextAnalyzer analyzer(AnalyzerOptions{ true, true, true });
+        std::string buffer;
+        const std::string_view cat = "cat"sv;
+        ASSERT(analyzer.Normalize(cat, buffer).data() == cat.data());
+        ASSERT_EQUAL(analyzer.Normalize("Queries"sv, buffer), "query"sv);
+        ASSERT_EQUAL(analyzer.Normalize("boss"sv, buffer), "boss"sv);
+        ASSERT_EQUAL(analyzer.Normalize("CATS"sv, buffer, false), "cats"sv);
+        ASSERT_EQUAL(analyzer.Normalize("\xc3\x89" "COLE"sv, buffer), "\xc3\xa9" "cole"sv);
+        ASSERT_EQUAL(analyzer.Normalize("\xd0\x9a\xd0\x9e\xd0\xa8\xd0\x9a\xd0\x90\xd0\x81"sv, buffer),
+            "\xd0\xba\xd0\xbe\xd1\x88\xd0\xba\xd0\xb0\xd1\x91"sv);
+
+        std::vector<std::string_view> parts;
+        analyzer.ForEachPart("white\xc2\xa0" "cat\xe3\x80\x80"sv, [&parts](std::string_view part) {
+            parts.push_back(part);
+            });
+        ASSERT((parts == std::vector<std::string_view>{ "white"sv, "cat"sv }));
+    }
+    {
+        SearchServer server("The"s, AnalyzerOptions{ true, true, true });
+        server.AddDocument(1, "the Cats and THE dog"s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, "white\xc2\xa0" "cat CAT cats"s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(3, "Dogs"s, DocumentStatus::ACTUAL, { 1 });
+        server.SetWildcardMatching(true);
+        // "cats", "and" and "dog" for document 1
+        ASSERT_EQUAL(server.GetWordFrequencies(1).size(), 3u);
+        ASSERT_EQUAL(server.GetWordFrequencies(2).size(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("CATS"s).size(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("dogs -White"s).size(), 2u);
+        ASSERT_EQUAL(server.FindTopDocuments("Ca*"s).size(), 2u);
+        ASSERT(server.FindTopDocuments("THE"s).empty());
+
+        std::vector<std::string_view> words;
+        {
+            std::string query = "Cats Dogs"s;
+            words = std::get<0>(server.MatchDocument(query, 1));
+            query.assign(query.size(), 'x');
+        }
+        std::sort(words.begin(), words.end());
+        ASSERT((words == std::vector<std::string_view>{ "cat"sv, "dog"sv }));
+    }
+    {
+        SearchServer server(""s);
+        server.AddDocument(1, "Cat"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT(server.FindTopDocuments("cat"s).empty());
+    }
+}
+
+void TestResultCursor() {
+    SearchServer server(""s);
+    for (int id = 0; id < 20; ++id) {
+        std::string text = "cat"s;
+        for (int i = 0; i < id % 7; ++i) {
+            text += " filler"s;
+        }
+        server.AddDocument(id, text + (id % 3 == 0 ? " dog"s : ""s), DocumentStatus::ACTUAL, { id });
+    }
+    server.AddDocument(20, "bird"s, DocumentStatus::ACTUAL, { 1 });
+
+    const auto is_ordered = [](const std::vector<Document>& documents) {
+        return std::is_sorted(documents.begin(), documents.end(), IsRankedHigher);
+    };
+
+    ResultCursor cursor = server.OpenResultCursor("cat dog"s);
+    ASSERT_EQUAL(cursor.GetRemainingCount(), 20u);
+    std::vector<Document> all;
+    for (std::vector<Document> page = cursor.NextPage(3); !page.empty(); page = cursor.NextPage(3)) {
+        ASSERT(page.size() == 3 || !cursor.HasMore());
+        all.insert(all.end(), page.begin(), page.end());
+    }
+    ASSERT_EQUAL(all.size(), 20u);
+    ASSERT_EQUAL(cursor.GetReturnedCount(), 20u);
+    ASSERT(is_ordered(all));
+    const auto top = server.FindTopDocuments("cat dog"s);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ASSERT_EQUAL(top[i].id, all[i].id);
+    }
+
+    // Pages are only ranked when the iteration reaches them
+    ResultCursor lazy_cursor = server.OpenResultCursor("cat"s, DocumentStatus::ACTUAL);
+    int pages = 0;
+    for (const auto& page : Paginate(lazy_cursor, 4)) {
+        ASSERT_EQUAL(page.size(), 4u);
+        ASSERT(is_ordered(page));
+        if (++pages == 2) {
+            break;
+        }
+    }
+    ASSERT_EQUAL(lazy_cursor.GetRemainingCount(), 12u);
+    for (const auto& page : Paginate(lazy_cursor, 5)) {
+        ++pages;
+        ASSERT(!page.empty());
+    }
+    ASSERT_EQUAL(pages, 5);
+
+    ResultCursor shallow_cursor(all, 4);
+    const auto shallow_page = shallow_cursor.NextPage(10);
+    ASSERT_EQUAL(shallow_page.size(), 4u);
+    ASSERT_EQUAL(shallow_page[3].id, all[3].id);
+
+    const std::vector<int> numbers = { 1, 2, 3, 4, 5 };
+    const auto paginator = Paginate(numbers, 2);
+    ASSERT_EQUAL(paginator.size(), 3u);
+    std::vector<size_t> page_sizes;
+    for (const auto page : paginator) {
+        page_sizes.push_back(page.size());
+    }
+    ASSERT((page_sizes == std::vector<size_t>{ 2, 2, 1 }));
+}
+
+void TestAsyncSearch() {
+    SearchServer server(""s);
+    const int document_count = 5000;
+    for (int id = 0; id < document_count; ++id) {
+        server.AddDocument(id, id % 2 == 0 ? "cat dog"s : "cat"s, DocumentStatus::ACTUAL, { id });
+    }
+    ThreadPool pool(2);
+
+    const auto expected = server.FindTopDocuments("cat dog"s);
+    const auto complete = server.FindTopDocumentsAsync(pool, "cat dog"s).get();
+    ASSERT(!complete.is_partial);
+    ASSERT_EQUAL(complete.documents.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(complete.documents[i].id, expected[i].id);
+    }
+
+    SearchLimits expired;
+    expired.deadline = SearchLimits::Clock::now() - std::chrono::milliseconds(1);
+    const auto late = server.FindTopDocumentsAsync(pool, "cat"s, expired).get();
+    ASSERT(late.is_partial);
+    ASSERT(late.documents.empty());
+
+    // Cancelled from inside the scoring loop: the search stops at the
+    // next posting block and keeps what it has scored
+    SearchLimits limits;
+    int predicate_calls = 0;
+    const auto cancelling_predicate = [&predicate_calls, token = limits.cancellation](int, DocumentStatus, int) mutable {
+        if (++predicate_calls == 100) {
+            token.Cancel();
+        }
+        return true;
+    };
+    const auto partial = server.FindTopDocuments("cat"s, cancelling_predicate, TfIdfScorer{}, limits);
+    ASSERT(partial.is_partial);
+    ASSERT(!partial.documents.empty());
+    ASSERT(predicate_calls < document_count);
+    ASSERT(static_cast<size_t>(predicate_calls) <= POSTING_BLOCK_SIZE);
+
+    auto invalid = server.FindTopDocumentsAsync(pool, "--cat"s);
+    try {
+        invalid.get();
+        ASSERT_HINT(false, "Query errors must reach the future");
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    std::vector<std::future<SearchResult>> futures;
+    for (int i = 0; i < 8; ++i) {
+        futures.push_back(server.FindTopDocumentsAsync(pool, i % 2 == 0 ? "dog"s : "cat -dog"s));
+    }
+    for (auto& future : futures) {
+        const auto result = future.get();
+        ASSERT(!result.is_partial);
+        ASSERT_EQUAL(result.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    }
+}
+
+void TestMemoryStats() {
+    const auto fill = [](SearchServer& server) {
+        server.SetWildcardMatching(true);
+        for (int id = 0; id < 30; ++id) {
+            server.AddDocument(id, "cat dog "s + std::to_string(id % 5) + " averyveryverylongword"s, DocumentStatus::ACTUAL, { id });
+        }
+    };
+    const auto same_results = [](const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
+        if (lhs.size() != rhs.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            if (lhs[i].id != rhs[i].id || std::abs(lhs[i].relevance - rhs[i].relevance) > DELTA) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    SearchServer server(""s);
+    ASSERT_EQUAL(server.GetMemoryStats().postings_bytes, 0u);
+    fill(server);
+    const MemoryStats stats = server.GetMemoryStats();
+    ASSERT(stats.dictionary_bytes > 0);
+    ASSERT(stats.postings_bytes > 0);
+    ASSERT(stats.forward_index_bytes > 0);
+    ASSERT(stats.documents_bytes > 0);
+    ASSERT(stats.document_ids_bytes > 0);
+    ASSERT(stats.duplicate_index_bytes > 0);
+    ASSERT(stats.GetTotal() > stats.postings_bytes);
+
+    // An entry of the duplicate index does not grow with the document's words
+    SearchServer short_server(""s);
+    short_server.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    SearchServer long_server(""s);
+    long_server.AddDocument(0, "cat dog bird fish cow owl fox bee ant elk"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(long_server.GetMemoryStats().duplicate_index_bytes, short_server.GetMemoryStats().duplicate_index_bytes);
+
+    SearchServer compact_server(""s);
+    fill(compact_server);
+    compact_server.Compact();
+    ASSERT(compact_server.IsCompact());
+    const MemoryStats compact_stats = compact_server.GetMemoryStats();
+    ASSERT(compact_stats.postings_bytes * 2 < stats.postings_bytes);
+    ASSERT(compact_stats.forward_index_bytes < stats.forward_index_bytes);
+    for (const auto& query : { "cat"s, "dog 3"s, "cat -2"s, "averyvery*"s }) {
+        ASSERT(same_results(compact_server.FindTopDocuments(query), server.FindTopDocuments(query)));
+        ASSERT(same_results(compact_server.FindTopDocuments(std::execution::par, query), server.FindTopDocuments(query)));
+    }
+
+    // Updates keep working, in and out of id order
+    for (SearchServer* target : { &server, &compact_server }) {
+        target->RemoveDocument(7);
+        target->RemoveDocument(std::execution::par, 12);
+        target->AddDocument(7, "dog bird"s, DocumentStatus::ACTUAL, { 1 });
+        target->AddDocument(100, "bird 3"s, DocumentStatus::ACTUAL, { 2 });
+    }
+    for (const auto& query : { "bird"s, "dog 3"s, "cat"s }) {
+        ASSERT(same_results(compact_server.FindTopDocuments(query), server.FindTopDocuments(query)));
+    }
+    ASSERT((std::get<0>(compact_server.MatchDocument("bird dog cat"s, 7)) == std::get<0>(server.MatchDocument("bird dog cat"s, 7))));
+
+    // Freed nodes leave the counts
+    for (int id = 0; id < 30; ++id) {
+        if (id != 12) {
+            server.RemoveDocument(id);
+        }
+    }
+    server.RemoveDocument(100);
+    const MemoryStats empty_stats = server.GetMemoryStats();
+    ASSERT_EQUAL(empty_stats.postings_bytes, 0u);
+    ASSERT_EQUAL(empty_stats.forward_index_bytes, 0u);
+    ASSERT_EQUAL(empty_stats.documents_bytes, 0u);
+    ASSERT_EQUAL(empty_stats.document_ids_bytes, 0u);
+}
+
+void TestDocumentScan() {
+    SearchServer server("and"s);
+    for (const int id : { 5, 1, 9, 3, 7 }) {
+        server.AddDocument(id, "cat and dog "s + std::to_string(id), id == 7 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL, { id });
+    }
+    ASSERT((std::vector<int>(server.begin(), server.end()) == std::vector<int>{ 1, 3, 5, 7, 9 }));
+
+    std::vector<int> ids;
+    for (const SearchServer::DocumentView document : server.GetDocuments(3, 9)) {
+        ids.push_back(document.id);
+        ASSERT_EQUAL(document.rating, document.id);
+        ASSERT(document.status == (document.id == 7 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL));
+        ASSERT_EQUAL(document.length, 3);
+        ASSERT_EQUAL(document.word_frequencies.size(), 3u);
+        ASSERT_EQUAL(document.word_frequencies.count(std::to_string(document.id)), 1u);
+        ASSERT(&document.word_frequencies == &server.GetWordFrequencies(document.id));
+    }
+    ASSERT((ids == std::vector<int>{ 3, 5, 7 }));
+    ASSERT(server.GetWordFrequencies(4).empty());
+
+    // A removed id disappears from scans and can be added again
+    server.RemoveDocument(5);
+    ids.clear();
+    for (const SearchServer::DocumentView document : server.GetDocuments(0, 100)) {
+        ids.push_back(document.id);
+    }
+    ASSERT((ids == std::vector<int>{ 1, 3, 7, 9 }));
+    server.AddDocument(5, "bird"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.GetWordFrequencies(5).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("bird"s).size(), 1u);
+
+    for (int id = 10; id < 100; ++id) {
+        server.AddDocument(id, "fish "s + std::to_string(id % 10), DocumentStatus::ACTUAL, { id });
+    }
+    for (int id = 10; id < 100; id += 3) {
+        server.RemoveDocument(id);
+    }
+    std::vector<int> expected(server.begin(), server.end());
+    ASSERT_EQUAL(expected.size(), 65u);
+    for (const size_t part_count : { 1u, 4u, 7u, 1000u }) {
+        ids.clear();
+        for (const auto& part : server.PartitionDocuments(part_count)) {
+            for (const SearchServer::DocumentView document : part) {
+                ids.push_back(document.id);
+            }
+        }
+        ASSERT((ids == expected));
+    }
+    ASSERT(server.PartitionDocuments(50, 50, 4).empty());
+
+    std::atomic<int> id_sum = 0;
+    server.ForEachDocument(std::execution::par, [&id_sum](const SearchServer::DocumentView& document) {
+        id_sum += document.id;
+        });
+    ASSERT_EQUAL(id_sum.load(), std::accumulate(expected.begin(), expected.end(), 0));
+
+    // Removing most documents drops the tombstones
+    for (const int id : expected) {
+        server.RemoveDocument(id);
+    }
+    ASSERT(server.begin() == server.end());
+    ASSERT_EQUAL(server.GetMemoryStats().documents_bytes, 0u);
+    server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+}
+
+void TestBooleanQueries() {
+    const std::vector<std::string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "mouse"s };
+    std::vector<std::set<std::string>> contents;
+    SearchServer server("the"s);
+    SearchServer compact_server("the"s);
+    for (int id = 0; id < 300; ++id) {
+        std::string text = "the"s;
+        std::set<std::string> content;
+        // Word i is in every (i + 2)-th document, so words differ in frequency
+        for (size_t i = 0; i < words.size(); ++i) {
+            if ((id * 7 + i) % (i + 2) == 0) {
+                text += " "s + words[i];
+                content.insert(words[i]);
+            }
+        }
+        contents.push_back(content);
+        server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+        compact_server.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+    }
+    compact_server.Compact();
+    server.SetWildcardMatching(true);
+    compact_server.SetWildcardMatching(true);
+
+    // Everything the queries match, ranked by id to compare with the expected sets
+    const auto all_matches = [](const SearchServer& search_server, const std::string& query) {
+        std::vector<int> result;
+        for (const Document& document : search_server.FindTopDocumentsBoolean(query, [&result](int id, DocumentStatus, int) {
+            result.push_back(id);
+            return false;
+            })) {
+            result.push_back(document.id);
+        }
+        return result;
+    };
+    const auto has = [&contents](int id, const std::string& word) {
+        return contents[id].count(word) > 0;
+    };
+    const std::vector<std::pair<std::string, std::function<bool(int)>>> cases = {
+        { "cat AND dog"s, [&](int id) { return has(id, "cat"s) && has(id, "dog"s); } },
+        { "cat dog bird"s, [&](int id) { return has(id, "cat"s) && has(id, "dog"s) && has(id, "bird"s); } },
+        { "cat OR mouse"s, [&](int id) { return has(id, "cat"s) || has(id, "mouse"s); } },
+        { "cat NOT dog"s, [&](int id) { return has(id, "cat"s) && !has(id, "dog"s); } },
+        { "(cat OR bird) AND NOT (dog OR mouse)"s, [&](int id) { return (has(id, "cat"s) || has(id, "bird"s)) && !has(id, "dog"s) && !has(id, "mouse"s); } },
+        { "mouse AND (cat OR dog fish) OR bird NOT cat"s, [&](int id) {
+            return (has(id, "mouse"s) && (has(id, "cat"s) || (has(id, "dog"s) && has(id, "fish"s)))) || (has(id, "bird"s) && !has(id, "cat"s)); } },
+        { "the AND cat"s, [&](int id) { return has(id, "cat"s); } },
+        { "cat AND unknown"s, [](int) { return false; } },
+        { "ca* AND NOT d?g"s, [&](int id) { return has(id, "cat"s) && !has(id, "dog"s); } },
+    };
+    for (const auto& [query, is_expected] : cases) {
+        std::vector<int> expected;
+        for (int id = 0; id < 300; ++id) {
+            if (is_expected(id)) {
+                expected.push_back(id);
+            }
+        }
+        ASSERT_HINT((all_matches(server, query) == expected), query);
+        ASSERT_HINT((all_matches(compact_server, query) == expected), query);
+    }
+
+    // An OR ranks like the ordinary query of the same words
+    const auto boolean_top = server.FindTopDocumentsBoolean("cat OR bird OR mouse"s);
+    const auto plain_top = server.FindTopDocuments("cat bird mouse"s);
+    ASSERT_EQUAL(boolean_top.size(), plain_top.size());
+    for (size_t i = 0; i < plain_top.size(); ++i) {
+        ASSERT_EQUAL(boolean_top[i].id, plain_top[i].id);
+        ASSERT(std::abs(boolean_top[i].relevance - plain_top[i].relevance) < DELTA);
+    }
+    ASSERT(server.FindTopDocumentsBoolean("the"s).empty());
+
+    for (const auto& query : { ""s, "cat AND"s, "NOT cat"s, "cat OR NOT dog"s, "(cat dog"s, "cat)"s, "cat AND OR dog"s, "-cat"s, "*at"s }) {
+        try {
+            server.FindTopDocumentsBoolean(query);
+            ASSERT_HINT(false, query);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestQueryCost() {
+    using namespace std::chrono;
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat bird"s, DocumentStatus::ACTUAL, { 2 });
+    server.SetWildcardMatching(true);
+    server.AddDocument(3, "cat fish"s, DocumentStatus::BANNED, { 3 });
+    server.AddDocument(4, "dog"s, DocumentStatus::ACTUAL, { 4 });
+
+    QueryCost cost;
+    const auto documents = server.FindTopDocuments("cat dog -bird"s, cost);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, server.FindTopDocuments("cat dog -bird"s)[0].id);
+    ASSERT_EQUAL(cost.terms_parsed, 3u);
+    ASSERT_EQUAL(cost.postings_scanned, 5u);
+    ASSERT_EQUAL(cost.predicate_rejections, 1u);
+    ASSERT_EQUAL(cost.documents_scored, 3u);
+    ASSERT_EQUAL(cost.documents_excluded, 1u);
+    ASSERT(cost.top_k_comparisons > 0);
+    ASSERT(cost.total_ns >= cost.phase_ns[static_cast<int>(TracePhase::SCORING)]);
+
+    // Pattern postings count too; costs add up over searches
+    server.FindTopDocuments("ca?"s, [](int, DocumentStatus, int) { return true; }, TfIdfScorer{}, cost);
+    ASSERT_EQUAL(cost.postings_scanned, 8u);
+    ASSERT_EQUAL(cost.predicate_rejections, 1u);
+
+    SlowQueryLog log(nanoseconds(0), 2);
+    for (const QueryCost& cost : { QueryCost{}, QueryCost{}, QueryCost{} }) {
+        ASSERT(log.Record("\"cat dog\""s, cost));
+    }
+    ASSERT_EQUAL(log.GetSlowQueryCount(), 3u);
+    ASSERT_EQUAL(log.GetEntries().size(), 2u);
+    std::ostringstream out;
+    log.PrintJson(out);
+    ASSERT(out.str().find("{\"query\":\"\\\"cat dog\\\"\",\"total_ns\":0,"s) == 0);
+
+    SlowQueryLog fast_log(hours(1), 2);
+    ASSERT(!fast_log.Record("cat"s, cost));
+    ASSERT(fast_log.GetEntries().empty());
+
+    RequestQueue queue(server);
+    ASSERT(queue.GetSlowQueryLog() == nullptr);
+    queue.EnableSlowQueryLog(nanoseconds(0), 10);
+    queue.AddFindRequest("cat"s);
+    const auto entries = queue.GetSlowQueryLog()->GetEntries();
+    ASSERT_EQUAL(entries.size(), 1u);
+    ASSERT_EQUAL(entries[0].query, "cat"s);
+    ASSERT_EQUAL(entries[0].cost.postings_scanned, 3u);
+    ASSERT_EQUAL(entries[0].cost.predicate_rejections, 1u);
+}
+
+void TestWriteAheadLog() {
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string snapshot_path = (directory / "search_server_test.snapshot").string();
+    const std::string log_path = (directory / "search_server_test.log").string();
+    std::filesystem::remove(snapshot_path);
+    std::filesystem::remove(log_path);
+
+    {
+        SearchServer server(""s);
+        const std::vector<std::vector<DocumentInput>> invalid_batches = {
+            { { 1, "cat"s, DocumentStatus::ACTUAL, {} }, { 1, "dog"s, DocumentStatus::ACTUAL, {} } },
+            { { 2, "cat"s, DocumentStatus::ACTUAL, {} }, { 3, "d\x01og"s, DocumentStatus::ACTUAL, {} } } };
+        for (const auto& documents : invalid_batches) {
+            try {
+                server.AddDocuments(documents);
+                ASSERT_HINT(false, "Invalid documents must be rejected"s);
+            }
+            catch (const std::invalid_argument&) {
+            }
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), 0);
+        server.AddDocuments({ { 3, "dog"s, DocumentStatus::ACTUAL, {} }, { 2, "cat cat dog"s, DocumentStatus::BANNED, { 1, 5 } } });
+        ASSERT_EQUAL(server.GetDocumentCount(), 2);
+        ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::BANNED)[0].rating, 3);
+    }
+
+    DurableIndex::Sequence last = 0;
+    {
+        SearchServer server(""s);
+        DurableIndex index(server, snapshot_path, log_path);
+        ASSERT_EQUAL(index.GetRecoveredDocumentCount(), 0u);
+        std::vector<std::thread> writers;
+        for (int t = 0; t < 4; ++t) {
+            writers.emplace_back([&index, t] {
+                for (int i = 0; i < 25; ++i) {
+                    index.WaitDurable(index.AddDocument(t * 100 + i, "cat dog"s, DocumentStatus::ACTUAL, { t }));
+                }
+                });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        try {
+            index.AddDocument(0, "cat"s, DocumentStatus::ACTUAL, {});
+            ASSERT_HINT(false, "A repeated id must not reach the log"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+        index.RemoveDocument(0);
+        last = index.AddDocument(1000, "bird"s, DocumentStatus::ACTUAL, { 7 });
+        index.WaitDurable(last);
+        ASSERT_EQUAL(index.GetLog().GetDurableSequence(), last);
+        ASSERT(index.GetLog().GetSyncCount() >= 1 && index.GetLog().GetSyncCount() <= last);
+    }
+    ASSERT_EQUAL(ReadLog(log_path).records.size(), last);
+
+    // A crash in the middle of a record leaves a torn tail
+    {
+        std::ofstream log(log_path, std::ios::binary | std::ios::app);
+        log << "\x10\x00\x00\x00garbage"s;
+    }
+    {
+        SearchServer server(""s);
+        DurableIndex index(server, snapshot_path, log_path);
+        ASSERT_EQUAL(index.GetRecoveredDocumentCount(), 100u);
+        ASSERT_EQUAL(server.GetDocumentCount(), 100);
+        ASSERT_EQUAL(server.FindTopDocuments("bird"s)[0].rating, 7);
+        index.Checkpoint();
+        ASSERT(ReadLog(log_path).records.empty());
+        index.RemoveDocument(1000);
+        index.WaitDurable(index.AddDocument(2000, "fish"s, DocumentStatus::ACTUAL, { 1 }));
+    }
+    {
+        SearchServer server(""s);
+        DurableIndex index(server, snapshot_path, log_path);
+        ASSERT_EQUAL(server.GetDocumentCount(), 100);
+        ASSERT(server.FindTopDocuments("bird"s).empty());
+        ASSERT_EQUAL(server.FindTopDocuments("fish"s).size(), 1u);
+    }
+
+    std::filesystem::remove(snapshot_path);
+    std::filesystem::remove(log_path);
+}
+
+void TestInPlaceUpdates() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 2 });
+
+    server.SetDocumentStatus(1, DocumentStatus::BANNED);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s, DocumentStatus::BANNED)[0].id, 1);
+    ASSERT(std::get<1>(server.MatchDocument("dog"s, 1)) == DocumentStatus::BANNED);
+    // Postings are untouched: the relevance stays the same
+    const double relevance = server.FindTopDocuments("dog"s, DocumentStatus::BANNED)[0].relevance;
+    server.SetDocumentStatus(1, DocumentStatus::ACTUAL);
+    ASSERT(std::abs(server.FindTopDocuments("dog"s)[0].relevance - relevance) < DELTA);
+
+    server.SetDocumentRating(2, { 10, 20 });
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].id, 2);
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s)[0].rating, 15);
+
+    for (const int id : { -1, 3 }) {
+        try {
+            server.SetDocumentStatus(id, DocumentStatus::BANNED);
+            ASSERT_HINT(false, "Unknown ids must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+
+    // Moderation running next to searches
+    std::thread moderator([&server] {
+        for (int i = 0; i < 1000; ++i) {
+            server.SetDocumentStatus(1 + i % 2, i % 4 < 2 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL);
+            server.SetDocumentRating(1 + i % 2, { i });
+        }
+        });
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT(server.FindTopDocuments("cat"s).size() <= 2u);
+    }
+    moderator.join();
+
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string snapshot_path = (directory / "search_server_updates.snapshot").string();
+    const std::string log_path = (directory / "search_server_updates.log").string();
+    std::filesystem::remove(snapshot_path);
+    std::filesystem::remove(log_path);
+    {
+        SearchServer logged(""s);
+        DurableIndex index(logged, snapshot_path, log_path);
+        index.AddDocument(1, "cat"s, DocumentStatus::ACTUAL, { 1 });
+        index.SetDocumentStatus(1, DocumentStatus::IRRELEVANT);
+        index.WaitDurable(index.SetDocumentRating(1, { 4, 6 }));
+    }
+    {
+        SearchServer recovered(""s);
+        DurableIndex index(recovered, snapshot_path, log_path);
+        const auto documents = recovered.FindTopDocuments("cat"s, DocumentStatus::IRRELEVANT);
+        ASSERT_EQUAL(documents.size(), 1u);
+        ASSERT_EQUAL(documents[0].rating, 5);
+    }
+    std::filesystem::remove(snapshot_path);
+    std::filesystem::remove(log_path);
+}
+
+void TestSimilarDocuments() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog bird"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat dog fish"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "cat mouse"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "elephant"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "cat dog bird"s, DocumentStatus::BANNED, { 5 });
+
+    const auto similar = server.FindSimilarDocuments(1);
+    ASSERT_EQUAL(similar.size(), 2u);
+    ASSERT_EQUAL(similar[0].id, 2);
+    ASSERT_EQUAL(similar[1].id, 3);
+    ASSERT_EQUAL(server.FindSimilarDocuments(1, 1).size(), 1u);
+    ASSERT(server.FindSimilarDocuments(4).empty());
+    try {
+        server.FindSimilarDocuments(6);
+        ASSERT_HINT(false, "Unknown ids must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // Against the dot product over all terms, on documents short enough for no pruning
+    SearchServer corpus(""s);
+    const std::vector<std::string> words = { "a"s, "b"s, "c"s, "d"s, "e"s, "f"s, "g"s, "h"s };
+    for (int id = 0; id < 40; ++id) {
+        std::string text;
+        for (int i = 0; i < 5; ++i) {
+            text += words[(id * 7 + i * i * 3 + id / 5) % words.size()] + " "s;
+        }
+        corpus.AddDocument(id, text, DocumentStatus::ACTUAL, { id });
+    }
+    std::map<std::string_view, int> document_freqs;
+    for (const int id : corpus) {
+        for (const auto [word, _] : corpus.GetWordFrequencies(id)) {
+            ++document_freqs[word];
+        }
+    }
+    const auto idf = [&](std::string_view word) {
+        return std::log(corpus.GetDocumentCount() * 1.0 / document_freqs.at(word));
+    };
+    const std::vector<int> ids = { 0, 13, 39 };
+    const auto batch = ProcessSimilarDocuments(corpus, ids, 3);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        std::vector<double> expected;
+        for (const int other : corpus) {
+            if (other == ids[i]) {
+                continue;
+            }
+            double score = 0.0;
+            for (const auto [word, term_freq] : corpus.GetWordFrequencies(ids[i])) {
+                for (const auto [other_word, other_freq] : corpus.GetWordFrequencies(other)) {
+                    if (word == other_word) {
+                        score += term_freq * idf(word) * other_freq * idf(word);
+                    }
+                }
+            }
+            if (score > 0) {
+                expected.push_back(score);
+            }
+        }
+        std::sort(expected.rbegin(), expected.rend());
+        ASSERT_EQUAL(batch[i].size(), std::min<size_t>(3, expected.size()));
+        for (size_t j = 0; j < batch[i].size(); ++j) {
+            ASSERT(std::abs(batch[i][j].relevance - expected[j]) < DELTA);
+        }
+    }
+}
+
+void TestNearDuplicates() {
+    const auto add_documents = [](SearchServer& server) {
+        server.AddDocument(1, "a b c d e f g h i j"s, DocumentStatus::ACTUAL, { 1 });
+        server.AddDocument(2, "a b c d e f g h i k"s, DocumentStatus::ACTUAL, { 2 });
+        server.AddDocument(3, "l m n o p q r s t u"s, DocumentStatus::ACTUAL, { 3 });
+        server.AddDocument(4, "j i h g f e d c b a"s, DocumentStatus::ACTUAL, { 4 });
+    };
+    const std::vector<std::vector<int>> expected = { { 1, 2, 4 } };
+
+    SearchServer server(""s);
+    add_documents(server);
+    ASSERT(server.GetNearDuplicates(0.6) == expected);
+    ASSERT(server.GetNearDuplicates(std::execution::par, 0.6) == expected);
+    ASSERT(server.GetNearDuplicates(std::execution::par, 1.0) == std::vector<std::vector<int>>({ { 1, 4 } }));
+
+    SearchServer indexed(""s);
+    indexed.EnableNearDuplicateIndex();
+    add_documents(indexed);
+    ASSERT(indexed.GetNearDuplicates(0.6) == expected);
+    try {
+        indexed.EnableNearDuplicateIndex();
+        ASSERT_HINT(false, "The index must be enabled on an empty server"s);
+    }
+    catch (const std::logic_error&) {
+    }
+
+    // Removed documents leave both the exact and the near-duplicate groups
+    indexed.RemoveDocument(4);
+    ASSERT(indexed.GetNearDuplicates(0.6) == std::vector<std::vector<int>>({ { 1, 2 } }));
+    ASSERT(indexed.GetDuplicates().empty());
+    RemoveDuplicates(indexed, 0.6);
+    ASSERT_EQUAL(indexed.GetDocumentCount(), 2);
+    ASSERT(indexed.GetNearDuplicates(0.6).empty());
+    ASSERT_EQUAL(*indexed.begin(), 1);
+
+    // A chain: 1 and 2 share 9 of 11 words, 2 and 3 too, 1 and 3 only 8 of 12
+    SearchServer chained(""s);
+    chained.AddDocument(1, "a b c d e f g h i j"s, DocumentStatus::ACTUAL, { 1 });
+    chained.AddDocument(2, "b c d e f g h i j k"s, DocumentStatus::ACTUAL, { 1 });
+    chained.AddDocument(3, "c d e f g h i j k l"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(std::abs(chained.GetWordSimilarity(1, 2) - 9.0 / 11) < DELTA);
+    ASSERT(std::abs(chained.GetWordSimilarity(1, 3) - 8.0 / 12) < DELTA);
+    ASSERT(chained.GetNearDuplicates(0.75) == std::vector<std::vector<int>>({ { 1, 2, 3 } }));
+    ASSERT(chained.GetNearDuplicates(0.85).empty());
+    RemoveDuplicates(chained, 0.75);
+    ASSERT((std::vector<int>(chained.begin(), chained.end()) == std::vector<int>{ 1, 3 }));
+    try {
+        chained.GetWordSimilarity(1, 2);
+        ASSERT_HINT(false, "Similarity of a removed document must throw"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+void TestImpactOrderedSearch() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "cat cat cat mouse"s, DocumentStatus::ACTUAL, { 2 });
+    server.AddDocument(3, "bird fish fish"s, DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(4, "dog fish bird mouse mouse"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(5, "cat"s, DocumentStatus::BANNED, { 5 });
+    try {
+        server.FindTopDocumentsByImpact("cat"s);
+        ASSERT_HINT(false, "The impact index must be built first"s);
+    }
+    catch (const std::logic_error&) {
+    }
+
+    server.BuildImpactIndex();
+    ASSERT(server.HasImpactIndex());
+    for (const std::string& query : { "cat"s, "cat dog"s, "dog fish"s, "mouse bird cat"s, "cat -mouse"s, "elephant"s }) {
+        const auto expected = server.FindTopDocuments(query);
+        const SearchResult result = server.FindTopDocumentsByImpact(query);
+        ASSERT(!result.is_partial);
+        ASSERT_EQUAL_HINT(result.documents.size(), expected.size(), query);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL_HINT(result.documents[i].id, expected[i].id, query);
+            ASSERT(std::abs(result.documents[i].relevance - expected[i].relevance) < 0.01);
+        }
+    }
+    const auto banned = server.FindTopDocumentsByImpact("cat"s, [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::BANNED;
+        }, SearchLimits{});
+    ASSERT_EQUAL(banned.documents.size(), 1u);
+    ASSERT_EQUAL(banned.documents[0].id, 5);
+    try {
+        server.FindTopDocumentsByImpact("\"cat dog\""s);
+        ASSERT_HINT(false, "Phrases are not supported"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // Status changes keep the index, new documents drop it
+    server.SetDocumentStatus(5, DocumentStatus::ACTUAL);
+    ASSERT(server.HasImpactIndex());
+    ASSERT_EQUAL(server.FindTopDocumentsByImpact("cat"s).documents.size(), 3u);
+    server.AddDocument(6, "cat"s, DocumentStatus::ACTUAL, { 6 });
+    ASSERT(!server.HasImpactIndex());
+
+    // A posting budget, checked every POSTING_BLOCK_SIZE postings, stops the
+    // search with the highest impacts scored
+    SearchServer corpus(""s);
+    for (int id = 0; id < 3000; ++id) {
+        corpus.AddDocument(id, id % 100 == 0 ? "rare common"s : id % 2 == 0 ? "filler"s : "common filler filler filler"s,
+            DocumentStatus::ACTUAL, { 0 });
+    }
+    corpus.BuildImpactIndex();
+    SearchLimits limits;
+    limits.max_postings = 100;
+    const SearchResult partial = corpus.FindTopDocumentsByImpact("rare common"s, limits);
+    ASSERT(partial.is_partial);
+    ASSERT_EQUAL(partial.documents.size(), static_cast<size_t>(MAX_RESULT_DOCUMENT_COUNT));
+    for (const Document& document : partial.documents) {
+        ASSERT_EQUAL(document.id % 100, 0);
+    }
+    limits.max_postings = 0;
+    ASSERT(corpus.FindTopDocumentsByImpact("rare common"s, limits).documents.empty());
+}
+
+void TestDocumentReordering() {
+    const DocumentIdMap id_map({ 30, 10, 20 });
+    ASSERT_EQUAL(id_map.size(), 3u);
+    ASSERT_EQUAL(id_map.ToInternal(10), 1);
+    ASSERT_EQUAL(id_map.ToExternal(2), 20);
+    std::vector<Document> found = { { 0, 1.0, 1 }, { 2, 0.5, 1 } };
+    id_map.ToExternalIds(found);
+    ASSERT_EQUAL(found[0].id, 30);
+    ASSERT_EQUAL(found[1].id, 20);
+    try {
+        DocumentIdMap({ 1, 2, 1 });
+        ASSERT_HINT(false, "Repeated ids must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    try {
+        id_map.ToInternal(40);
+        ASSERT_HINT(false, "Unknown ids must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+
+    // Four topics with ids interleaved: reordering brings each topic together
+    const int topic_count = 4;
+    std::vector<DocumentInput> inputs;
+    for (int id = 0; id < 128; ++id) {
+        const int topic = id % topic_count;
+        std::string text;
+        for (int i = 0; i < 6; ++i) {
+            text += "t"s + std::to_string(topic) + "w"s + std::to_string((id * 7 + i * 3) % 10) + " "s;
+        }
+        inputs.push_back({ id * 1000, text, DocumentStatus::ACTUAL, { id } });
+    }
+    SearchServer original(""s);
+    original.AddDocuments(inputs);
+    const DocumentIdMap order = ComputeDocumentOrder(original);
+    ASSERT_EQUAL(order.size(), inputs.size());
+    int same_topic_neighbours = 0;
+    for (int internal_id = 1; internal_id < static_cast<int>(order.size()); ++internal_id) {
+        same_topic_neighbours += order.ToExternal(internal_id) / 1000 % topic_count == order.ToExternal(internal_id - 1) / 1000 % topic_count;
+    }
+    ASSERT(same_topic_neighbours > 100);
+
+    SearchServer reordered(""s);
+    reordered.AddDocuments(MapDocumentIds(inputs, order));
+    ASSERT(ComputeGapEncodedSize(reordered) < ComputeGapEncodedSize(original));
+    for (const std::string& query : { "t1w3"s, "t2w0 t2w5 -t2w7"s, "t3w1 t0w1"s }) {
+        std::vector<Document> result = reordered.FindTopDocuments(query);
+        order.ToExternalIds(result);
+        const auto expected = original.FindTopDocuments(query);
+        ASSERT_EQUAL(result.size(), expected.size());
+        for (size_t i = 0; i < result.size(); ++i) {
+            ASSERT(std::abs(result[i].relevance - expected[i].relevance) < DELTA);
+            ASSERT_EQUAL(result[i].rating, expected[i].rating);
+        }
+    }
+}
+
+void TestIndexMemory() {
+    // Large blocks are mapped in whole huge pages, small ones go upstream
+    HugePageMemoryResource huge_pages(IndexMemoryOptions{ IndexMemoryOptions::HugePages::EXPLICIT, true });
+    const size_t size = 3 * HUGE_PAGE_SIZE / 2;
+    char* large = static_cast<char*>(huge_pages.allocate(size, alignof(int)));
+    std::fill(large, large + size, 'x');
+    ASSERT_EQUAL(huge_pages.GetStats().mapped_bytes, 2 * HUGE_PAGE_SIZE);
+    void* small = huge_pages.allocate(64, alignof(int));
+    ASSERT_EQUAL(huge_pages.GetStats().mapped_bytes, 2 * HUGE_PAGE_SIZE);
+    huge_pages.deallocate(small, 64, alignof(int));
+    huge_pages.deallocate(large, size, alignof(int));
+    ASSERT_EQUAL(huge_pages.GetStats().mapped_bytes, 0u);
+
+    const auto add_documents = [](SearchServer& server) {
+        for (int id = 0; id < 2000; ++id) {
+            server.AddDocument(id, "common word"s + std::to_string(id % 97) + " word"s + std::to_string(id % 13),
+                DocumentStatus::ACTUAL, { id % 7 });
+        }
+    };
+    SearchServer expected_server(""s);
+    add_documents(expected_server);
+    ASSERT_EQUAL(expected_server.GetIndexMemoryStats().mapped_bytes, 0u);
+    for (const auto huge_page_mode : { IndexMemoryOptions::HugePages::NONE, IndexMemoryOptions::HugePages::TRANSPARENT, IndexMemoryOptions::HugePages::EXPLICIT }) {
+        SearchServer server(""s);
+        server.SetIndexMemory(IndexMemoryOptions{ huge_page_mode, true });
+        add_documents(server);
+        server.RemoveDocument(5);
+        expected_server.RemoveDocument(5);
+        server.Compact();
+        ASSERT(server.GetMemoryStats().postings_bytes > 0);
+        for (const std::string& query : { "common"s, "word5 word12 -word3"s, "word96"s }) {
+            const auto result = server.FindTopDocuments(query);
+            const auto expected = expected_server.FindTopDocuments(query);
+            ASSERT_EQUAL(result.size(), expected.size());
+            for (size_t i = 0; i < result.size(); ++i) {
+                ASSERT_EQUAL(result[i].id, expected[i].id);
+            }
+        }
+        expected_server.AddDocument(5, "common word5 word5"s, DocumentStatus::ACTUAL, { 5 });
+        try {
+            server.SetIndexMemory(IndexMemoryOptions{});
+            ASSERT_HINT(false, "Index memory must be set on an empty server"s);
+        }
+        catch (const std::logic_error&) {
+        }
+    }
+}
+
+void TestQueryBatch() {
+    // More documents and queries than one block holds, with frequent words
+    // and ties, so the ranking depends on the exact sums
+    SearchServer server(""s);
+    server.EnablePositionalIndex();
+    server.SetWildcardMatching(true);
+    const std::vector<std::string> words = { "cat"s, "dog"s, "bird"s, "fish"s, "mouse"s, "horse"s, "cow"s, "goat"s };
+    const int document_count = static_cast<int>(DOCUMENT_BATCH_BLOCK * 2 + 100);
+    for (int id = 0; id < document_count; ++id) {
+        std::string text;
+        for (int i = 0; i < 1 + id % 5; ++i) {
+            text += words[(id * 31 + i * i * 7 + id / 13) % words.size()] + " "s;
+        }
+        const DocumentStatus status = id % 11 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        // Remove some documents so that ids have gaps
+        server.AddDocument(id * 2, text, status, { id % 4 });
+    }
+    for (int id = 0; id < document_count; id += 17) {
+        server.RemoveDocument(id * 2);
+    }
+    std::vector<std::string> queries;
+    for (int i = 0; i < static_cast<int>(QUERY_BATCH_BLOCK * 3 + 5); ++i) {
+        std::string query = words[i % words.size()] + " "s + words[(i * 5 + 3) % words.size()];
+        if (i % 3 == 0) {
+            query += " -"s + words[(i * 7 + 1) % words.size()];
+        }
+        if (i % 50 == 0) {
+            query += " unknown"s;
+        }
+        queries.push_back(query);
+    }
+    queries.push_back("\"cat dog\""s);
+    queries.push_back("ca* -do*"s);
+    queries.push_back("-cat"s);
+
+    const auto expected = ProcessQueries(server, queries);
+    for (const auto& batch : { server.FindTopDocumentsBatch(queries), server.FindTopDocumentsBatch(std::execution::par, queries),
+        ProcessQueriesBatched(server, queries) }) {
+        ASSERT_EQUAL(batch.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL_HINT(batch[i].size(), expected[i].size(), queries[i]);
+            for (size_t j = 0; j < expected[i].size(); ++j) {
+                ASSERT_EQUAL_HINT(batch[i][j].id, expected[i][j].id, queries[i]);
+                ASSERT_HINT(batch[i][j].relevance == expected[i][j].relevance, queries[i]);
+                ASSERT_EQUAL_HINT(batch[i][j].rating, expected[i][j].rating, queries[i]);
+            }
+        }
+    }
+    ASSERT(server.FindTopDocumentsBatch({}).empty());
+    try {
+        server.FindTopDocumentsBatch({ "cat"s, "--dog"s });
+        ASSERT_HINT(false, "Invalid queries must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+}
+
+// Sends the requests in one write, as a pipelining client would, and reads
+// the responses until the server closes the connection
+std::string ExchangeWithQueryServer(int domain, const sockaddr* address, socklen_t address_size, const std::string& requests) {
+    const int fd = socket(domain, SOCK_STREAM, 0);
+    ASSERT(fd >= 0);
+    ASSERT(connect(fd, address, address_size) == 0);
+    for (size_t sent = 0; sent < requests.size();) {
+        const ssize_t size = send(fd, requests.data() + sent, requests.size() - sent, MSG_NOSIGNAL);
+        ASSERT(size > 0);
+        sent += size;
+    }
+    shutdown(fd, SHUT_WR);
+    std::string result;
+    char buffer[4096];
+    for (ssize_t size = recv(fd, buffer, sizeof buffer, 0); size > 0; size = recv(fd, buffer, sizeof buffer, 0)) {
+        result.append(buffer, size);
+    }
+    close(fd);
+    return result;
+}
+
+void TestQueryServer() {
+    SearchServer server("and"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(4, "groomed cat"s, DocumentStatus::BANNED, { 9 });
+    const std::vector<std::string> queries = { "fluffy groomed cat"s, "dog -eyes"s, "parrot"s, "cat --dog"s, "cat"s };
+
+    std::string requests;
+    std::string expected;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        // Every other request with a Windows line ending
+        requests += queries[i] + (i % 2 == 0 ? "\n"s : "\r\n"s);
+        try {
+            std::ostringstream response;
+            response << "OK"s;
+            for (const Document& document : server.FindTopDocuments(queries[i])) {
+                response << ' ' << document.id << ':' << document.relevance << ':' << document.rating;
+            }
+            expected += response.str() + "\n"s;
+        }
+        catch (const std::invalid_argument&) {
+            expected += "ERROR\n"s;
+        }
+    }
+    // Relevances read back exactly; the rest of the line is compared as text
+    const auto check_responses = [&](const std::string& responses) {
+        std::istringstream actual_lines(responses);
+        std::istringstream expected_lines(expected);
+        std::string actual_line;
+        std::string expected_line;
+        for (size_t i = 0; i < queries.size(); ++i) {
+            ASSERT_HINT(std::getline(actual_lines, actual_line), queries[i]);
+            ASSERT_HINT(std::getline(expected_lines, expected_line), queries[i]);
+            if (expected_line.rfind("ERROR"s, 0) == 0) {
+                ASSERT_HINT(actual_line.rfind("ERROR "s, 0) == 0, queries[i]);
+                continue;
+            }
+            std::istringstream actual_words(actual_line);
+            std::string word;
+            actual_words >> word;
+            ASSERT_EQUAL_HINT(word, "OK"s, queries[i]);
+            const auto documents = server.FindTopDocuments(queries[i]);
+            for (const Document& document : documents) {
+                ASSERT_HINT(actual_words >> word, queries[i]);
+                const size_t first_colon = word.find(':');
+                const size_t second_colon = word.rfind(':');
+                ASSERT_EQUAL_HINT(std::stoi(word.substr(0, first_colon)), document.id, queries[i]);
+                ASSERT_HINT(std::strtod(word.c_str() + first_colon + 1, nullptr) == document.relevance, queries[i]);
+                ASSERT_EQUAL_HINT(std::stoi(word.substr(second_colon + 1)), document.rating, queries[i]);
+            }
+            ASSERT_HINT(!(actual_words >> word), queries[i]);
+        }
+        ASSERT(!std::getline(actual_lines, actual_line));
+    };
+
+    {
+        QueryServer query_server(server);
+        ASSERT(query_server.GetPort() > 0);
+        std::thread loop([&query_server] {
+            query_server.Run();
+            });
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(query_server.GetPort()));
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        check_responses(ExchangeWithQueryServer(AF_INET, reinterpret_cast<const sockaddr*>(&address), sizeof address, requests));
+
+        // Many pipelined requests, more than one batch holds
+        std::string many_requests;
+        for (int i = 0; i < 3000; ++i) {
+            many_requests += "cat\n"s;
+        }
+        const std::string responses = ExchangeWithQueryServer(AF_INET, reinterpret_cast<const sockaddr*>(&address), sizeof address, many_requests);
+        ASSERT_EQUAL(static_cast<size_t>(std::count(responses.begin(), responses.end(), '\n')), 3000u);
+
+        // The rest of an over-long request is not read
+        const std::string long_request(QueryServerOptions{}.max_request_size + 10, 'a');
+        ASSERT_EQUAL(ExchangeWithQueryServer(AF_INET, reinterpret_cast<const sockaddr*>(&address), sizeof address, "cat\n"s + long_request).substr(0, 3), "OK "s);
+
+        query_server.Stop();
+        loop.join();
+        const QueryServerStats stats = query_server.GetStats();
+        ASSERT_EQUAL(stats.accepted_connections, 3u);
+        ASSERT_EQUAL(stats.requests, queries.size() + 3000 + 2);
+        // Pipelined requests share batches
+        ASSERT(stats.batches < stats.requests);
+    }
+    {
+        const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.sock").string();
+        QueryServerOptions options;
+        options.address = "unix:"s + path;
+        options.max_batch_size = 2;
+        options.is_parallel = false;
+        QueryServer query_server(server, options);
+        ASSERT_EQUAL(query_server.GetPort(), 0);
+        std::thread loop([&query_server] {
+            query_server.Run();
+            });
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::copy(path.begin(), path.end(), address.sun_path);
+        check_responses(ExchangeWithQueryServer(AF_UNIX, reinterpret_cast<const sockaddr*>(&address), sizeof address, requests));
+        query_server.Stop();
+        loop.join();
+    }
+    for (const std::string& address : { "localhost"s, "127.0.0.1:http"s, "127.0.0.1:70000"s, "unix:"s }) {
+        try {
+            QueryServerOptions options;
+            options.address = address;
+            QueryServer query_server(server, options);
+            ASSERT_HINT(false, "Invalid addresses must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestSearchFacets() {
+    SearchServer server(""s);
+    server.AddDocument(1, "cat dog"s, DocumentStatus::ACTUAL, { 5 });
+    server.AddDocument(2, "cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "cat bird"s, DocumentStatus::BANNED, { 3 });
+    server.AddDocument(4, "cat fish"s, DocumentStatus::IRRELEVANT, { 0 });
+    server.AddDocument(5, "dog"s, DocumentStatus::ACTUAL, { 4 });
+    server.AddDocument(6, "cat mouse"s, DocumentStatus::ACTUAL, { -2 });
+    {
+        SearchFacets facets;
+        const auto documents = server.FindTopDocuments("cat -fish"s, facets);
+        const auto expected = server.FindTopDocuments("cat -fish"s);
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+            ASSERT(documents[i].relevance == expected[i].relevance);
+        }
+        // The banned match is counted by status, but not as a hit
+        ASSERT_EQUAL(facets.total_hits, 3u);
+        ASSERT_EQUAL(facets.status_counts[static_cast<size_t>(DocumentStatus::ACTUAL)], 3u);
+        ASSERT_EQUAL(facets.status_counts[static_cast<size_t>(DocumentStatus::BANNED)], 1u);
+        ASSERT_EQUAL(facets.status_counts[static_cast<size_t>(DocumentStatus::IRRELEVANT)], 0u);
+        ASSERT((facets.rating_counts == std::vector<size_t>{ 1, 1, 0, 0, 0, 1 }));
+    }
+    {
+        SearchFacets facets;
+        facets.rating_bounds = { 0, 3 };
+        const auto all = [](int, DocumentStatus, int) {
+            return true;
+        };
+        const auto documents = server.FindTopDocuments("cat -fish"s, all, TfIdfScorer{}, facets);
+        ASSERT_EQUAL(documents.size(), 4u);
+        ASSERT_EQUAL(facets.total_hits, 4u);
+        ASSERT((facets.rating_counts == std::vector<size_t>{ 1, 1, 2 }));
+    }
+    {
+        SearchFacets facets;
+        ASSERT(server.FindTopDocuments("horse"s, facets).empty());
+        ASSERT_EQUAL(facets.total_hits, 0u);
+        ASSERT((facets.rating_counts == std::vector<size_t>(6, 0)));
+    }
+    {
+        SearchFacets facets;
+        facets.rating_bounds = { 3, 1 };
+        try {
+            server.FindTopDocuments("cat"s, facets);
+            ASSERT_HINT(false, "Unsorted rating bounds must be rejected"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+}
+
 void TestSearchServer() {
     RUN_TEST(TestDocuments);
     RUN_TEST(TestPredicate);
@@ -274,5 +1807,31 @@ void TestSearchServer() {
     RUN_TEST(TestComputeAverageRating);
     RUN_TEST(TestStatus);
     RUN_TEST(TestCountingRelevansIsCorrect);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestScorers);
+    RUN_TEST(TestTermDictionary);
+    RUN_TEST(TestPrefixQueries);
+    RUN_TEST(TestWildcardCharactersInDocuments);
+    RUN_TEST(TestFuzzyMatching);
+    RUN_TEST(TestRequestStatistics);
+    RUN_TEST(TestTracing);
+    RUN_TEST(TestTokenizer);
+    RUN_TEST(TestTextAnalyzer);
+    RUN_TEST(TestResultCursor);
+    RUN_TEST(TestAsyncSearch);
+    RUN_TEST(TestMemoryStats);
+    RUN_TEST(TestDocumentScan);
+    RUN_TEST(TestBooleanQueries);
+    RUN_TEST(TestQueryCost);
+    RUN_TEST(TestWriteAheadLog);
+    RUN_TEST(TestInPlaceUpdates);
+    RUN_TEST(TestSimilarDocuments);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestImpactOrderedSearch);
+    RUN_TEST(TestDocumentReordering);
+    RUN_TEST(TestIndexMemory);
+    RUN_TEST(TestQueryBatch);
+    RUN_TEST(TestSearchFacets);
+    RUN_TEST(TestQueryServer);
 }
 // ---------      -----------
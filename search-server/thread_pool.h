@@ -0,0 +1,53 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order.
+// The destructor finishes the queued tasks before joining the workers.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // The future receives the task's result or exception
+    template <typename Task>
+    auto Submit(Task task) -> std::future<std::invoke_result_t<Task>>;
+
+    size_t GetThreadCount() const {
+        return workers_.size();
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable has_task_;
+    bool is_stopping_ = false;
+
+    void Work();
+};
+
+template <typename Task>
+auto ThreadPool::Submit(Task task) -> std::future<std::invoke_result_t<Task>> {
+    // std::function needs a copyable target, packaged_task is move-only
+    auto packaged = std::make_shared<std::packaged_task<std::invoke_result_t<Task>()>>(std::move(task));
+    auto result = packaged->get_future();
+    {
+        std::lock_guard guard(mutex_);
+        tasks_.push([packaged] { (*packaged)(); });
+    }
+    has_task_.notify_one();
+    return result;
+}
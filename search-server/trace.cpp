@@ -0,0 +1,142 @@
+#include "trace.h"
+
+#include <array>
+#include <memory>
+#include <mutex>
+
+namespace {
+
+// Written only by its own thread, read by snapshots; relaxed atomics keep
+// the counters race-free without a locked instruction on the hot path
+struct ThreadRecorder {
+    std::array<std::array<std::atomic<uint64_t>, latency_buckets::COUNT>, TRACE_PHASE_COUNT> buckets{};
+    std::array<std::atomic<uint64_t>, TRACE_PHASE_COUNT> total_ns{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    // Recorders outlive their threads so that their counts stay in snapshots
+    std::vector<std::unique_ptr<ThreadRecorder>> recorders;
+};
+
+Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+}
+
+ThreadRecorder& GetThreadRecorder() {
+    thread_local ThreadRecorder* recorder = [] {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.recorders.push_back(std::make_unique<ThreadRecorder>());
+        return registry.recorders.back().get();
+    }();
+    return *recorder;
+}
+
+void Increase(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+}  // namespace
+
+namespace trace {
+
+const char* GetPhaseName(TracePhase phase) {
+    switch (phase) {
+    case TracePhase::PARSE:
+        return "parse";
+    case TracePhase::TERM_LOOKUP:
+        return "term_lookup";
+    case TracePhase::SCORING:
+        return "scoring";
+    case TracePhase::FILTERING:
+        return "filtering";
+    case TracePhase::TOP_K:
+        return "top_k";
+    case TracePhase::MATCH:
+        return "match";
+    }
+    return "unknown";
+}
+
+void Record(TracePhase phase, uint64_t duration_ns) {
+    ThreadRecorder& recorder = GetThreadRecorder();
+    const int index = static_cast<int>(phase);
+    Increase(recorder.buckets[index][latency_buckets::GetIndex(duration_ns)], 1);
+    Increase(recorder.total_ns[index], duration_ns);
+}
+
+std::vector<TracePhaseStatistics> GetSnapshot() {
+    std::array<LatencyHistogram, TRACE_PHASE_COUNT> histograms;
+    std::array<uint64_t, TRACE_PHASE_COUNT> total_ns{};
+    {
+        Registry& registry = GetRegistry();
+        std::lock_guard guard(registry.mutex);
+        for (const auto& recorder : registry.recorders) {
+            for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+                for (int bucket = 0; bucket < latency_buckets::COUNT; ++bucket) {
+                    histograms[phase].AddBucket(bucket, recorder->buckets[phase][bucket].load(std::memory_order_relaxed));
+                }
+                total_ns[phase] += recorder->total_ns[phase].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::vector<TracePhaseStatistics> result;
+    result.reserve(TRACE_PHASE_COUNT);
+    for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+        TracePhaseStatistics statistics;
+        statistics.phase = static_cast<TracePhase>(phase);
+        statistics.count = histograms[phase].GetTotal();
+        statistics.total_ns = total_ns[phase];
+        statistics.p50_ns = histograms[phase].GetQuantile(0.5);
+        statistics.p99_ns = histograms[phase].GetQuantile(0.99);
+        statistics.p999_ns = histograms[phase].GetQuantile(0.999);
+        result.push_back(statistics);
+    }
+    return result;
+}
+
+void Reset() {
+    Registry& registry = GetRegistry();
+    std::lock_guard guard(registry.mutex);
+    for (const auto& recorder : registry.recorders) {
+        for (int phase = 0; phase < TRACE_PHASE_COUNT; ++phase) {
+            for (auto& bucket : recorder->buckets[phase]) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            recorder->total_ns[phase].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void PrintSnapshot(std::ostream& out) {
+    for (const TracePhaseStatistics& statistics : GetSnapshot()) {
+        out << GetPhaseName(statistics.phase) << ": count " << statistics.count
+            << ", total " << statistics.total_ns << " ns"
+            << ", p50 " << statistics.p50_ns << " ns"
+            << ", p99 " << statistics.p99_ns << " ns"
+            << ", p999 " << statistics.p999_ns << " ns\n";
+    }
+}
+
+void PrintSnapshotJson(std::ostream& out) {
+    out << '{';
+    bool is_first = true;
+    for (const TracePhaseStatistics& statistics : GetSnapshot()) {
+        if (!is_first) {
+            out << ',';
+        }
+        is_first = false;
+        out << '"' << GetPhaseName(statistics.phase) << "\":{"
+            << "\"count\":" << statistics.count
+            << ",\"total_ns\":" << statistics.total_ns
+            << ",\"p50_ns\":" << statistics.p50_ns
+            << ",\"p99_ns\":" << statistics.p99_ns
+            << ",\"p999_ns\":" << statistics.p999_ns << '}';
+    }
+    out << "}\n";
+}
+
+}  // namespace trace
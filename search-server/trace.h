@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "histogram.h"
+
+// Per-phase query timing. SEARCH_TRACE_SCOPE(phase) measures the enclosing
+// scope with steady_clock and adds it to a histogram of the calling thread,
+// so recording never touches memory shared with other threads. Tracing is
+// off until trace::SetEnabled(true); defining SEARCH_SERVER_NO_TRACING
+// removes the timers from the build entirely.
+//
+// Phases may nest (term lookup happens while scoring), each time is inclusive.
+
+enum class TracePhase {
+    PARSE,
+    TERM_LOOKUP,
+    SCORING,
+    FILTERING,
+    TOP_K,
+    MATCH,
+};
+
+const int TRACE_PHASE_COUNT = 6;
+
+struct TracePhaseStatistics {
+    TracePhase phase;
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+};
+
+namespace trace {
+
+inline std::atomic<bool> is_enabled{ false };
+
+inline bool IsEnabled() {
+    return is_enabled.load(std::memory_order_relaxed);
+}
+
+inline void SetEnabled(bool enabled) {
+    is_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+const char* GetPhaseName(TracePhase phase);
+
+void Record(TracePhase phase, uint64_t duration_ns);
+
+// Merges the histograms of all threads that have ever recorded
+std::vector<TracePhaseStatistics> GetSnapshot();
+// Counts recorded concurrently with Reset may survive it
+void Reset();
+
+void PrintSnapshot(std::ostream& out);
+void PrintSnapshotJson(std::ostream& out);
+
+class ScopedTimer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit ScopedTimer(TracePhase phase)
+        : phase_(phase)
+        , is_active_(IsEnabled()) {
+        if (is_active_) {
+            start_ = Clock::now();
+        }
+    }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    ~ScopedTimer() {
+        if (is_active_) {
+            Record(phase_, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_).count());
+        }
+    }
+
+private:
+    const TracePhase phase_;
+    const bool is_active_;
+    Clock::time_point start_;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_INTERNAL(X, Y) X ## Y
+#define TRACE_CONCAT(X, Y) TRACE_CONCAT_INTERNAL(X, Y)
+
+#ifdef SEARCH_SERVER_NO_TRACING
+#define SEARCH_TRACE_SCOPE(phase) ((void)0)
+#else
+#define SEARCH_TRACE_SCOPE(phase) trace::ScopedTimer TRACE_CONCAT(traceTimer, __LINE__)(TracePhase::phase)
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// LEB128 varints: 7 bits per byte, low bits first, the high bit set on
+// every byte but the last
+inline void WriteVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Reads the varint starting at data[offset] and moves offset past it
+inline uint64_t ReadVarint(const uint8_t* data, size_t& offset) {
+    uint64_t result = 0;
+    int shift = 0;
+    while (data[offset] & 0x80) {
+        result |= static_cast<uint64_t>(data[offset++] & 0x7F) << shift;
+        shift += 7;
+    }
+    result |= static_cast<uint64_t>(data[offset++]) << shift;
+    return result;
+}
+
+// Number of bytes WriteVarint takes for the value
+inline size_t GetVarintSize(uint64_t value) {
+    size_t result = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++result;
+    }
+    return result;
+}
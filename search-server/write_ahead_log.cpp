@@ -0,0 +1,345 @@
+#include "write_ahead_log.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+namespace {
+
+const size_t HEADER_SIZE = 2 * sizeof(uint32_t);
+
+std::array<uint32_t, 256> MakeCrcTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+// CRC-32 as in zlib
+uint32_t ComputeCrc(std::string_view data) {
+    static const std::array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<unsigned char>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+template <typename T>
+void Put(std::string& out, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// Reads a value from the front of data; false if data is too short
+template <typename T>
+bool Take(std::string_view& data, T& value) {
+    if (data.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, data.data(), sizeof(T));
+    data.remove_prefix(sizeof(T));
+    return true;
+}
+
+bool HasStatus(LogRecord::Type type) {
+    return type == LogRecord::Type::ADD_DOCUMENT || type == LogRecord::Type::SET_STATUS;
+}
+
+bool HasRatings(LogRecord::Type type) {
+    return type == LogRecord::Type::ADD_DOCUMENT || type == LogRecord::Type::SET_RATINGS;
+}
+
+void EncodeRecord(const LogRecord& record, std::string& out) {
+    std::string payload;
+    Put(payload, static_cast<uint8_t>(record.type));
+    Put(payload, static_cast<int32_t>(record.document.id));
+    if (HasStatus(record.type)) {
+        Put(payload, static_cast<uint8_t>(record.document.status));
+    }
+    if (HasRatings(record.type)) {
+        Put(payload, static_cast<uint32_t>(record.document.ratings.size()));
+        for (const int rating : record.document.ratings) {
+            Put(payload, static_cast<int32_t>(rating));
+        }
+    }
+    if (record.type == LogRecord::Type::ADD_DOCUMENT) {
+        Put(payload, static_cast<uint32_t>(record.document.text.size()));
+        payload += record.document.text;
+    }
+    Put(out, static_cast<uint32_t>(payload.size()));
+    Put(out, ComputeCrc(payload));
+    out += payload;
+}
+
+bool DecodePayload(std::string_view payload, LogRecord& record) {
+    uint8_t type = 0;
+    int32_t id = 0;
+    if (!Take(payload, type) || !Take(payload, id)) {
+        return false;
+    }
+    if (type < static_cast<uint8_t>(LogRecord::Type::ADD_DOCUMENT) || type > static_cast<uint8_t>(LogRecord::Type::SET_RATINGS)) {
+        return false;
+    }
+    record.type = static_cast<LogRecord::Type>(type);
+    record.document.id = id;
+    if (HasStatus(record.type)) {
+        uint8_t status = 0;
+        if (!Take(payload, status) || status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+            return false;
+        }
+        record.document.status = static_cast<DocumentStatus>(status);
+    }
+    if (HasRatings(record.type)) {
+        uint32_t rating_count = 0;
+        if (!Take(payload, rating_count) || rating_count > payload.size() / sizeof(int32_t)) {
+            return false;
+        }
+        record.document.ratings.resize(rating_count);
+        for (int& rating : record.document.ratings) {
+            int32_t value = 0;
+            Take(payload, value);
+            rating = value;
+        }
+    }
+    if (record.type != LogRecord::Type::ADD_DOCUMENT) {
+        return payload.empty();
+    }
+    uint32_t text_size = 0;
+    if (!Take(payload, text_size) || text_size != payload.size()) {
+        return false;
+    }
+    record.document.text = std::string(payload);
+    return true;
+}
+
+// Returns 0 or the errno of the failed write
+int WriteAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return 0;
+}
+
+int OpenLog(const std::string& path) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot open log "s + path);
+    }
+    return fd;
+}
+
+}  // namespace
+
+LogContents ReadLog(const std::string& path) {
+    LogContents result;
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return result;
+        }
+        throw std::system_error(errno, std::generic_category(), "Cannot open log "s + path);
+    }
+    std::string data;
+    char buffer[1 << 16];
+    while (true) {
+        const ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            const int error = errno;
+            close(fd);
+            throw std::system_error(error, std::generic_category(), "Cannot read log "s + path);
+        }
+        if (size == 0) {
+            break;
+        }
+        data.append(buffer, static_cast<size_t>(size));
+    }
+    close(fd);
+
+    std::string_view rest = data;
+    while (rest.size() >= HEADER_SIZE) {
+        std::string_view header = rest;
+        uint32_t payload_size = 0;
+        uint32_t crc = 0;
+        Take(header, payload_size);
+        Take(header, crc);
+        if (header.size() < payload_size) {
+            break;
+        }
+        const std::string_view payload = header.substr(0, payload_size);
+        LogRecord record;
+        if (ComputeCrc(payload) != crc || !DecodePayload(payload, record)) {
+            break;
+        }
+        result.records.push_back(std::move(record));
+        rest.remove_prefix(HEADER_SIZE + payload_size);
+    }
+    result.valid_size = data.size() - rest.size();
+    return result;
+}
+
+void WriteSnapshot(const std::string& path, const std::vector<LogRecord>& records) {
+    std::string data;
+    for (const LogRecord& record : records) {
+        EncodeRecord(record, data);
+    }
+    const std::string temporary_path = path + ".tmp"s;
+    const int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Cannot create snapshot "s + temporary_path);
+    }
+    int error = WriteAll(fd, data);
+    if (error == 0 && fdatasync(fd) != 0) {
+        error = errno;
+    }
+    close(fd);
+    if (error == 0 && std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        error = errno;
+    }
+    if (error != 0) {
+        throw std::system_error(error, std::generic_category(), "Cannot write snapshot "s + path);
+    }
+    // The rename itself is durable once the directory is synced
+    const std::string directory = std::filesystem::path(path).parent_path().string();
+    const int directory_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (directory_fd >= 0) {
+        fsync(directory_fd);
+        close(directory_fd);
+    }
+}
+
+WriteAheadLog::WriteAheadLog(const std::string& path, uint64_t valid_size)
+    : fd_(OpenLog(path)) {
+    if (ftruncate(fd_, static_cast<off_t>(valid_size)) != 0 || fdatasync(fd_) != 0) {
+        const int error = errno;
+        close(fd_);
+        throw std::system_error(error, std::generic_category(), "Cannot truncate log "s + path);
+    }
+    flusher_ = std::thread([this] {
+        RunFlusher();
+        });
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    {
+        std::lock_guard guard(mutex_);
+        is_stopping_ = true;
+    }
+    has_pending_.notify_one();
+    flusher_.join();
+    close(fd_);
+}
+
+WriteAheadLog::Sequence WriteAheadLog::Append(const LogRecord& record) {
+    std::string encoded;
+    EncodeRecord(record, encoded);
+    Sequence sequence = 0;
+    {
+        std::lock_guard guard(mutex_);
+        CheckError();
+        pending_ += encoded;
+        sequence = ++appended_;
+    }
+    has_pending_.notify_one();
+    return sequence;
+}
+
+void WriteAheadLog::WaitDurable(Sequence sequence) {
+    std::unique_lock lock(mutex_);
+    is_durable_.wait(lock, [this, sequence] {
+        return durable_ >= sequence || error_ != 0;
+        });
+    if (durable_ < sequence) {
+        CheckError();
+    }
+}
+
+void WriteAheadLog::Sync() {
+    Sequence sequence = 0;
+    {
+        std::lock_guard guard(mutex_);
+        sequence = appended_;
+    }
+    WaitDurable(sequence);
+}
+
+WriteAheadLog::Sequence WriteAheadLog::GetDurableSequence() const {
+    std::lock_guard guard(mutex_);
+    return durable_;
+}
+
+uint64_t WriteAheadLog::GetSyncCount() const {
+    std::lock_guard guard(mutex_);
+    return sync_count_;
+}
+
+void WriteAheadLog::Truncate() {
+    std::unique_lock lock(mutex_);
+    is_durable_.wait(lock, [this] {
+        return durable_ == appended_ || error_ != 0;
+        });
+    CheckError();
+    if (ftruncate(fd_, 0) != 0 || fdatasync(fd_) != 0) {
+        error_ = errno;
+        CheckError();
+    }
+}
+
+void WriteAheadLog::RunFlusher() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        has_pending_.wait(lock, [this] {
+            return !pending_.empty() || is_stopping_;
+            });
+        if (pending_.empty() || error_ != 0) {
+            return;
+        }
+        // Writers append to a fresh buffer while this one is written
+        std::string batch;
+        batch.swap(pending_);
+        const Sequence last = appended_;
+        lock.unlock();
+        int error = WriteAll(fd_, batch);
+        if (error == 0 && fdatasync(fd_) != 0) {
+            error = errno;
+        }
+        lock.lock();
+        if (error != 0) {
+            error_ = error;
+        }
+        else {
+            durable_ = last;
+            ++sync_count_;
+        }
+        is_durable_.notify_all();
+    }
+}
+
+void WriteAheadLog::CheckError() const {
+    if (error_ != 0) {
+        throw std::system_error(error_, std::generic_category(), "Write-ahead log failed"s);
+    }
+}
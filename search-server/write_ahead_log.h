@@ -0,0 +1,91 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+// An update of the index as stored in the write-ahead log and in snapshots
+struct LogRecord {
+    enum class Type : uint8_t {
+        ADD_DOCUMENT = 1,
+        REMOVE_DOCUMENT = 2,
+        SET_STATUS = 3,
+        SET_RATINGS = 4,
+    };
+
+    Type type = Type::ADD_DOCUMENT;
+    // Only the fields the type changes are stored besides the id
+    DocumentInput document;
+};
+
+// Records of a log or snapshot file. Each record is stored as
+//   [payload size: u32][CRC-32 of the payload: u32][payload]
+// in native byte order. Reading stops at the first incomplete or corrupt
+// record: that is the tail a crash left half-written.
+struct LogContents {
+    std::vector<LogRecord> records;
+    // Length of the valid prefix of the file
+    uint64_t valid_size = 0;
+};
+
+// A missing file reads as empty. Throws std::system_error if the file cannot be read.
+LogContents ReadLog(const std::string& path);
+
+// Replaces the file atomically: the records are written and synced to a
+// temporary file, which is then renamed over path
+void WriteSnapshot(const std::string& path, const std::vector<LogRecord>& records);
+
+// Append-only log with group commit. Append only encodes the record into a
+// memory buffer; a background thread writes the buffer and syncs it with
+// fdatasync, and records appended while a sync is running go out together
+// with the next one. Writers that need durability wait for their record's
+// sequence number, so many of them share one sync.
+class WriteAheadLog {
+public:
+    using Sequence = uint64_t;
+
+    // Appends after the first valid_size bytes of the file, cutting off a
+    // torn tail. Throws std::system_error if the file cannot be opened.
+    WriteAheadLog(const std::string& path, uint64_t valid_size);
+    // Writes and syncs the records still in the buffer
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Sequence numbers start from 1
+    Sequence Append(const LogRecord& record);
+
+    // Blocks until the record is on disk. Throws std::system_error if writing
+    // the log has failed; the log accepts no records after that.
+    void WaitDurable(Sequence sequence);
+    // Waits for all records appended so far
+    void Sync();
+
+    Sequence GetDurableSequence() const;
+    uint64_t GetSyncCount() const;
+
+    // Drops all records, once they are durable; used after a checkpoint
+    void Truncate();
+
+private:
+    const int fd_;
+    mutable std::mutex mutex_;
+    std::condition_variable has_pending_;
+    std::condition_variable is_durable_;
+    std::string pending_;
+    Sequence appended_ = 0;
+    Sequence durable_ = 0;
+    uint64_t sync_count_ = 0;
+    int error_ = 0;
+    bool is_stopping_ = false;
+    std::thread flusher_;
+
+    void RunFlusher();
+    void CheckError() const;
+};